@@ -0,0 +1,512 @@
+// Microbenchmarks for the decoding hot paths. Builds synthetic pages in a
+// temporary file, times each operation until --min-time-ms has elapsed and
+// prints one JSON object with ns/op, bytes/s and heap allocations per op.
+//
+//   bench [--filter SUBSTRING] [--min-time-ms N] [--output FILE]
+
+#include "btree.hpp"
+#include "btree_page.hpp"
+#include "btree_record.hpp"
+#include "byte_reader.hpp"
+#include "file_reader.hpp"
+#include "key_search.hpp"
+#include "normalized_key.hpp"
+#include "overflow_page.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+uint64_t allocation_count = 0;
+
+} // namespace
+
+void *operator new(size_t size) {
+  ++allocation_count;
+  if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, size_t) noexcept { std::free(memory); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from discarding a benchmarked result
+template <typename T> void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Options {
+  std::string filter;
+  std::chrono::milliseconds min_time{200};
+  std::string output;
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double ns_per_op;
+  double bytes_per_second;
+  double allocs_per_op;
+};
+
+class Runner {
+public:
+  explicit Runner(const Options &options) : options_(options) {}
+
+  // Times `op`, which processes `bytes_per_op` bytes per call
+  void run(const std::string &name, uint64_t bytes_per_op,
+           const std::function<void()> &op) {
+    if (name.find(options_.filter) == std::string::npos) {
+      return;
+    }
+    op(); // warm up
+
+    uint64_t iterations = 1;
+    while (true) {
+      uint64_t allocations = allocation_count;
+      auto start = Clock::now();
+      for (uint64_t i = 0; i < iterations; ++i) {
+        op();
+      }
+      auto elapsed = Clock::now() - start;
+      allocations = allocation_count - allocations;
+
+      if (elapsed >= options_.min_time || iterations >= (1ULL << 32)) {
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        double ns_per_op = ns / static_cast<double>(iterations);
+        results_.push_back(
+            {name, iterations, ns_per_op,
+             static_cast<double>(bytes_per_op) * 1e9 / ns_per_op,
+             static_cast<double>(allocations) /
+                 static_cast<double>(iterations)});
+        std::cerr << name << ": " << ns_per_op << " ns/op\n";
+        return;
+      }
+      iterations *= elapsed * 10 < options_.min_time ? 10 : 2;
+    }
+  }
+
+  void writeJson(std::ostream &out) const {
+    out << "{\"benchmarks\":[";
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const Result &result = results_[i];
+      out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << result.name
+          << "\",\"iterations\":" << result.iterations
+          << ",\"ns_per_op\":" << result.ns_per_op
+          << ",\"bytes_per_second\":" << result.bytes_per_second
+          << ",\"allocs_per_op\":" << result.allocs_per_op << "}";
+    }
+    out << "\n]}\n";
+  }
+
+private:
+  const Options &options_;
+  std::vector<Result> results_;
+};
+
+void appendVarint(std::vector<uint8_t> &out, uint64_t value) {
+  if (value > 0x00FFFFFFFFFFFFFFULL) {
+    uint8_t bytes[9];
+    bytes[8] = static_cast<uint8_t>(value);
+    value >>= 8;
+    for (int i = 7; i >= 0; --i) {
+      bytes[i] = static_cast<uint8_t>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    out.insert(out.end(), bytes, bytes + 9);
+    return;
+  }
+  uint8_t bytes[8];
+  int n = 0;
+  do {
+    bytes[n++] = static_cast<uint8_t>((value & 0x7F) | 0x80);
+    value >>= 7;
+  } while (value != 0);
+  bytes[0] &= 0x7F;
+  while (n > 0) {
+    out.push_back(bytes[--n]);
+  }
+}
+
+void appendBigEndian(std::vector<uint8_t> &out, uint64_t value, int bytes) {
+  for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void putU16(std::vector<uint8_t> &page, size_t offset, uint16_t value) {
+  page[offset] = static_cast<uint8_t>(value >> 8);
+  page[offset + 1] = static_cast<uint8_t>(value);
+}
+
+void putU32(std::vector<uint8_t> &page, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    page[offset + i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+  }
+}
+
+// A record of alternating 64-bit integers and `text_width`-byte TEXT values
+std::vector<uint8_t> makeRecord(size_t columns, size_t text_width,
+                                std::mt19937_64 &rng) {
+  std::vector<uint8_t> types;
+  std::vector<uint8_t> body;
+  for (size_t i = 0; i < columns; ++i) {
+    if (i % 2 == 0) {
+      appendVarint(types, 6);
+      appendBigEndian(body, rng(), 8);
+    } else {
+      appendVarint(types, 13 + 2 * text_width);
+      for (size_t j = 0; j < text_width; ++j) {
+        body.push_back(static_cast<uint8_t>('a' + rng() % 26));
+      }
+    }
+  }
+
+  // The header size varint counts itself
+  std::vector<uint8_t> record;
+  size_t header_size = types.size() + 1;
+  if (header_size > 127) {
+    ++header_size;
+  }
+  appendVarint(record, header_size);
+  record.insert(record.end(), types.begin(), types.end());
+  record.insert(record.end(), body.begin(), body.end());
+  return record;
+}
+
+// Page images written to a temporary file that FileReader can open. Page 1
+// is left blank so that no page carries the database header.
+class PageFile {
+public:
+  explicit PageFile(uint16_t page_size)
+      : page_size_(page_size),
+        path_((std::filesystem::temp_directory_path() /
+               ("tez_bench_" + std::to_string(getpid()) + "_" +
+                std::to_string(page_size) + ".db"))
+                  .string()) {
+    pages_.emplace_back(page_size, 0);
+  }
+  ~PageFile() { std::filesystem::remove(path_); }
+
+  PageFile(const PageFile &) = delete;
+  PageFile &operator=(const PageFile &) = delete;
+
+  uint32_t add(std::vector<uint8_t> page) {
+    page.resize(page_size_, 0);
+    pages_.push_back(std::move(page));
+    return static_cast<uint32_t>(pages_.size());
+  }
+
+  [[nodiscard]] uint32_t nextPage() const noexcept {
+    return static_cast<uint32_t>(pages_.size() + 1);
+  }
+
+  const std::string &write() {
+    std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+    for (const auto &page : pages_) {
+      out.write(reinterpret_cast<const char *>(page.data()), page.size());
+    }
+    return path_;
+  }
+
+  [[nodiscard]] uint16_t pageSize() const noexcept { return page_size_; }
+  [[nodiscard]] size_t bytes() const noexcept {
+    return pages_.size() * page_size_;
+  }
+
+private:
+  uint16_t page_size_;
+  std::string path_;
+  std::vector<std::vector<uint8_t>> pages_;
+};
+
+// Packs `cells` into a B-tree page of `type`, cell content growing down
+// from the end of the page as SQLite lays it out
+std::vector<uint8_t> makePage(PageType type, uint16_t page_size,
+                              const std::vector<std::vector<uint8_t>> &cells,
+                              uint32_t right_most = 0) {
+  const bool interior =
+      type == PageType::InteriorTable || type == PageType::InteriorIndex;
+  const size_t header_size = interior ? 12 : 8;
+
+  std::vector<uint8_t> page(page_size, 0);
+  size_t content = page_size;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    content -= cells[i].size();
+    std::copy(cells[i].begin(), cells[i].end(), page.begin() + content);
+    putU16(page, header_size + 2 * i, static_cast<uint16_t>(content));
+  }
+  page[0] = static_cast<uint8_t>(type);
+  putU16(page, 3, static_cast<uint16_t>(cells.size()));
+  putU16(page, 5, static_cast<uint16_t>(content));
+  if (interior) {
+    putU32(page, 8, right_most);
+  }
+  return page;
+}
+
+std::vector<uint8_t> leafTableCell(uint64_t rowid,
+                                   const std::vector<uint8_t> &record) {
+  std::vector<uint8_t> cell;
+  appendVarint(cell, record.size());
+  appendVarint(cell, rowid);
+  cell.insert(cell.end(), record.begin(), record.end());
+  return cell;
+}
+
+// Fills leaf table pages with `rows` records under one interior root and
+// returns the root's page number
+uint32_t buildTable(PageFile &file, uint64_t rows, size_t columns,
+                    size_t text_width, std::mt19937_64 &rng) {
+  const size_t usable = file.pageSize() - 8;
+  std::vector<std::pair<uint32_t, uint64_t>> leaves; // page, last rowid
+  std::vector<std::vector<uint8_t>> cells;
+  size_t used = 0;
+
+  auto flush = [&](uint64_t last_rowid) {
+    leaves.emplace_back(file.add(makePage(PageType::LeafTable,
+                                          file.pageSize(), cells)),
+                        last_rowid);
+    cells.clear();
+    used = 0;
+  };
+  for (uint64_t rowid = 1; rowid <= rows; ++rowid) {
+    auto cell = leafTableCell(rowid, makeRecord(columns, text_width, rng));
+    if (used + cell.size() + 2 > usable) {
+      flush(rowid - 1);
+    }
+    used += cell.size() + 2;
+    cells.push_back(std::move(cell));
+  }
+  flush(rows);
+
+  std::vector<std::vector<uint8_t>> pointers;
+  for (size_t i = 0; i + 1 < leaves.size(); ++i) {
+    std::vector<uint8_t> cell;
+    appendBigEndian(cell, leaves[i].first, 4);
+    appendVarint(cell, leaves[i].second);
+    pointers.push_back(std::move(cell));
+  }
+  return file.add(makePage(PageType::InteriorTable, file.pageSize(), pointers,
+                           leaves.back().first));
+}
+
+void benchVarint(Runner &runner) {
+  constexpr size_t COUNT = 4096;
+  for (int width : {1, 2, 3, 5, 9}) {
+    uint64_t value = width == 9 ? UINT64_MAX : (1ULL << (7 * width - 1));
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < COUNT; ++i) {
+      appendVarint(data, value);
+    }
+    ByteReader reader(data);
+    runner.run("varint/" + std::to_string(width), width, [&] {
+      if (reader.position() == data.size()) {
+        reader.seek(0);
+      }
+      keep(reader.readVarint());
+    });
+  }
+}
+
+void benchRecord(Runner &runner) {
+  std::mt19937_64 rng(1);
+  for (size_t columns : {2, 8, 32}) {
+    for (size_t width : {8, 64, 512}) {
+      std::vector<uint8_t> payload = makeRecord(columns, width, rng);
+      runner.run("record/" + std::to_string(columns) + "x" +
+                     std::to_string(width),
+                 payload.size(), [&] {
+                   BTreeRecord record(payload);
+                   keep(record.getValues().size());
+                 });
+    }
+  }
+}
+
+void benchPage(Runner &runner) {
+  std::mt19937_64 rng(2);
+  for (uint16_t page_size : {1024, 4096, 16384}) {
+    for (size_t width : {16, 128}) {
+      PageFile file(page_size);
+      buildTable(file, page_size / (width / 2 + 16), 4, width, rng);
+      FileReader reader(file.write());
+      runner.run("page/" + std::to_string(page_size) + "/" +
+                     std::to_string(width),
+                 page_size, [&] {
+                   BTreePage<PageType::LeafTable> page(reader, page_size, 2);
+                   keep(page.getCells().size());
+                 });
+    }
+  }
+}
+
+void benchOverflow(Runner &runner) {
+  const uint16_t page_size = 4096;
+  for (size_t payload : {16384, 262144}) {
+    PageFile file(page_size);
+    const size_t per_page = page_size - 4;
+    const uint32_t first = file.nextPage();
+    const size_t pages = (payload + per_page - 1) / per_page;
+    for (size_t i = 0; i < pages; ++i) {
+      std::vector<uint8_t> page;
+      appendBigEndian(page, i + 1 < pages ? first + i + 1 : 0, 4);
+      page.resize(page_size, static_cast<uint8_t>(i));
+      file.add(std::move(page));
+    }
+    FileReader reader(file.write());
+    runner.run("overflow/" + std::to_string(payload), payload, [&] {
+      keep(OverflowPage::readOverflowChain(reader, page_size, first).size());
+    });
+  }
+}
+
+void benchTraverse(Runner &runner) {
+  std::mt19937_64 rng(3);
+  for (uint16_t page_size : {4096, 16384}) {
+    for (uint64_t rows : {1000, 20000}) {
+      PageFile file(page_size);
+      uint32_t root = buildTable(file, rows, 4, 24, rng);
+      FileReader reader(file.write());
+      sqlite::Header header{};
+      header.page_size = page_size;
+      BTree btree(reader, header);
+      const std::vector<int> positions{0, 1, 2, 3};
+      runner.run("traverse/" + std::to_string(page_size) + "/" +
+                     std::to_string(rows),
+                 file.bytes(), [&] {
+                   uint64_t seen = 0;
+                   btree.traverse(root, positions, nullptr, [&](Row &&row) {
+                     seen += row.size();
+                     return true;
+                   });
+                   keep(seen);
+                 });
+    }
+  }
+}
+
+// One interior descent step: finding the child for a rowid among a page's
+// keys, as decoded cells and as the dense array resident pages keep
+void benchSearch(Runner &runner) {
+  using Cell = BTreePage<PageType::InteriorTable>::Cell;
+  std::mt19937_64 rng(4);
+  for (size_t count : {16, 64, 256, 512}) {
+    std::vector<uint64_t> keys(count);
+    for (auto &key : keys) {
+      key = rng() >> 16;
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<Cell> cells(count);
+    for (size_t i = 0; i < count; ++i) {
+      cells[i].interior_row_id = keys[i];
+    }
+    std::vector<uint64_t> targets(1024);
+    for (auto &target : targets) {
+      target = rng() >> 16;
+    }
+
+    size_t next = 0;
+    runner.run("search/cells/" + std::to_string(count), sizeof(uint64_t),
+               [&] {
+                 uint64_t target = targets[next++ % targets.size()];
+                 keep(std::lower_bound(cells.begin(), cells.end(), target,
+                                       [](const Cell &cell, uint64_t rowid) {
+                                         return cell.interior_row_id < rowid;
+                                       }) -
+                      cells.begin());
+               });
+    runner.run("search/keys/" + std::to_string(count), sizeof(uint64_t), [&] {
+      keep(searchKeys(keys.data(), keys.size(),
+                      targets[next++ % targets.size()]));
+    });
+  }
+}
+
+// Ordering two index entries (a text key and a rowid) by their decoded
+// values and by memcmp of their normalized keys
+void benchCompare(Runner &runner) {
+  std::mt19937_64 rng(5);
+  std::vector<std::vector<RecordValue>> entries(1024);
+  for (auto &entry : entries) {
+    std::string text(12, 'k');
+    text[rng() % text.size()] = static_cast<char>('a' + rng() % 26);
+    entry = {std::move(text), static_cast<int64_t>(rng() >> 1)};
+  }
+  std::vector<std::string> keys;
+  for (const auto &entry : entries) {
+    keys.push_back(NormalizedKey::encode(entry));
+  }
+
+  size_t next = 0;
+  runner.run("compare/records", 0, [&] {
+    size_t i = next++ % entries.size();
+    keep(compareRecords(entries[i], entries[(i + 1) % entries.size()]));
+  });
+  runner.run("compare/normalized", 0, [&] {
+    size_t i = next++ % keys.size();
+    keep(keys[i].compare(keys[(i + 1) % keys.size()]));
+  });
+  runner.run("compare/encode", 0, [&] {
+    keep(NormalizedKey::encode(entries[next++ % entries.size()]).size());
+  });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << "\n";
+      return 1;
+    }
+    if (arg == "--filter") {
+      options.filter = argv[++i];
+    } else if (arg == "--min-time-ms") {
+      options.min_time = std::chrono::milliseconds(std::stoll(argv[++i]));
+    } else if (arg == "--output") {
+      options.output = argv[++i];
+    } else {
+      std::cerr << "Unknown option: " << arg << "\n";
+      return 1;
+    }
+  }
+
+  Runner runner(options);
+  benchVarint(runner);
+  benchRecord(runner);
+  benchPage(runner);
+  benchOverflow(runner);
+  benchTraverse(runner);
+  benchSearch(runner);
+  benchCompare(runner);
+
+  if (options.output.empty()) {
+    runner.writeJson(std::cout);
+  } else {
+    std::ofstream out(options.output);
+    runner.writeJson(out);
+  }
+  return 0;
+}
@@ -0,0 +1,781 @@
+// Writes a synthetic SQLite database of one table, and optional secondary
+// indexes, straight to disk so that large multi-level B-trees and overflow
+// chains can be benchmarked offline. Output is deterministic for a seed.
+//
+//   gen_db OUTPUT [--rows N] [--page-size N] [--seed N] [--table NAME]
+//                 [--column NAME:int[:CARDINALITY]] [--column NAME:real]
+//                 [--column NAME:text:WIDTH[:CARDINALITY]]
+//                 [--overflow FRACTION] [--overflow-bytes N] [--index NAME]
+//
+// The table always starts with `id INTEGER PRIMARY KEY`, numbered from 1.
+// With --overflow, a trailing `payload BLOB` column holds --overflow-bytes
+// bytes in that fraction of rows and 16 bytes in the rest. Table pages are
+// streamed to disk; index entries are kept in memory and sorted.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace {
+
+enum class ColumnType { Integer, Real, Text };
+
+struct ColumnSpec {
+  std::string name;
+  ColumnType type;
+  uint64_t width{0};
+  // Number of distinct values, or 0 for no limit
+  uint64_t cardinality{0};
+};
+
+struct Options {
+  std::string output;
+  uint64_t rows{100000};
+  uint32_t page_size{4096};
+  uint64_t seed{1};
+  std::string table{"t"};
+  std::vector<ColumnSpec> columns;
+  double overflow{0.0};
+  uint64_t overflow_bytes{0};
+  std::vector<std::string> indexes;
+};
+
+// SplitMix64: small, fast and good enough for synthetic data
+class Random {
+public:
+  explicit Random(uint64_t seed) noexcept : state_(seed) {}
+
+  uint64_t next() noexcept {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  double unit() noexcept {
+    return static_cast<double>(next() >> 11) * 0x1.0p-53;
+  }
+
+private:
+  uint64_t state_;
+};
+
+using Value = std::variant<std::monostate, int64_t, double, std::string>;
+
+size_t varintSize(uint64_t value) noexcept {
+  if (value > 0x00FFFFFFFFFFFFFFULL) {
+    return 9;
+  }
+  size_t size = 1;
+  while (value >>= 7) {
+    ++size;
+  }
+  return size;
+}
+
+void appendVarint(std::vector<uint8_t> &out, uint64_t value) {
+  if (value > 0x00FFFFFFFFFFFFFFULL) {
+    uint8_t bytes[9];
+    bytes[8] = static_cast<uint8_t>(value);
+    value >>= 8;
+    for (int i = 7; i >= 0; --i) {
+      bytes[i] = static_cast<uint8_t>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    out.insert(out.end(), bytes, bytes + 9);
+    return;
+  }
+  uint8_t bytes[8];
+  int n = 0;
+  do {
+    bytes[n++] = static_cast<uint8_t>((value & 0x7F) | 0x80);
+    value >>= 7;
+  } while (value != 0);
+  bytes[0] &= 0x7F;
+  while (n > 0) {
+    out.push_back(bytes[--n]);
+  }
+}
+
+void appendBigEndian(std::vector<uint8_t> &out, uint64_t value, int bytes) {
+  for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void putBigEndian(uint8_t *out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+  }
+}
+
+// Smallest serial type for an integer, and its body size
+std::pair<uint64_t, int> integerSerialType(int64_t value) noexcept {
+  if (value == 0) {
+    return {8, 0};
+  }
+  if (value == 1) {
+    return {9, 0};
+  }
+  constexpr std::pair<uint64_t, int> TYPES[] = {
+      {1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 6}};
+  for (auto [type, bytes] : TYPES) {
+    int64_t limit = int64_t{1} << (8 * bytes - 1);
+    if (value >= -limit && value < limit) {
+      return {type, bytes};
+    }
+  }
+  return {6, 8};
+}
+
+// Encodes `values` as a record, followed by `blob` as a BLOB column when
+// one is given
+void encodeRecord(std::vector<uint8_t> &out, const std::vector<Value> &values,
+                  const std::vector<uint8_t> *blob = nullptr) {
+  std::vector<uint8_t> types;
+  for (const Value &value : values) {
+    if (std::holds_alternative<std::monostate>(value)) {
+      appendVarint(types, 0);
+    } else if (auto *integer = std::get_if<int64_t>(&value)) {
+      appendVarint(types, integerSerialType(*integer).first);
+    } else if (std::holds_alternative<double>(value)) {
+      appendVarint(types, 7);
+    } else {
+      appendVarint(types, 13 + 2 * std::get<std::string>(value).size());
+    }
+  }
+  if (blob) {
+    appendVarint(types, 12 + 2 * blob->size());
+  }
+
+  // The header size counts its own varint
+  size_t header_size = types.size() + 1;
+  if (varintSize(header_size) > 1) {
+    header_size += varintSize(header_size + 1) - 1;
+  }
+  out.clear();
+  appendVarint(out, header_size);
+  out.insert(out.end(), types.begin(), types.end());
+  for (const Value &value : values) {
+    if (auto *integer = std::get_if<int64_t>(&value)) {
+      auto [type, bytes] = integerSerialType(*integer);
+      appendBigEndian(out, static_cast<uint64_t>(*integer), bytes);
+    } else if (auto *real = std::get_if<double>(&value)) {
+      uint64_t bits;
+      std::memcpy(&bits, real, sizeof(bits));
+      appendBigEndian(out, bits, 8);
+    } else if (auto *text = std::get_if<std::string>(&value)) {
+      out.insert(out.end(), text->begin(), text->end());
+    }
+  }
+  if (blob) {
+    out.insert(out.end(), blob->begin(), blob->end());
+  }
+}
+
+std::string randomText(Random &random, uint64_t width) {
+  std::string text(width, 'a');
+  for (char &c : text) {
+    c = static_cast<char>('a' + random.next() % 26);
+  }
+  return text;
+}
+
+Value generateValue(const ColumnSpec &column, Random &random,
+                    uint64_t seed) {
+  switch (column.type) {
+  case ColumnType::Integer:
+    return static_cast<int64_t>(
+        random.next() % (column.cardinality ? column.cardinality : 1ULL << 31));
+  case ColumnType::Real:
+    return random.unit() * 1000.0;
+  case ColumnType::Text:
+    if (column.cardinality) {
+      // The same key always spells the same string
+      Random key(seed ^ (random.next() % column.cardinality) * 0x2545F491ULL);
+      return randomText(key, column.width);
+    }
+    return randomText(random, column.width);
+  }
+  return {};
+}
+
+// Pages are allocated in order and written wherever they land. Page 1 is
+// reserved for the header and sqlite_schema, written last.
+class PageWriter {
+public:
+  PageWriter(const std::string &path, uint32_t page_size)
+      : out_(path, std::ios::binary | std::ios::trunc), page_size_(page_size) {
+    if (!out_) {
+      throw std::runtime_error("Cannot open output file: " + path);
+    }
+  }
+
+  [[nodiscard]] uint32_t allocate() noexcept { return ++page_count_; }
+  [[nodiscard]] uint32_t pageCount() const noexcept { return page_count_; }
+  [[nodiscard]] uint32_t pageSize() const noexcept { return page_size_; }
+
+  void write(uint32_t page, const std::vector<uint8_t> &data) {
+    out_.seekp(static_cast<std::streamoff>(page - 1) * page_size_);
+    out_.write(reinterpret_cast<const char *>(data.data()), page_size_);
+    if (!out_) {
+      throw std::runtime_error("Failed to write page " +
+                               std::to_string(page));
+    }
+  }
+
+  // Bytes of a payload of `size` stored in the cell itself. Table leaves
+  // allow more local bytes than index pages.
+  [[nodiscard]] size_t localSize(size_t size, bool table_leaf) const noexcept {
+    size_t usable = page_size_;
+    size_t max_local =
+        table_leaf ? usable - 35 : (usable - 12) * 64 / 255 - 23;
+    if (size <= max_local) {
+      return size;
+    }
+    size_t min_local = (usable - 12) * 32 / 255 - 23;
+    size_t local = min_local + (size - min_local) % (usable - 4);
+    return local <= max_local ? local : min_local;
+  }
+
+  // Size of the payload part of a cell: length varint, local bytes and
+  // overflow pointer
+  [[nodiscard]] size_t payloadCellSize(size_t size,
+                                       bool table_leaf) const noexcept {
+    size_t local = localSize(size, table_leaf);
+    return varintSize(size) + local + (local < size ? 4 : 0);
+  }
+
+  // Appends the local part of `payload` to `cell`, spilling the rest into
+  // a freshly written overflow chain
+  void appendPayload(std::vector<uint8_t> &cell,
+                     const std::vector<uint8_t> &payload, bool table_leaf) {
+    size_t local = localSize(payload.size(), table_leaf);
+    cell.insert(cell.end(), payload.begin(), payload.begin() + local);
+    if (local == payload.size()) {
+      return;
+    }
+
+    const size_t per_page = page_size_ - 4;
+    uint32_t page = allocate();
+    appendBigEndian(cell, page, 4);
+    std::vector<uint8_t> data(page_size_);
+    for (size_t offset = local; offset < payload.size();) {
+      size_t chunk = std::min(per_page, payload.size() - offset);
+      uint32_t next = offset + chunk < payload.size() ? allocate() : 0;
+      std::fill(data.begin(), data.end(), 0);
+      putBigEndian(data.data(), next, 4);
+      std::copy_n(payload.begin() + offset, chunk, data.begin() + 4);
+      write(page, data);
+      offset += chunk;
+      page = next;
+    }
+  }
+
+private:
+  std::ofstream out_;
+  uint32_t page_size_;
+  uint32_t page_count_{1};
+};
+
+// Lays out one B-tree page: cell pointers after the header, cell content
+// packed down from the end of the page
+class PageBuilder {
+public:
+  PageBuilder(uint32_t page_size, bool interior, size_t header_offset = 0)
+      : data_(page_size, 0), header_offset_(header_offset),
+        header_size_(interior ? 12 : 8), content_(page_size) {}
+
+  [[nodiscard]] bool fits(size_t cell_size) const noexcept {
+    return header_offset_ + header_size_ + 2 * (count_ + 1) + cell_size <=
+           content_;
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return count_ == 0; }
+
+  void add(const std::vector<uint8_t> &cell) {
+    content_ -= cell.size();
+    std::copy(cell.begin(), cell.end(), data_.begin() + content_);
+    putBigEndian(&data_[header_offset_ + header_size_ + 2 * count_], content_,
+                 2);
+    ++count_;
+  }
+
+  const std::vector<uint8_t> &finish(uint8_t type, uint32_t right_most = 0) {
+    uint8_t *header = &data_[header_offset_];
+    header[0] = type;
+    putBigEndian(header + 3, count_, 2);
+    // A content start of 65536 is stored as zero
+    putBigEndian(header + 5, content_ & 0xFFFF, 2);
+    if (header_size_ == 12) {
+      putBigEndian(header + 8, right_most, 4);
+    }
+    return data_;
+  }
+
+  void reset() {
+    std::fill(data_.begin(), data_.end(), 0);
+    count_ = 0;
+    content_ = data_.size();
+  }
+
+private:
+  std::vector<uint8_t> data_;
+  size_t header_offset_;
+  size_t header_size_;
+  size_t count_{0};
+  size_t content_;
+};
+
+constexpr uint8_t INTERIOR_INDEX = 0x02;
+constexpr uint8_t INTERIOR_TABLE = 0x05;
+constexpr uint8_t LEAF_INDEX = 0x0A;
+constexpr uint8_t LEAF_TABLE = 0x0D;
+
+// Builds a table B-tree from rows added in rowid order, writing each page
+// as soon as it fills. Every interior level keeps only the children of its
+// open page.
+class TableTreeBuilder {
+public:
+  explicit TableTreeBuilder(PageWriter &writer)
+      : writer_(writer), leaf_(writer.pageSize(), false) {}
+
+  void add(uint64_t rowid, const std::vector<uint8_t> &record) {
+    cell_.clear();
+    appendVarint(cell_, record.size());
+    appendVarint(cell_, rowid);
+    size_t size = cell_.size() + writer_.payloadCellSize(record.size(), true) -
+                  varintSize(record.size());
+    if (!leaf_.fits(size)) {
+      flushLeaf();
+    }
+    writer_.appendPayload(cell_, record, true);
+    leaf_.add(cell_);
+    last_rowid_ = rowid;
+  }
+
+  // Writes the open pages and returns the root page
+  uint32_t finish() {
+    if (!leaf_.empty() || levels_.empty()) {
+      flushLeaf();
+    }
+    for (size_t level = 0;; ++level) {
+      auto &children = levels_[level].children;
+      if (level + 1 == levels_.size() && children.size() == 1) {
+        return children.front().page;
+      }
+      Child child = writeInterior(children.begin(), children.end());
+      addChild(level + 1, child);
+    }
+  }
+
+private:
+  struct Child {
+    uint32_t page;
+    uint64_t max_rowid;
+  };
+
+  struct Level {
+    std::vector<Child> children;
+    // Cell bytes of all children but the last, which is the right pointer
+    size_t cell_bytes{0};
+  };
+
+  static size_t cellSize(const Child &child) noexcept {
+    return 4 + varintSize(child.max_rowid) + 2;
+  }
+
+  void flushLeaf() {
+    uint32_t page = writer_.allocate();
+    writer_.write(page, leaf_.finish(LEAF_TABLE));
+    leaf_.reset();
+    addChild(0, {page, last_rowid_});
+  }
+
+  void addChild(size_t level, Child child) {
+    if (level == levels_.size()) {
+      levels_.emplace_back();
+    }
+    Level &open = levels_[level];
+    if (open.children.empty()) {
+      open.children.push_back(child);
+      return;
+    }
+
+    size_t bytes = open.cell_bytes + cellSize(open.children.back());
+    if (12 + bytes <= writer_.pageSize()) {
+      open.cell_bytes = bytes;
+      open.children.push_back(child);
+      return;
+    }
+
+    // Close the page one child early so that the next page starts with two
+    // children and never ends up with a right pointer alone
+    auto &children = open.children;
+    Child parent = writeInterior(children.begin(), children.end() - 1);
+    Child carried = children.back();
+    children = {carried, child};
+    open.cell_bytes = cellSize(carried);
+    addChild(level + 1, parent);
+  }
+
+  Child writeInterior(std::vector<Child>::const_iterator first,
+                      std::vector<Child>::const_iterator last) {
+    PageBuilder page(writer_.pageSize(), true);
+    std::vector<uint8_t> cell;
+    for (auto it = first; it + 1 != last; ++it) {
+      cell.clear();
+      appendBigEndian(cell, it->page, 4);
+      appendVarint(cell, it->max_rowid);
+      page.add(cell);
+    }
+    uint32_t number = writer_.allocate();
+    writer_.write(number, page.finish(INTERIOR_TABLE, (last - 1)->page));
+    return {number, (last - 1)->max_rowid};
+  }
+
+  PageWriter &writer_;
+  PageBuilder leaf_;
+  uint64_t last_rowid_{0};
+  std::vector<Level> levels_;
+  std::vector<uint8_t> cell_;
+};
+
+struct IndexEntry {
+  Value key;
+  uint64_t rowid;
+
+  bool operator<(const IndexEntry &other) const {
+    if (key != other.key) {
+      return key < other.key;
+    }
+    return rowid < other.rowid;
+  }
+};
+
+// Builds an index B-tree bottom up from sorted entries. Each level is a run
+// of pages separated by single entries that move up into the parent.
+class IndexTreeBuilder {
+public:
+  IndexTreeBuilder(PageWriter &writer, const std::vector<IndexEntry> &entries)
+      : writer_(writer), entries_(entries) {}
+
+  uint32_t build() {
+    std::vector<uint32_t> nodes;
+    std::vector<size_t> separators;
+    buildLeaves(nodes, separators);
+    while (nodes.size() > 1) {
+      buildInteriorLevel(nodes, separators);
+    }
+    return nodes.front();
+  }
+
+private:
+  const std::vector<uint8_t> &payload(size_t entry) {
+    encodeRecord(payload_,
+                 {entries_[entry].key,
+                  static_cast<int64_t>(entries_[entry].rowid)});
+    return payload_;
+  }
+
+  size_t cellSize(size_t entry) {
+    return writer_.payloadCellSize(payload(entry).size(), false) + 2;
+  }
+
+  void appendCell(std::vector<uint8_t> &cell, size_t entry) {
+    const auto &record = payload(entry);
+    appendVarint(cell, record.size());
+    writer_.appendPayload(cell, record, false);
+  }
+
+  void buildLeaves(std::vector<uint32_t> &nodes,
+                   std::vector<size_t> &separators) {
+    const size_t room = writer_.pageSize() - 8;
+    const size_t count = entries_.size();
+    size_t next = 0;
+    do {
+      size_t first = next;
+      size_t used = 0;
+      while (next < count && used + cellSize(next) <= room) {
+        used += cellSize(next++);
+      }
+      // The entry after a full page moves up, unless it is the last one:
+      // then the page gives up its own last entry so that one remains
+      size_t end = next;
+      if (end + 1 == count) {
+        --end;
+      }
+
+      PageBuilder page(writer_.pageSize(), false);
+      for (size_t entry = first; entry < end; ++entry) {
+        cell_.clear();
+        appendCell(cell_, entry);
+        page.add(cell_);
+      }
+      nodes.push_back(writer_.allocate());
+      writer_.write(nodes.back(), page.finish(LEAF_INDEX));
+      if (end < count) {
+        separators.push_back(end);
+      }
+      next = end + 1;
+    } while (next < count);
+  }
+
+  void buildInteriorLevel(std::vector<uint32_t> &nodes,
+                          std::vector<size_t> &separators) {
+    const size_t room = writer_.pageSize() - 12;
+    std::vector<uint32_t> parents;
+    std::vector<size_t> parent_separators;
+    size_t first = 0;
+    while (first < nodes.size()) {
+      // Cells pair nodes[i] with separators[i]; the last node taken becomes
+      // the right pointer
+      size_t last = first;
+      size_t used = 0;
+      while (last + 1 < nodes.size() &&
+             used + 4 + cellSize(separators[last]) <= room) {
+        used += 4 + cellSize(separators[last++]);
+      }
+      // Leave the next page at least two children
+      if (last + 2 == nodes.size()) {
+        --last;
+      }
+
+      PageBuilder page(writer_.pageSize(), true);
+      for (size_t i = first; i < last; ++i) {
+        cell_.clear();
+        appendBigEndian(cell_, nodes[i], 4);
+        appendCell(cell_, separators[i]);
+        page.add(cell_);
+      }
+      parents.push_back(writer_.allocate());
+      writer_.write(parents.back(), page.finish(INTERIOR_INDEX, nodes[last]));
+      if (last + 1 < nodes.size()) {
+        parent_separators.push_back(separators[last]);
+      }
+      first = last + 1;
+    }
+    nodes = std::move(parents);
+    separators = std::move(parent_separators);
+  }
+
+  PageWriter &writer_;
+  const std::vector<IndexEntry> &entries_;
+  std::vector<uint8_t> payload_;
+  std::vector<uint8_t> cell_;
+};
+
+std::string columnTypeName(ColumnType type) {
+  switch (type) {
+  case ColumnType::Integer:
+    return "INTEGER";
+  case ColumnType::Real:
+    return "REAL";
+  case ColumnType::Text:
+    return "TEXT";
+  }
+  return "";
+}
+
+void writeHeader(std::vector<uint8_t> &page, uint32_t page_size,
+                 uint32_t page_count) {
+  const char magic[] = "SQLite format 3";
+  std::copy(magic, magic + sizeof(magic), page.begin());
+  putBigEndian(&page[16], page_size == 65536 ? 1 : page_size, 2);
+  page[18] = 1; // legacy journal write and read versions
+  page[19] = 1;
+  page[21] = 64; // payload fractions
+  page[22] = 32;
+  page[23] = 32;
+  putBigEndian(&page[24], 1, 4); // file change counter
+  putBigEndian(&page[28], page_count, 4);
+  putBigEndian(&page[40], 1, 4); // schema cookie
+  putBigEndian(&page[44], 4, 4); // schema format
+  putBigEndian(&page[56], 1, 4); // UTF-8
+  putBigEndian(&page[92], 1, 4); // version-valid-for
+  putBigEndian(&page[96], 3045000, 4);
+}
+
+ColumnSpec parseColumn(const std::string &spec) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (size_t colon; (colon = spec.find(':', start)) != std::string::npos;
+       start = colon + 1) {
+    parts.push_back(spec.substr(start, colon - start));
+  }
+  parts.push_back(spec.substr(start));
+
+  ColumnSpec column{parts[0], ColumnType::Integer};
+  const std::string &type = parts.size() > 1 ? parts[1] : "";
+  if (type == "int" && parts.size() <= 3) {
+    column.cardinality = parts.size() == 3 ? std::stoull(parts[2]) : 0;
+  } else if (type == "real" && parts.size() == 2) {
+    column.type = ColumnType::Real;
+  } else if (type == "text" && (parts.size() == 3 || parts.size() == 4)) {
+    column.type = ColumnType::Text;
+    column.width = std::stoull(parts[2]);
+    column.cardinality = parts.size() == 4 ? std::stoull(parts[3]) : 0;
+  } else {
+    throw std::runtime_error("Invalid column: " + spec);
+  }
+  if (column.name.empty()) {
+    throw std::runtime_error("Invalid column: " + spec);
+  }
+  return column;
+}
+
+Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      options.output = arg;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + arg);
+    }
+    std::string value = argv[++i];
+    if (arg == "--rows") {
+      options.rows = std::stoull(value);
+    } else if (arg == "--page-size") {
+      options.page_size = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--seed") {
+      options.seed = std::stoull(value);
+    } else if (arg == "--table") {
+      options.table = value;
+    } else if (arg == "--column") {
+      options.columns.push_back(parseColumn(value));
+    } else if (arg == "--overflow") {
+      options.overflow = std::stod(value);
+    } else if (arg == "--overflow-bytes") {
+      options.overflow_bytes = std::stoull(value);
+    } else if (arg == "--index") {
+      options.indexes.push_back(value);
+    } else {
+      throw std::runtime_error("Unknown option: " + arg);
+    }
+  }
+
+  if (options.output.empty()) {
+    throw std::runtime_error("Missing output file");
+  }
+  uint32_t size = options.page_size;
+  if (size < 512 || size > 65536 || (size & (size - 1)) != 0) {
+    throw std::runtime_error("Page size must be a power of two in 512-65536");
+  }
+  if (options.columns.empty()) {
+    options.columns = {parseColumn("a:int:1000"), parseColumn("b:real"),
+                       parseColumn("c:text:24")};
+  }
+  if (options.overflow_bytes == 0) {
+    options.overflow_bytes = 4 * static_cast<uint64_t>(size);
+  }
+  return options;
+}
+
+void generate(const Options &options) {
+  PageWriter writer(options.output, options.page_size);
+
+  std::vector<size_t> index_columns;
+  for (const auto &name : options.indexes) {
+    auto it = std::find_if(
+        options.columns.begin(), options.columns.end(),
+        [&name](const ColumnSpec &column) { return column.name == name; });
+    if (it == options.columns.end()) {
+      throw std::runtime_error("Index on unknown column: " + name);
+    }
+    index_columns.push_back(it - options.columns.begin());
+  }
+
+  Random random(options.seed);
+  TableTreeBuilder table(writer);
+  std::vector<std::vector<IndexEntry>> index_entries(index_columns.size());
+  std::vector<Value> values(options.columns.size() + 1);
+  std::vector<uint8_t> blob;
+  std::vector<uint8_t> record;
+  for (uint64_t rowid = 1; rowid <= options.rows; ++rowid) {
+    // The INTEGER PRIMARY KEY column is stored as NULL
+    values[0] = std::monostate{};
+    for (size_t i = 0; i < options.columns.size(); ++i) {
+      values[i + 1] = generateValue(options.columns[i], random, options.seed);
+    }
+    if (options.overflow > 0) {
+      blob.resize(random.unit() < options.overflow ? options.overflow_bytes
+                                                   : 16);
+      for (auto &byte : blob) {
+        byte = static_cast<uint8_t>(random.next());
+      }
+    }
+    encodeRecord(record, values, options.overflow > 0 ? &blob : nullptr);
+    table.add(rowid, record);
+    for (size_t i = 0; i < index_columns.size(); ++i) {
+      index_entries[i].push_back({values[index_columns[i] + 1], rowid});
+    }
+  }
+  uint32_t table_root = table.finish();
+
+  std::string sql = "CREATE TABLE " + options.table +
+                    " (id INTEGER PRIMARY KEY";
+  for (const auto &column : options.columns) {
+    sql += ", " + column.name + " " + columnTypeName(column.type);
+  }
+  sql += options.overflow > 0 ? ", payload BLOB)" : ")";
+  std::vector<std::vector<Value>> schema{
+      {"table", options.table, options.table, int64_t{table_root}, sql}};
+
+  for (size_t i = 0; i < index_columns.size(); ++i) {
+    auto &entries = index_entries[i];
+    std::sort(entries.begin(), entries.end());
+    uint32_t root = IndexTreeBuilder(writer, entries).build();
+    std::vector<IndexEntry>().swap(entries);
+
+    const std::string &column = options.indexes[i];
+    std::string name = options.table + "_by_" + column;
+    schema.push_back({"index", name, options.table, int64_t{root},
+                      "CREATE INDEX " + name + " ON " + options.table + " (" +
+                          column + ")"});
+  }
+
+  PageBuilder schema_page(options.page_size, false, 100);
+  std::vector<uint8_t> cell;
+  for (size_t i = 0; i < schema.size(); ++i) {
+    encodeRecord(record, schema[i]);
+    cell.clear();
+    appendVarint(cell, record.size());
+    appendVarint(cell, i + 1);
+    writer.appendPayload(cell, record, true);
+    if (!schema_page.fits(cell.size())) {
+      throw std::runtime_error("Schema does not fit on the first page");
+    }
+    schema_page.add(cell);
+  }
+  std::vector<uint8_t> first = schema_page.finish(LEAF_TABLE);
+  writeHeader(first, options.page_size, writer.pageCount());
+  writer.write(1, first);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    Options options = parseOptions(argc, argv);
+    auto start = std::chrono::steady_clock::now();
+    generate(options);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cerr << "Wrote " << options.rows << " rows to " << options.output
+              << " in " << elapsed.count() << " s\n";
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
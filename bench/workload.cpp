@@ -0,0 +1,570 @@
+// Runs a weighted mix of parameterized queries against a database from
+// several threads for a fixed time, then prints throughput, latency
+// percentiles and I/O counters as JSON.
+//
+//   workload DB TEMPLATES [--threads N] [--duration SECONDS] [--seed N]
+//                         [--no-stats] [--prefetch] [--resident]
+//                         [--result-cache BYTES] [--output FILE]
+//
+// Each non-empty line of the template file that does not start with '#'
+// is `NAME[*WEIGHT] = SQL`. The SQL may hold placeholders:
+//
+//   {uniform:LO:HI}       integer drawn uniformly from [LO, HI]
+//   {zipf:LO:HI[:S]}      integer from [LO, HI], LO the most frequent,
+//                         with skew S (default 0.99)
+//   {uniform:A|B|C}       one of the listed values, verbatim
+//   {zipf:A|B|C[:S]}      one of the listed values, A the most frequent
+//
+// Every thread gets its own Database, since readers are not thread-safe.
+
+#include "database.hpp"
+#include "query_stats.hpp"
+#include "sql_parser.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Log-linear latency buckets in the style of HdrHistogram: values below
+// 128 ns are exact, and every power of two above is split into 64 buckets,
+// keeping the relative error under 1.6%.
+class LatencyHistogram {
+public:
+  LatencyHistogram() : counts_(BUCKETS, 0) {}
+
+  void record(uint64_t ns) noexcept {
+    ++counts_[index(ns)];
+    ++count_;
+    sum_ += ns;
+    max_ = std::max(max_, ns);
+  }
+
+  void merge(const LatencyHistogram &other) noexcept {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  // Upper bound of the bucket holding the given quantile
+  [[nodiscard]] uint64_t percentile(double quantile) const noexcept {
+    if (count_ == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(std::ceil(quantile * count_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      seen += counts_[i];
+      if (seen >= std::max<uint64_t>(rank, 1)) {
+        return std::min(upperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  [[nodiscard]] uint64_t count() const noexcept { return count_; }
+  [[nodiscard]] uint64_t max() const noexcept { return max_; }
+  [[nodiscard]] double mean() const noexcept {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+  }
+
+private:
+  static constexpr size_t SUB_BITS = 7;
+  static constexpr uint64_t SUB_COUNT = 1 << SUB_BITS;
+  static constexpr uint64_t HALF = SUB_COUNT / 2;
+  static constexpr size_t BUCKETS = SUB_COUNT + (64 - SUB_BITS) * HALF;
+
+  static size_t index(uint64_t ns) noexcept {
+    if (ns < SUB_COUNT) {
+      return ns;
+    }
+    size_t shift = std::bit_width(ns) - SUB_BITS;
+    return SUB_COUNT + (shift - 1) * HALF + ((ns >> shift) - HALF);
+  }
+
+  static uint64_t upperBound(size_t index) noexcept {
+    if (index < SUB_COUNT) {
+      return index;
+    }
+    size_t shift = (index - SUB_COUNT) / HALF + 1;
+    uint64_t top = (index - SUB_COUNT) % HALF + HALF;
+    return ((top + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  uint64_t max_{0};
+};
+
+// Zipfian ranks in [0, n) by the method of Gray et al., "Quickly
+// Generating Billion-Record Synthetic Databases", as YCSB uses it
+class ZipfianDistribution {
+public:
+  ZipfianDistribution(uint64_t n, double skew) : n_(n), skew_(skew) {
+    for (uint64_t i = 1; i <= n; ++i) {
+      zeta_n_ += 1.0 / std::pow(static_cast<double>(i), skew);
+    }
+    double zeta_2 = 1.0 + 1.0 / std::pow(2.0, skew);
+    alpha_ = 1.0 / (1.0 - skew);
+    eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - skew)) /
+           (1.0 - zeta_2 / zeta_n_);
+  }
+
+  uint64_t operator()(std::mt19937_64 &rng) const {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    double uz = u * zeta_n_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, skew_)) {
+      return std::min<uint64_t>(1, n_ - 1);
+    }
+    auto rank = static_cast<uint64_t>(static_cast<double>(n_) *
+                                      std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(rank, n_ - 1);
+  }
+
+private:
+  uint64_t n_;
+  double skew_;
+  double zeta_n_{0.0};
+  double alpha_{0.0};
+  double eta_{0.0};
+};
+
+struct Placeholder {
+  size_t offset; // where the value goes in the template text
+  bool zipfian;
+  int64_t low{0};
+  uint64_t range{1};
+  std::vector<std::string> values{}; // drawn from instead of [low, low+range)
+  std::shared_ptr<ZipfianDistribution> zipf{};
+
+  std::string draw(std::mt19937_64 &rng) const {
+    uint64_t rank =
+        zipfian ? (*zipf)(rng)
+                : std::uniform_int_distribution<uint64_t>(0, range - 1)(rng);
+    if (!values.empty()) {
+      return values[rank];
+    }
+    return std::to_string(low + static_cast<int64_t>(rank));
+  }
+};
+
+struct QueryTemplate {
+  std::string name;
+  uint64_t weight{1};
+  // The SQL with placeholders removed
+  std::string text;
+  std::vector<Placeholder> placeholders;
+
+  std::string instantiate(std::mt19937_64 &rng) const {
+    std::string sql;
+    size_t copied = 0;
+    for (const auto &placeholder : placeholders) {
+      sql.append(text, copied, placeholder.offset - copied);
+      sql += placeholder.draw(rng);
+      copied = placeholder.offset;
+    }
+    sql.append(text, copied);
+    return sql;
+  }
+};
+
+std::vector<std::string> split(const std::string &text, char separator) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (size_t at; (at = text.find(separator, start)) != std::string::npos;
+       start = at + 1) {
+    parts.push_back(text.substr(start, at - start));
+  }
+  parts.push_back(text.substr(start));
+  return parts;
+}
+
+std::string trim(const std::string &text) {
+  size_t first = text.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return "";
+  }
+  return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+Placeholder parsePlaceholder(const std::string &spec, size_t offset) {
+  std::vector<std::string> parts = split(spec, ':');
+  Placeholder placeholder{offset, parts[0] == "zipf"};
+  if (parts[0] != "zipf" && parts[0] != "uniform") {
+    throw std::runtime_error("Unknown distribution: {" + spec + "}");
+  }
+
+  double skew = 0.99;
+  size_t skew_part;
+  if (parts.size() >= 2 && parts[1].find('|') != std::string::npos) {
+    placeholder.values = split(parts[1], '|');
+    placeholder.range = placeholder.values.size();
+    skew_part = 2;
+  } else if (parts.size() >= 3) {
+    placeholder.low = std::stoll(parts[1]);
+    int64_t high = std::stoll(parts[2]);
+    if (high < placeholder.low) {
+      throw std::runtime_error("Empty range: {" + spec + "}");
+    }
+    placeholder.range = static_cast<uint64_t>(high - placeholder.low) + 1;
+    skew_part = 3;
+  } else {
+    throw std::runtime_error("Invalid placeholder: {" + spec + "}");
+  }
+  if (parts.size() == skew_part + 1 && placeholder.zipfian) {
+    skew = std::stod(parts[skew_part]);
+  } else if (parts.size() != skew_part) {
+    throw std::runtime_error("Invalid placeholder: {" + spec + "}");
+  }
+  if (placeholder.zipfian) {
+    if (!(skew > 0.0 && skew < 1.0)) {
+      throw std::runtime_error("Zipf skew must be in (0, 1): {" + spec + "}");
+    }
+    placeholder.zipf =
+        std::make_shared<ZipfianDistribution>(placeholder.range, skew);
+  }
+  return placeholder;
+}
+
+std::vector<QueryTemplate> loadTemplates(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Cannot open template file: " + path);
+  }
+
+  std::vector<QueryTemplate> templates;
+  std::string line;
+  while (std::getline(in, line)) {
+    line = trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      throw std::runtime_error("Expected NAME = SQL: " + line);
+    }
+
+    QueryTemplate query;
+    std::string name = trim(line.substr(0, equals));
+    if (size_t star = name.find('*'); star != std::string::npos) {
+      query.weight = std::stoull(name.substr(star + 1));
+      name = trim(name.substr(0, star));
+    }
+    query.name = name;
+
+    std::string sql = trim(line.substr(equals + 1));
+    for (size_t i = 0; i < sql.size(); ++i) {
+      if (sql[i] != '{') {
+        query.text += sql[i];
+        continue;
+      }
+      size_t close = sql.find('}', i);
+      if (close == std::string::npos) {
+        throw std::runtime_error("Unterminated placeholder: " + line);
+      }
+      std::string spec = sql.substr(i + 1, close - i - 1);
+      query.placeholders.push_back(parsePlaceholder(spec, query.text.size()));
+      i = close;
+    }
+    if (query.weight > 0) {
+      templates.push_back(std::move(query));
+    }
+  }
+  if (templates.empty()) {
+    throw std::runtime_error("No query templates in " + path);
+  }
+  return templates;
+}
+
+struct Options {
+  std::string database;
+  std::string templates;
+  unsigned threads{1};
+  std::chrono::milliseconds duration{10000};
+  uint64_t seed{1};
+  bool stats{true};
+  bool prefetch{false};
+  bool resident{false};
+  // Per-thread result cache budget; zero leaves the cache off
+  size_t result_cache{0};
+  std::string output;
+};
+
+// What --resident loaded into each thread's database, and how long it took
+struct ResidentLoad {
+  ResidentFootprint footprint;
+  double seconds{0.0};
+};
+
+struct ThreadResult {
+  std::vector<LatencyHistogram> latencies; // one per template
+  std::vector<uint64_t> errors;
+  QueryStats stats;
+  uint64_t rows{0};
+};
+
+void addStats(QueryStats &total, const QueryStats &stats) {
+  total.interior_table_pages += stats.interior_table_pages;
+  total.leaf_table_pages += stats.leaf_table_pages;
+  total.interior_index_pages += stats.interior_index_pages;
+  total.leaf_index_pages += stats.leaf_index_pages;
+  total.overflow_pages += stats.overflow_pages;
+  total.bytes_read += stats.bytes_read;
+  total.cells_decoded += stats.cells_decoded;
+  total.records_materialized += stats.records_materialized;
+  total.rows_examined += stats.rows_examined;
+  total.rows_filtered += stats.rows_filtered;
+  total.rows_output += stats.rows_output;
+  total.pages_prefetched += stats.pages_prefetched;
+  total.prefetch_stalls += stats.prefetch_stalls;
+  total.readahead_pages += stats.readahead_pages;
+  total.pages_pruned += stats.pages_pruned;
+  total.bloom_rejections += stats.bloom_rejections;
+  total.result_cache_hits += stats.result_cache_hits;
+  for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+    total.phases[i].wall += stats.phases[i].wall;
+    total.phases[i].cpu += stats.phases[i].cpu;
+  }
+}
+
+void runThread(const Options &options, const Database &db,
+               const std::vector<QueryTemplate> &templates, unsigned thread,
+               const std::atomic<bool> &stop, ThreadResult &result) {
+  std::mt19937_64 rng(options.seed * 0x9E3779B97F4A7C15ULL + thread);
+  std::vector<uint64_t> weights;
+  for (const auto &query : templates) {
+    weights.push_back(query.weight);
+  }
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+  result.latencies.resize(templates.size());
+  result.errors.resize(templates.size());
+  std::optional<StatsScope> scope;
+  if (options.stats) {
+    scope.emplace(result.stats);
+  }
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    size_t chosen = pick(rng);
+    std::string sql = templates[chosen].instantiate(rng);
+    auto start = Clock::now();
+    try {
+      std::unique_ptr<SelectStatement> stmt;
+      {
+        PhaseTimer timer(QueryPhase::Parse);
+        stmt = SQLParser::parseSelect(sql);
+      }
+      result.rows += db.executeSelect(*stmt).size();
+    } catch (const std::exception &e) {
+      if (result.errors[chosen]++ == 0) {
+        std::cerr << "Query failed: " << sql << ": " << e.what() << "\n";
+      }
+      continue;
+    }
+    result.latencies[chosen].record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             start)
+            .count()));
+  }
+}
+
+void writeLatency(std::ostream &out, const LatencyHistogram &latency,
+                  double seconds) {
+  out << "\"queries\":" << latency.count()
+      << ",\"qps\":" << static_cast<double>(latency.count()) / seconds
+      << ",\"mean_ns\":" << latency.mean()
+      << ",\"p50_ns\":" << latency.percentile(0.50)
+      << ",\"p99_ns\":" << latency.percentile(0.99)
+      << ",\"p999_ns\":" << latency.percentile(0.999)
+      << ",\"max_ns\":" << latency.max();
+}
+
+void writeReport(std::ostream &out, const Options &options,
+                 const std::vector<QueryTemplate> &templates,
+                 const std::vector<ThreadResult> &results, double seconds,
+                 const std::optional<ResidentLoad> &resident) {
+  LatencyHistogram overall;
+  QueryStats stats;
+  uint64_t rows = 0;
+  uint64_t errors = 0;
+  std::vector<LatencyHistogram> per_template(templates.size());
+  std::vector<uint64_t> template_errors(templates.size(), 0);
+  for (const auto &result : results) {
+    for (size_t i = 0; i < templates.size(); ++i) {
+      per_template[i].merge(result.latencies[i]);
+      overall.merge(result.latencies[i]);
+      template_errors[i] += result.errors[i];
+      errors += result.errors[i];
+    }
+    addStats(stats, result.stats);
+    rows += result.rows;
+  }
+
+  out << "{\"threads\":" << options.threads << ",\"duration_s\":" << seconds
+      << ",";
+  writeLatency(out, overall, seconds);
+  out << ",\"rows\":" << rows << ",\"errors\":" << errors
+      << ",\n\"templates\":[";
+  for (size_t i = 0; i < templates.size(); ++i) {
+    out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << templates[i].name
+        << "\",";
+    writeLatency(out, per_template[i], seconds);
+    out << ",\"errors\":" << template_errors[i] << "}";
+  }
+  out << "\n]";
+
+  if (options.stats) {
+    double queries = std::max<double>(1.0, overall.count());
+    out << ",\n\"io\":{\"pages_read\":" << stats.pagesRead()
+        << ",\"interior_table_pages\":" << stats.interior_table_pages
+        << ",\"leaf_table_pages\":" << stats.leaf_table_pages
+        << ",\"interior_index_pages\":" << stats.interior_index_pages
+        << ",\"leaf_index_pages\":" << stats.leaf_index_pages
+        << ",\"overflow_pages\":" << stats.overflow_pages
+        << ",\"bytes_read\":" << stats.bytes_read
+        << ",\"cells_decoded\":" << stats.cells_decoded
+        << ",\"records_materialized\":" << stats.records_materialized
+        << ",\"rows_examined\":" << stats.rows_examined
+        << ",\"pages_prefetched\":" << stats.pages_prefetched
+        << ",\"prefetch_stalls\":" << stats.prefetch_stalls
+        << ",\"readahead_pages\":" << stats.readahead_pages
+        << ",\"pages_pruned\":" << stats.pages_pruned
+        << ",\"bloom_rejections\":" << stats.bloom_rejections
+        << ",\"result_cache_hits\":" << stats.result_cache_hits
+        << ",\"pages_per_query\":"
+        << static_cast<double>(stats.pagesRead()) / queries << "}";
+  }
+  if (resident) {
+    const ResidentFootprint &footprint = resident->footprint;
+    out << ",\n\"resident\":{\"pages\":" << footprint.pages
+        << ",\"cells\":" << footprint.cells
+        << ",\"page_bytes\":" << footprint.page_bytes
+        << ",\"record_bytes\":" << footprint.record_bytes
+        << ",\"index_bytes\":" << footprint.index_bytes
+        << ",\"total_bytes\":" << footprint.totalBytes()
+        << ",\"load_s\":" << resident->seconds << "}";
+  }
+  out << "}\n";
+}
+
+Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--no-stats") {
+      options.stats = false;
+      continue;
+    }
+    if (arg == "--prefetch" || arg == "--resident") {
+      (arg == "--prefetch" ? options.prefetch : options.resident) = true;
+      continue;
+    }
+    if (arg.rfind("--", 0) != 0) {
+      positional.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + arg);
+    }
+    std::string value = argv[++i];
+    if (arg == "--threads") {
+      options.threads = static_cast<unsigned>(std::stoul(value));
+    } else if (arg == "--duration") {
+      options.duration = std::chrono::milliseconds(
+          static_cast<int64_t>(std::stod(value) * 1000));
+    } else if (arg == "--seed") {
+      options.seed = std::stoull(value);
+    } else if (arg == "--result-cache") {
+      options.result_cache = std::stoull(value);
+    } else if (arg == "--output") {
+      options.output = value;
+    } else {
+      throw std::runtime_error("Unknown option: " + arg);
+    }
+  }
+  if (positional.size() != 2 || options.threads == 0) {
+    throw std::runtime_error(
+        "Usage: workload DB TEMPLATES [--threads N] [--duration SECONDS] "
+        "[--seed N] [--no-stats] [--prefetch] [--resident] "
+        "[--result-cache BYTES] [--output FILE]");
+  }
+  options.database = positional[0];
+  options.templates = positional[1];
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    Options options = parseOptions(argc, argv);
+    std::vector<QueryTemplate> templates = loadTemplates(options.templates);
+
+    // Held by pointer: a Database's B-tree refers to its own file reader
+    std::vector<std::unique_ptr<Database>> databases;
+    std::optional<ResidentLoad> resident;
+    for (unsigned i = 0; i < options.threads; ++i) {
+      databases.push_back(std::make_unique<Database>(options.database));
+      databases.back()->readHeader();
+      databases.back()->setPrefetching(options.prefetch);
+      databases.back()->setResultCacheBudget(options.result_cache);
+      // Every thread gets its own copy; the report shows one
+      if (options.resident) {
+        auto load_start = Clock::now();
+        const ResidentFootprint &footprint = databases.back()->loadResident();
+        resident = ResidentLoad{
+            footprint,
+            std::chrono::duration<double>(Clock::now() - load_start).count()};
+      }
+    }
+
+    std::atomic<bool> stop{false};
+    std::vector<ThreadResult> results(options.threads);
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (unsigned i = 0; i < options.threads; ++i) {
+      threads.emplace_back(runThread, std::cref(options),
+                           std::cref(*databases[i]), std::cref(templates), i,
+                           std::cref(stop), std::ref(results[i]));
+    }
+    std::this_thread::sleep_for(options.duration);
+    stop.store(true, std::memory_order_relaxed);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (options.output.empty()) {
+      writeReport(std::cout, options, templates, results, seconds, resident);
+    } else {
+      std::ofstream out(options.output);
+      writeReport(out, options, templates, results, seconds, resident);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1,6 +1,14 @@
 #include "database.hpp"
+#include "query_stats.hpp"
+#include "shard_executor.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cctype>
 #include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 void printResults(const QueryResult &results) {
   for (const auto &row : results) {
@@ -8,31 +16,98 @@ void printResults(const QueryResult &results) {
       if (i > 0)
         std::cout << "|";
 
-      if (std::holds_alternative<std::string>(row[i])) {
-        std::cout << std::get<std::string>(row[i]);
-      } else if (std::holds_alternative<int64_t>(row[i])) {
-        std::cout << std::get<int64_t>(row[i]);
-      }
+      std::cout << recordValueToText(row[i]);
     }
     std::cout << "\n";
   }
 }
 
+// Removes a leading EXPLAIN ANALYZE from `sql`, returning whether it had one
+bool stripExplainAnalyze(std::string &sql) {
+  std::istringstream words(sql);
+  std::string first, second;
+  words >> first >> second;
+  auto upper = [](std::string word) {
+    std::transform(word.begin(), word.end(), word.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    return word;
+  };
+  if (upper(first) != "EXPLAIN" || upper(second) != "ANALYZE") {
+    return false;
+  }
+  std::streampos rest = words.tellg();
+  sql = rest == std::streampos(-1) ? "" : sql.substr(rest);
+  return true;
+}
+
+// Runs `sql` over every database matching `patterns` as over one table.
+// TEZ_SHARD_THREADS, TEZ_SHARD_MEMORY (bytes) and TEZ_SHARD_FILES override
+// the concurrency, memory and file descriptor budgets.
+int runSharded(const std::string &sql,
+               const std::vector<std::string> &patterns) {
+  ShardOptions options;
+  if (const char *threads = std::getenv("TEZ_SHARD_THREADS")) {
+    options.concurrency = static_cast<unsigned>(std::stoul(threads));
+  }
+  if (const char *memory = std::getenv("TEZ_SHARD_MEMORY")) {
+    options.memory_budget = std::stoull(memory);
+  }
+  if (const char *files = std::getenv("TEZ_SHARD_FILES")) {
+    options.file_budget = std::stoull(files);
+  }
+  ShardExecutor executor(expandShardPaths(patterns), options);
+  printResults(executor.execute(*SQLParser::parseSelect(sql)));
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   // Set stdout and stderr to flush immediately
   std::cout << std::unitbuf;
   std::cerr << std::unitbuf;
 
+  // --shards SQL PATTERN... queries many databases of one schema together
+  if (argc >= 4 && std::string(argv[1]) == "--shards") {
+    return runSharded(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+  }
+
   if (argc != 3) {
     std::cerr << "Expected two arguments" << std::endl;
     return 1;
   }
 
+  // TEZ_TRACE=<file> records a Chrome trace of the command into <file>
+  const char *trace_path = std::getenv("TEZ_TRACE");
+  if (trace_path != nullptr) {
+    setTracingEnabled(true);
+  }
+  struct TraceWriter {
+    const char *path;
+    ~TraceWriter() {
+      if (path != nullptr) {
+        std::ofstream out(path);
+        writeChromeTrace(out);
+      }
+    }
+  } trace_writer{trace_path};
+
   // Create database instance with provided file path
   Database db(argv[1]);
   SqliteHeader db_header = db.readHeader();
   std::string command = argv[2];
 
+  // TEZ_PREFETCH=1 reads the upcoming pages of table scans in the background
+  const char *prefetch = std::getenv("TEZ_PREFETCH");
+  if (prefetch != nullptr && std::string(prefetch) == "1") {
+    db.setPrefetching(true);
+  }
+
+  // TEZ_RESIDENT=1 decodes the whole database into memory before the query
+  // and reports the footprint on stderr
+  const char *resident = std::getenv("TEZ_RESIDENT");
+  if (resident != nullptr && std::string(resident) == "1") {
+    std::cerr << db.loadResident().format();
+  }
+
   if (command == ".dbinfo") {
     std::cout << "database page size: " << db_header.page_size << std::endl;
     uint16_t num_tables = db.getTableCount();
@@ -43,7 +118,63 @@ int main(int argc, char *argv[]) {
       std::cout << name << " ";
     }
     std::cout << std::endl;
+  } else if (command.rfind(".zonemap ", 0) == 0) {
+    // .zonemap TABLE COLUMN... summarises the columns' values per page into
+    // the database's zone map sidecar
+    std::istringstream words(command.substr(9));
+    std::string table_name;
+    std::vector<std::string> columns;
+    words >> table_name;
+    for (std::string column; words >> column;) {
+      columns.push_back(column);
+    }
+    if (table_name.empty() || columns.empty()) {
+      std::cerr << "Usage: .zonemap TABLE COLUMN..." << std::endl;
+      return 1;
+    }
+    size_t pages = db.buildZoneMap(table_name, columns);
+    std::cout << "summarised " << pages << " pages" << std::endl;
+  } else if (command.rfind(".bloom ", 0) == 0) {
+    // .bloom TABLE [INDEX] [BYTES] builds a Bloom filter on the index's
+    // leading column, or the table's rowids, into the database's sidecar
+    std::istringstream words(command.substr(7));
+    std::vector<std::string> args;
+    for (std::string word; words >> word;) {
+      args.push_back(word);
+    }
+    size_t bytes = 0;
+    auto is_digit = [](char c) {
+      return std::isdigit(static_cast<unsigned char>(c)) != 0;
+    };
+    if (args.size() > 1 &&
+        std::all_of(args.back().begin(), args.back().end(), is_digit)) {
+      bytes = std::stoull(args.back());
+      args.pop_back();
+    }
+    if (args.empty() || args.size() > 2) {
+      std::cerr << "Usage: .bloom TABLE [INDEX] [BYTES]" << std::endl;
+      return 1;
+    }
+    const BloomFilter &filter =
+        db.buildBloomFilter(args[0], args.size() > 1 ? args[1] : "", bytes);
+    std::cout << filter.keyCount() << " keys in " << filter.memoryBytes()
+              << " bytes, " << filter.falsePositiveRate() * 100
+              << "% false positives" << std::endl;
   } else {
+    // EXPLAIN ANALYZE runs the query and prints its counters instead of rows
+    if (stripExplainAnalyze(command)) {
+      QueryStats stats;
+      StatsScope scope(stats);
+      std::unique_ptr<SelectStatement> select_stmt;
+      {
+        PhaseTimer timer(QueryPhase::Parse);
+        select_stmt = SQLParser::parseSelect(command);
+      }
+      db.executeSelect(*select_stmt);
+      std::cout << stats.format();
+      return 0;
+    }
+
     SQLParser parser;
     auto select_stmt = parser.parseSelect(command);
     QueryResult results = db.executeSelect(*select_stmt);
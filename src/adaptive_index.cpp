@@ -0,0 +1,168 @@
+#include "adaptive_index.hpp"
+#include "debug.hpp"
+#include "normalized_key.hpp"
+#include "trace.hpp"
+#include <algorithm>
+
+std::string_view ColumnIndex::key(size_t i) const noexcept {
+  size_t begin = i == 0 ? 0 : key_ends_[i - 1];
+  return std::string_view(keys_).substr(begin, key_ends_[i] - begin);
+}
+
+void ColumnIndex::find(const RecordValue &value, RowidBitmap &rowids) const {
+  // NULL equals nothing, and is not indexed
+  if (std::holds_alternative<std::monostate>(value)) {
+    return;
+  }
+  std::string target;
+  NormalizedKey::append(target, value, collation_);
+
+  size_t low = 0;
+  size_t high = key_ends_.size();
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (key(mid) < target) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == key_ends_.size() || key(low) != target) {
+    return;
+  }
+  for (size_t i = low == 0 ? 0 : row_ends_[low - 1]; i < row_ends_[low];
+       ++i) {
+    rowids.add(rowids_[i]);
+  }
+}
+
+size_t ColumnIndex::memoryBytes() const noexcept {
+  return sizeof(ColumnIndex) + keys_.capacity() +
+         (key_ends_.capacity() + row_ends_.capacity()) * sizeof(size_t) +
+         rowids_.capacity() * sizeof(uint64_t);
+}
+
+void AdaptiveIndexes::setBudget(size_t bytes) {
+  budget_ = bytes;
+  if (budget_ == 0) {
+    clear();
+    return;
+  }
+  // Columns that did not fit before may now
+  for (auto &[column, entry] : entries_) {
+    entry.rejected = false;
+  }
+  evictFor(0, nullptr);
+}
+
+const ColumnIndex *AdaptiveIndexes::use(uint32_t root_page, int column,
+                                        Collation collation) {
+  if (budget_ == 0) {
+    return nullptr;
+  }
+  DataVersion version = reader_.dataVersion();
+  if (version_ != version) {
+    if (!entries_.empty()) {
+      LOG_INFO("Database changed; dropping adaptive indexes");
+    }
+    clear();
+    version_ = version;
+  }
+
+  Entry &entry = entries_[{root_page, column}];
+  entry.last_used = ++clock_;
+  if (entry.index || entry.rejected || ++entry.uses < threshold_) {
+    return entry.index.get();
+  }
+
+  auto index = build(root_page, column, collation);
+  if (!index || !evictFor(index->memoryBytes(), &entry)) {
+    LOG_INFO("Column " << column << " of the table at page " << root_page
+                       << " does not fit the adaptive index budget");
+    entry.rejected = true;
+    return nullptr;
+  }
+  used_ += index->memoryBytes();
+  LOG_INFO("Built an adaptive index on column "
+           << column << " of the table at page " << root_page << ": "
+           << index->keyCount() << " keys, " << index->memoryBytes()
+           << " bytes");
+  entry.index = std::move(index);
+  return entry.index.get();
+}
+
+std::unique_ptr<const ColumnIndex>
+AdaptiveIndexes::build(uint32_t root_page, int column,
+                       Collation collation) const {
+  TraceSpan span("adaptive_index_build", root_page);
+  // Gives up as soon as the index would outgrow the budget even if every
+  // key were distinct
+  std::vector<std::pair<std::string, uint64_t>> entries;
+  size_t bytes = sizeof(ColumnIndex);
+  bool fits = true;
+  btree_.traverse(root_page, {column, -1}, nullptr, [&](Row &&row) {
+    if (std::holds_alternative<std::monostate>(row[0])) {
+      return true;
+    }
+    std::string key;
+    NormalizedKey::append(key, row[0], collation);
+    bytes += key.size() + 2 * sizeof(size_t) + sizeof(uint64_t);
+    if (bytes > budget_) {
+      fits = false;
+      return false;
+    }
+    entries.emplace_back(std::move(key),
+                         static_cast<uint64_t>(std::get<int64_t>(row[1])));
+    return true;
+  });
+  if (!fits) {
+    return nullptr;
+  }
+
+  // Rows arrive in rowid order, which a stable sort keeps within each key
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const auto &lhs, const auto &rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  auto index = std::make_unique<ColumnIndex>();
+  index->collation_ = collation;
+  index->rowids_.reserve(entries.size());
+  for (size_t begin = 0, end = 0; begin < entries.size(); begin = end) {
+    while (end < entries.size() && entries[end].first == entries[begin].first) {
+      index->rowids_.push_back(entries[end++].second);
+    }
+    index->keys_ += entries[begin].first;
+    index->key_ends_.push_back(index->keys_.size());
+    index->row_ends_.push_back(index->rowids_.size());
+  }
+  index->keys_.shrink_to_fit();
+  index->key_ends_.shrink_to_fit();
+  index->row_ends_.shrink_to_fit();
+  return index;
+}
+
+bool AdaptiveIndexes::evictFor(size_t bytes, const Entry *keep) {
+  while (used_ + bytes > budget_) {
+    auto victim = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.index && &it->second != keep &&
+          (victim == entries_.end() ||
+           it->second.last_used < victim->second.last_used)) {
+        victim = it;
+      }
+    }
+    if (victim == entries_.end()) {
+      return false;
+    }
+    // An evicted column has to earn its index again
+    used_ -= victim->second.index->memoryBytes();
+    victim->second.index.reset();
+    victim->second.uses = 0;
+  }
+  return true;
+}
+
+void AdaptiveIndexes::clear() {
+  entries_.clear();
+  used_ = 0;
+}
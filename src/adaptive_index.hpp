@@ -0,0 +1,99 @@
+#pragma once
+
+#include "btree.hpp"
+#include "file_reader.hpp"
+#include "rowid_bitmap.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Memory adaptive indexes may take, in all, before the least recently used
+// are dropped.
+constexpr size_t DEFAULT_ADAPTIVE_INDEX_BUDGET = 64 * 1024 * 1024;
+// Filters on an unindexed column before one is built for it.
+constexpr uint32_t DEFAULT_ADAPTIVE_INDEX_THRESHOLD = 4;
+
+// An in-memory index of one table column, built by scanning the table: its
+// distinct non-NULL values as sorted NormalizedKeys under the column's
+// collation, each with the rowids holding it in ascending order. The keys
+// share one buffer, and the rowids one array, so that an entry costs little
+// more than its key and rowid.
+class ColumnIndex {
+public:
+  // Adds the rowids of the rows whose value equals `key` under the
+  // collation
+  void find(const RecordValue &key, RowidBitmap &rowids) const;
+
+  [[nodiscard]] size_t keyCount() const noexcept { return key_ends_.size(); }
+  [[nodiscard]] size_t rowCount() const noexcept { return rowids_.size(); }
+  [[nodiscard]] size_t memoryBytes() const noexcept;
+
+private:
+  friend class AdaptiveIndexes;
+
+  [[nodiscard]] std::string_view key(size_t i) const noexcept;
+
+  Collation collation_{Collation::Binary};
+  std::string keys_;
+  // End of each key in keys_, and of its rowids in rowids_
+  std::vector<size_t> key_ends_;
+  std::vector<size_t> row_ends_;
+  std::vector<uint64_t> rowids_;
+};
+
+// Builds and keeps ColumnIndexes for columns that queries keep filtering on
+// without a B-tree index. Each equality or IN lookup on such a column counts
+// as a use; the one that reaches the threshold builds the index with a
+// single pass over the table, and later ones are answered from it. Indexes
+// hold while the data version is unchanged and are all dropped once it
+// moves.
+class AdaptiveIndexes {
+public:
+  AdaptiveIndexes(const FileReader &reader, const BTree &btree) noexcept
+      : reader_(reader), btree_(btree) {}
+
+  // Zero turns adaptive indexing off and drops every index
+  void setBudget(size_t bytes);
+  void setThreshold(uint32_t uses) noexcept { threshold_ = uses; }
+
+  // Counts a lookup on the column of the rowid table rooted at `root_page`,
+  // which compares under `collation`, and returns its index, building it if
+  // this use reaches the threshold. Null while below it, or when the index
+  // would not fit the budget. The index stays valid until the next call.
+  const ColumnIndex *use(uint32_t root_page, int column, Collation collation);
+
+  [[nodiscard]] size_t memoryBytes() const noexcept { return used_; }
+
+private:
+  struct Entry {
+    uint32_t uses{0};
+    uint64_t last_used{0};
+    std::unique_ptr<const ColumnIndex> index;
+    // The scan gave up on it for exceeding the budget
+    bool rejected{false};
+  };
+
+  // Null when the index alone would exceed the budget
+  std::unique_ptr<const ColumnIndex> build(uint32_t root_page, int column,
+                                           Collation collation) const;
+  // Drops the least recently used indexes other than `keep` until `bytes`
+  // more fit the budget; false if they cannot
+  bool evictFor(size_t bytes, const Entry *keep);
+  void clear();
+
+  const FileReader &reader_;
+  const BTree &btree_;
+  size_t budget_{DEFAULT_ADAPTIVE_INDEX_BUDGET};
+  uint32_t threshold_{DEFAULT_ADAPTIVE_INDEX_THRESHOLD};
+  std::optional<DataVersion> version_;
+  // By table root page and column position
+  std::map<std::pair<uint32_t, int>, Entry> entries_;
+  uint64_t clock_{0};
+  size_t used_{0};
+};
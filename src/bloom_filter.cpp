@@ -0,0 +1,203 @@
+#include "bloom_filter.hpp"
+#include "debug.hpp"
+#include "normalized_key.hpp"
+#include "sidecar.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+
+namespace {
+
+using sidecar::get;
+using sidecar::put;
+
+constexpr sidecar::Magic SIDECAR_MAGIC = {'T', 'E', 'Z', 'B',
+                                          'L', 'O', 'M', 2};
+constexpr const char *SIDECAR_SUFFIX = "-bloom";
+
+constexpr uint32_t MAX_PROBES = 16;
+
+// Odd multipliers that spread the low half of a hash over each probe's bit
+constexpr uint32_t PROBE_SALTS[MAX_PROBES] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+    0x9e3779b1U, 0x85ebca77U, 0xc2b2ae3dU, 0x27d4eb2fU,
+    0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U};
+
+// MurmurHash3's finaliser
+uint64_t mix(uint64_t hash) noexcept {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t bitOf(uint64_t hash, uint32_t probe) noexcept {
+  uint32_t bit = (static_cast<uint32_t>(hash) * PROBE_SALTS[probe]) >> 26;
+  return uint64_t{1} << bit;
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(size_t bytes, uint64_t expected_keys)
+    : blocks_(std::max<size_t>(1, (bytes + sizeof(Block) - 1) /
+                                      sizeof(Block))) {
+  auto bits = static_cast<double>(blocks_.size() * sizeof(Block) * 8);
+  auto keys = static_cast<double>(std::max<uint64_t>(expected_keys, 1));
+  // Setting ln 2 times the bits per key minimises false positives
+  long probes = std::lround(bits / keys * std::log(2.0));
+  probes_ = static_cast<uint32_t>(
+      std::clamp<long>(probes, 1, static_cast<long>(MAX_PROBES)));
+}
+
+uint64_t BloomFilter::hashKey(const RecordValue &key) {
+  std::string bytes;
+  NormalizedKey::append(bytes, key);
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char byte : bytes) {
+    hash = (hash ^ static_cast<uint8_t>(byte)) * 0x100000001b3ULL;
+  }
+  return mix(hash);
+}
+
+uint64_t BloomFilter::hashRowid(uint64_t rowid) noexcept {
+  return mix(rowid);
+}
+
+size_t BloomFilter::blockOf(uint64_t hash) const noexcept {
+  // The high half of the hash picks the block, the low half the bits
+  return ((hash >> 32) * blocks_.size()) >> 32;
+}
+
+void BloomFilter::add(uint64_t hash) noexcept {
+  Block &target = blocks_[blockOf(hash)];
+  for (uint32_t i = 0; i < probes_; ++i) {
+    target.words[i % WORDS_PER_BLOCK] |= bitOf(hash, i);
+  }
+  ++keys_;
+}
+
+bool BloomFilter::mayContain(uint64_t hash) const noexcept {
+  const Block &target = blocks_[blockOf(hash)];
+  for (uint32_t i = 0; i < probes_; ++i) {
+    if ((target.words[i % WORDS_PER_BLOCK] & bitOf(hash, i)) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t BloomFilter::memoryBytes() const noexcept {
+  return sizeof(BloomFilter) + blocks_.size() * sizeof(Block);
+}
+
+double BloomFilter::falsePositiveRate() const {
+  // A key that was never added lands in a random block and passes if each
+  // of its probes finds its bit set
+  double rate = 0;
+  for (const Block &candidate : blocks_) {
+    double pass = 1;
+    for (uint32_t i = 0; i < probes_; ++i) {
+      pass *= std::popcount(candidate.words[i % WORDS_PER_BLOCK]) / 64.0;
+    }
+    rate += pass;
+  }
+  return rate / static_cast<double>(blocks_.size());
+}
+
+void BloomFilter::write(std::ostream &out) const {
+  put(out, probes_);
+  put(out, keys_);
+  put(out, static_cast<uint64_t>(blocks_.size()));
+  out.write(reinterpret_cast<const char *>(blocks_.data()),
+            static_cast<std::streamsize>(blocks_.size() * sizeof(Block)));
+}
+
+std::optional<BloomFilter> BloomFilter::read(std::istream &in) {
+  BloomFilter filter;
+  uint64_t block_count = 0;
+  if (!get(in, filter.probes_) || !get(in, filter.keys_) ||
+      !get(in, block_count) || filter.probes_ == 0 ||
+      filter.probes_ > MAX_PROBES || block_count == 0 ||
+      block_count > (uint64_t{1} << 32)) {
+    return std::nullopt;
+  }
+  filter.blocks_.resize(block_count);
+  if (!in.read(reinterpret_cast<char *>(filter.blocks_.data()),
+               static_cast<std::streamsize>(block_count * sizeof(Block)))) {
+    return std::nullopt;
+  }
+  return filter;
+}
+
+void BloomFilters::refresh() {
+  DataVersion version = reader_.dataVersion();
+  if (version_ == version) {
+    return;
+  }
+  if (version_) {
+    if (!filters_.empty()) {
+      LOG_INFO("Database changed; dropping Bloom filters");
+    }
+    filters_.clear();
+    version_ = version;
+    return;
+  }
+  version_ = version;
+
+  std::ifstream in(reader_.filename() + SIDECAR_SUFFIX, std::ios::binary);
+  if (!in) {
+    return;
+  }
+  uint32_t filter_count = 0;
+  if (!sidecar::getHeader(in, SIDECAR_MAGIC, version) ||
+      !get(in, filter_count)) {
+    LOG_INFO("Ignoring stale or unreadable Bloom filters");
+    return;
+  }
+  std::unordered_map<uint32_t, BloomFilter> filters;
+  for (uint32_t n = 0; n < filter_count; ++n) {
+    uint32_t root_page = 0;
+    std::optional<BloomFilter> filter;
+    if (!get(in, root_page) || !(filter = BloomFilter::read(in))) {
+      LOG_INFO("Ignoring stale or unreadable Bloom filters");
+      return;
+    }
+    filters.insert_or_assign(root_page, std::move(*filter));
+  }
+  filters_ = std::move(filters);
+  LOG_INFO("Loaded " << filters_.size() << " Bloom filters");
+}
+
+const BloomFilter *BloomFilters::find(uint32_t root_page) const {
+  if (filters_.empty()) {
+    return nullptr;
+  }
+  auto it = filters_.find(root_page);
+  return it == filters_.end() ? nullptr : &it->second;
+}
+
+const BloomFilter &BloomFilters::add(uint32_t root_page,
+                                     BloomFilter filter) {
+  refresh();
+  return filters_.insert_or_assign(root_page, std::move(filter))
+      .first->second;
+}
+
+void BloomFilters::save() {
+  refresh();
+  const std::string target = reader_.filename() + SIDECAR_SUFFIX;
+  sidecar::save(target, [&](std::ostream &out) {
+    sidecar::putHeader(out, SIDECAR_MAGIC, *version_);
+    put(out, static_cast<uint32_t>(filters_.size()));
+    for (const auto &[root_page, filter] : filters_) {
+      put(out, root_page);
+      filter.write(out);
+    }
+  });
+  LOG_INFO("Saved " << filters_.size() << " Bloom filters to " << target);
+}
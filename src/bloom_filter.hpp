@@ -0,0 +1,83 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include "file_reader.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Bits per key filters get when no memory budget is given, for a
+// false-positive rate of under 2%.
+constexpr size_t DEFAULT_BLOOM_BITS_PER_KEY = 10;
+
+// A blocked Bloom filter: each key sets its bits within one cache line, so
+// a lookup costs a single memory access. Says for sure when a key was never
+// added, and may be wrong when it says a key was.
+class BloomFilter {
+public:
+  // A filter of about `bytes` for `expected_keys` keys, with as many bits
+  // set per key as minimises false positives at that size
+  BloomFilter(size_t bytes, uint64_t expected_keys);
+
+  // Stable hashes, so that filters saved by one process serve another.
+  // Index keys hash by their NormalizedKey, under which 5 and 5.0 agree.
+  [[nodiscard]] static uint64_t hashKey(const RecordValue &key);
+  [[nodiscard]] static uint64_t hashRowid(uint64_t rowid) noexcept;
+
+  void add(uint64_t hash) noexcept;
+  [[nodiscard]] bool mayContain(uint64_t hash) const noexcept;
+
+  [[nodiscard]] uint64_t keyCount() const noexcept { return keys_; }
+  [[nodiscard]] size_t memoryBytes() const noexcept;
+  // Expected false-positive rate for the keys added so far
+  [[nodiscard]] double falsePositiveRate() const;
+
+  // Binary form for the sidecar file
+  void write(std::ostream &out) const;
+  static std::optional<BloomFilter> read(std::istream &in);
+
+private:
+  static constexpr size_t WORDS_PER_BLOCK = 8;
+
+  struct alignas(64) Block {
+    uint64_t words[WORDS_PER_BLOCK]{};
+  };
+
+  BloomFilter() = default;
+
+  [[nodiscard]] size_t blockOf(uint64_t hash) const noexcept;
+
+  std::vector<Block> blocks_;
+  uint32_t probes_{1};
+  uint64_t keys_{0};
+};
+
+// The Bloom filters of a database, by root page: over the leading column of
+// an index, or the rowids of a table. Seeks and rowid lookups consult them
+// and skip keys they rule out. Filters are built on request, and dropped
+// once the data version moves. `<database>-bloom` keeps them between
+// processes: it is read on first use if it was saved against the current
+// data version, and written by save().
+class BloomFilters {
+public:
+  explicit BloomFilters(const FileReader &reader) noexcept
+      : reader_(reader) {}
+
+  // Checks the data version, which lookups do not: queries call it before
+  // they start
+  void refresh();
+
+  // The tree's filter; null when it has none
+  [[nodiscard]] const BloomFilter *find(uint32_t root_page) const;
+
+  const BloomFilter &add(uint32_t root_page, BloomFilter filter);
+  void save();
+
+private:
+  const FileReader &reader_;
+  std::optional<DataVersion> version_;
+  std::unordered_map<uint32_t, BloomFilter> filters_;
+};
@@ -1,166 +1,927 @@
 #include "btree.hpp"
 #include "btree_record.hpp"
 #include "debug.hpp"
+#include "key_search.hpp"
+#include "lexer.hpp"
+#include "normalized_key.hpp"
+#include "query_stats.hpp"
+#include "trace.hpp"
 #include "schema_record.hpp"
 #include <algorithm>
 
 BTree::BTree(FileReader &reader, const sqlite::Header &header) noexcept
     : _reader(reader), _header(header) {}
 
+const ResidentFootprint &BTree::loadResident() {
+  if (!_resident) {
+    TraceSpan span("resident_load", sqlite::SCHEMA_PAGE);
+    // Read the file once, front to back, and decode from the copy; only the
+    // schema page, which the table manager reads directly, is kept after
+    _reader.setPrefetching(false);
+    _reader.setReadahead(false);
+    _reader.pin(0, _reader.size());
+    _resident =
+        std::make_unique<const ResidentTree>(_reader, _header.page_size);
+    _reader.pin(0, _header.page_size);
+  }
+  return _resident->footprint();
+}
+
+PageType BTree::pageTypeOf(uint32_t page_num) const {
+  if (const ResidentNode *node = residentNode(page_num)) {
+    return node->type;
+  }
+  _reader.seekToPage(page_num, _header.page_size);
+  return static_cast<PageType>(_reader.readU8());
+}
+
+uint64_t BTree::leafCellCount(uint32_t page_num, PageType type) const {
+  if (const ResidentNode *node = residentNode(page_num)) {
+    return node->cellCount();
+  }
+  countPageRead(type);
+  _reader.seekToPage(page_num, _header.page_size);
+  _reader.seekRelative(3); // page type, first freeblock
+  return _reader.readU16();
+}
+
+namespace {
+
+// A page's records: borrowed from the resident tree when it holds the page,
+// decoded one cell at a time otherwise
+class CellRecords {
+public:
+  explicit CellRecords(const ResidentNode *node) noexcept : node_(node) {}
+
+  // Values of cells[n]; a decoded record lasts until another cell's
+  template <typename Cell>
+  const std::vector<RecordValue> &at(const std::vector<Cell> &cells,
+                                     size_t n) {
+    if (node_ != nullptr) {
+      return node_->records[n];
+    }
+    if (!decoded_ || decoded_cell_ != n) {
+      decoded_.emplace(cells[n].payload);
+      decoded_cell_ = n;
+    }
+    return decoded_->getValues();
+  }
+
+  template <typename Cell>
+  const std::vector<RecordValue> &of(const std::vector<Cell> &cells,
+                                     const Cell &cell) {
+    return at(cells, static_cast<size_t>(&cell - cells.data()));
+  }
+
+private:
+  const ResidentNode *node_;
+  std::optional<BTreeRecord> decoded_;
+  size_t decoded_cell_{0};
+};
+
+// Orders an index page's cells against a key range: by memcmp of normalized
+// keys on resident pages, by decoded records otherwise
+class KeyProbe {
+public:
+  KeyProbe(const ResidentNode *node, const IndexKeyRange &range)
+      : node_(node), range_(range), records_(node) {
+    // A range on the next column starts above its NULLs unless bounded
+    // below; without one, entries match on the equal columns alone
+    static const RecordValue null;
+    lower_ = range.lower ? &*range.lower : range.upper ? &null : nullptr;
+    lower_inclusive_ = range.lower ? range.lower_inclusive : !range.upper;
+    upper_ = range.upper ? &*range.upper : nullptr;
+    upper_inclusive_ = !range.upper || range.upper_inclusive;
+    if (node_ != nullptr) {
+      lower_key_ = NormalizedKey::encode(range.equal);
+      upper_key_ = lower_key_;
+      if (lower_ != nullptr) {
+        NormalizedKey::append(lower_key_, *lower_);
+      }
+      if (upper_ != nullptr) {
+        NormalizedKey::append(upper_key_, *upper_);
+      }
+    }
+  }
+
+  // Cells before this one sort below the range, as their prefixes show
+  [[nodiscard]] size_t first() const noexcept {
+    if (node_ == nullptr) {
+      return 0;
+    }
+    return searchKeys(node_->prefixes.data(), node_->prefixes.size(),
+                      NormalizedKey::prefix(lower_key_));
+  }
+
+  // < 0 below the range, 0 within it, > 0 above it
+  template <typename Cell>
+  int position(const std::vector<Cell> &cells, size_t n) {
+    int lower = 0;
+    int upper = 0;
+    if (node_ != nullptr) {
+      lower = NormalizedKey::comparePrefix(node_->normalized[n], lower_key_);
+      upper = NormalizedKey::comparePrefix(node_->normalized[n], upper_key_);
+    } else {
+      const auto &entry = records_.at(cells, n);
+      lower = compareLeading(entry, lower_);
+      upper = compareLeading(entry, upper_);
+    }
+    if (lower < 0 || (lower == 0 && !lower_inclusive_)) {
+      return -1;
+    }
+    return upper > 0 || (upper == 0 && !upper_inclusive_) ? 1 : 0;
+  }
+
+  template <typename Cell>
+  int position(const std::vector<Cell> &cells, const Cell &cell) {
+    return position(cells, static_cast<size_t>(&cell - cells.data()));
+  }
+
+  template <typename Cell>
+  const std::vector<RecordValue> &entry(const std::vector<Cell> &cells,
+                                        size_t n) {
+    return records_.at(cells, n);
+  }
+
+private:
+  // Compares the entry's leading columns with the equal values, then the
+  // next one with `bound` when given
+  int compareLeading(const std::vector<RecordValue> &entry,
+                     const RecordValue *bound) const noexcept {
+    const auto &equal = range_.equal;
+    for (size_t i = 0; i < equal.size(); ++i) {
+      if (i >= entry.size()) {
+        return -1;
+      }
+      if (int cmp = compareRecordValues(entry[i], equal[i])) {
+        return cmp;
+      }
+    }
+    if (bound == nullptr) {
+      return 0;
+    }
+    return equal.size() < entry.size()
+               ? compareRecordValues(entry[equal.size()], *bound)
+               : -1;
+  }
+
+  const ResidentNode *node_;
+  const IndexKeyRange &range_;
+  CellRecords records_;
+  const RecordValue *lower_;
+  const RecordValue *upper_;
+  bool lower_inclusive_;
+  bool upper_inclusive_;
+  std::string lower_key_;
+  std::string upper_key_;
+};
+
+// The rowid an index entry ends with; entries of WITHOUT ROWID tables end
+// with a column instead, and give 0 unless it holds an integer
+uint64_t entryRowid(const std::vector<RecordValue> &entry) {
+  const auto *rowid = std::get_if<int64_t>(&entry.back());
+  return rowid ? static_cast<uint64_t>(*rowid) : 0;
+}
+
+Row projectRow(const std::vector<RecordValue> &values, uint64_t rowid,
+               const std::vector<int> &column_positions) {
+  Row row;
+  row.reserve(column_positions.size());
+  for (int pos : column_positions) {
+    if (pos == -1) {
+      row.push_back(static_cast<int64_t>(rowid));
+    } else if (static_cast<size_t>(pos) < values.size()) {
+      row.push_back(values[pos]);
+    } else {
+      row.emplace_back(std::monostate{});
+    }
+  }
+  return row;
+}
+
+// Pages this close are hinted as one range: reading the few pages between
+// them costs less than another seek
+constexpr uint32_t READAHEAD_GAP_PAGES = 4;
+
+// Hints upcoming pages to the kernel as sorted runs of nearby page numbers,
+// so that leaves scattered across the file are still read sequentially
+void adviseRuns(const FileReader &reader, std::vector<uint32_t> pages,
+                uint16_t page_size) {
+  std::sort(pages.begin(), pages.end());
+  size_t first = 0;
+  for (size_t i = 1; i <= pages.size(); ++i) {
+    if (i < pages.size() && pages[i] - pages[i - 1] <= READAHEAD_GAP_PAGES) {
+      continue;
+    }
+    size_t run = pages[i - 1] - pages[first] + 1;
+    reader.adviseWillNeed(size_t{pages[first] - 1} * page_size,
+                          run * page_size);
+    countStat(&QueryStats::readahead_pages, run);
+    first = i;
+  }
+}
+
+} // namespace
+
+size_t TableIndex::seekableColumns() const noexcept {
+  auto binary = [](const std::string &collation) {
+    return collation.empty() || equalsIgnoreCase(collation, "binary");
+  };
+  size_t count = 0;
+  for (const auto &column : definition.columns) {
+    if (column.name.empty() || column.descending ||
+        !binary(column.collation) || count >= column_collations.size() ||
+        !binary(column_collations[count])) {
+      break;
+    }
+    ++count;
+  }
+  return count;
+}
+
 void BTree::traverse(uint32_t page_num,
                      const std::vector<int> &column_positions,
-                     int where_col_pos, const WhereClause &where,
+                     const CompiledPredicate *filter,
                      sqlite::QueryResult &results) const {
-  LOG_DEBUG("Traversing B-tree page: " << page_num);
+  traverse(page_num, column_positions, filter, [&results](Row &&row) {
+    results.push_back(std::move(row));
+    return true;
+  });
+}
 
-  _reader.seekToPage(page_num, _header.page_size);
-  uint8_t page_type = _reader.readU8();
-  _reader.seek(_header.page_size * (page_num - 1));
+bool BTree::traverse(uint32_t page_num,
+                     const std::vector<int> &column_positions,
+                     const CompiledPredicate *filter, const RowSink &sink,
+                     const ScanOptions &options) const {
+  TableScan scan{column_positions, filter, sink, options, options.offset};
+  if (options.zones != nullptr && !options.zones->mayMatch(page_num)) {
+    countStat(&QueryStats::pages_pruned);
+    return true;
+  }
+  return traversePage(page_num, scan);
+}
 
-  if (static_cast<PageType>(page_type) == PageType::InteriorTable) {
+bool BTree::traversePage(uint32_t page_num, TableScan &scan) const {
+  LOG_DEBUG("Traversing B-tree page: " << page_num);
+
+  if (pageTypeOf(page_num) == PageType::InteriorTable) {
     LOG_DEBUG("Processing interior page: " << page_num);
-    BTreePage<PageType::InteriorTable> page(_reader, _header.page_size,
-                                            page_num);
-    processInteriorPage(page, column_positions, where_col_pos, where, results);
-  } else {
-    LOG_DEBUG("Processing leaf page: " << page_num);
-    BTreePage<PageType::LeafTable> page(_reader, _header.page_size, page_num);
-    processLeafPage(page, column_positions, where_col_pos, where, results);
+    return processInteriorPage(*loadPage<PageType::InteriorTable>(page_num),
+                               scan);
   }
+
+  LOG_DEBUG("Processing leaf page: " << page_num);
+  return processLeafPage(*loadPage<PageType::LeafTable>(page_num), scan);
 }
 
-void BTree::processLeafPage(const BTreePage<PageType::LeafTable> &page,
-                            const std::vector<int> &column_positions,
-                            int where_col_pos, const WhereClause &where,
-                            sqlite::QueryResult &results) const {
+bool BTree::processLeafPage(const BTreePage<PageType::LeafTable> &page,
+                            TableScan &scan) const {
   LOG_DEBUG("Processing leaf page cells");
 
-  for (const auto &cell : page.getCells()) {
-    BTreeRecord record(cell.payload);
-    const auto &values = record.getValues();
+  const auto &cells = page.getCells();
+  const ResidentNode *node = residentNode(page.getPageNumber());
+  auto indexAt = [&](size_t n) {
+    return scan.options.reverse ? cells.size() - 1 - n : n;
+  };
 
-    LOG_DEBUG("Checking record against where condition");
-
-    if (where_col_pos == -1 ||
-        matchesWhereCondition(values, where_col_pos, where)) {
-      Row row;
-      row.reserve(column_positions.size());
-      for (int pos : column_positions) {
-        if (pos == -1) {
-          row.push_back(static_cast<int64_t>(cell.row_id));
-        } else if (pos < values.size()) {
-          row.push_back(values[pos]);
-        }
+  // Zones cover every row of the page, whether the scan admits it or not
+  if (const ZoneScan *zones = scan.options.zones;
+      zones != nullptr && zones->map->find(page.getPageNumber()) == nullptr) {
+    CellRecords records(node);
+    std::vector<Zone> summary;
+    for (size_t i = 0; i < cells.size(); ++i) {
+      zones->map->addRow(summary, records.at(cells, i));
+    }
+    zones->map->set(page.getPageNumber(), std::move(summary));
+  }
+
+  if (scan.filter == nullptr) {
+    CellRecords records(node);
+    for (size_t n = 0; n < cells.size(); ++n) {
+      size_t i = indexAt(n);
+      if (!scan.options.admits(cells[i].row_id)) {
+        continue;
+      }
+      if (scan.offset > 0) {
+        --scan.offset;
+        continue;
+      }
+      if (!scan.sink(projectRow(records.at(cells, i), cells[i].row_id,
+                                scan.column_positions))) {
+        return false;
       }
-      results.push_back(row);
+    }
+    return true;
+  }
+
+  // Filtered scans decode the page's in-range records as one batch and let
+  // the predicate narrow it before any output row is built. Resident pages
+  // hand over their records as they are.
+  std::vector<BTreeRecord> records;
+  if (node == nullptr) {
+    records.reserve(cells.size());
+  }
+  RowBatch batch;
+  batch.rowids.reserve(cells.size());
+  batch.records.reserve(cells.size());
+  for (size_t n = 0; n < cells.size(); ++n) {
+    size_t i = indexAt(n);
+    if (!scan.options.admits(cells[i].row_id)) {
+      continue;
+    }
+    if (node != nullptr) {
+      batch.records.push_back(&node->records[i]);
+    } else {
+      records.emplace_back(cells[i].payload);
+    }
+    batch.rowids.push_back(cells[i].row_id);
+  }
+  for (const auto &record : records) {
+    batch.records.push_back(&record.getValues());
+  }
+
+  Selection selection(batch.rowids.size());
+  for (uint32_t i = 0; i < selection.size(); ++i) {
+    selection[i] = i;
+  }
+  scan.filter->filter(batch, selection);
+
+  for (uint32_t i : selection) {
+    if (scan.offset > 0) {
+      --scan.offset;
+      continue;
+    }
+    if (!scan.sink(projectRow(*batch.records[i], batch.rowids[i],
+                              scan.column_positions))) {
+      return false;
     }
   }
+  return true;
 }
 
-void BTree::processInteriorPage(const BTreePage<PageType::InteriorTable> &page,
-                                const std::vector<int> &column_positions,
-                                int where_col_pos, const WhereClause &where,
-                                sqlite::QueryResult &results) const {
+bool BTree::processInteriorPage(const BTreePage<PageType::InteriorTable> &page,
+                                TableScan &scan) const {
   LOG_DEBUG("Processing interior page cells");
 
-  for (const auto &cell : page.getCells()) {
-    uint32_t child_page = cell.left_pointer;
-    LOG_DEBUG("Traversing child page: " << child_page);
-    traverse(child_page, column_positions, where_col_pos, where, results);
+  // Child i holds the rowids in (key[i - 1], key[i]]; the right-most child
+  // holds everything above the last key.
+  const auto &cells = page.getCells();
+  const auto &range = scan.options.range;
+  const RowidBitmap *rowids = scan.options.rowids;
+  const ZoneScan *zones = scan.options.zones;
+  const uint32_t right_most = page.getHeader().right_most_pointer;
+  const size_t child_count = cells.size() + 1;
+
+  struct Child {
+    uint32_t page;
+    bool inside_range;
+  };
+  std::vector<Child> children;
+  children.reserve(child_count);
+  for (size_t n = 0; n < child_count; ++n) {
+    size_t i = scan.options.reverse ? child_count - 1 - n : n;
+    bool has_lower = i > 0;
+    bool has_upper = i < cells.size();
+    uint64_t lower = has_lower ? cells[i - 1].interior_row_id : 0;
+    uint64_t upper = has_upper ? cells[i].interior_row_id : UINT64_MAX;
+    uint32_t child_page = has_upper ? cells[i].left_pointer : right_most;
+
+    if (child_page == 0 || (has_lower && lower >= range.max) ||
+        upper < range.min) {
+      continue;
+    }
+    if (rowids != nullptr &&
+        !rowids->intersects(has_lower ? lower + 1 : 0, upper)) {
+      continue;
+    }
+    if (zones != nullptr && !zones->mayMatch(child_page)) {
+      countStat(&QueryStats::pages_pruned);
+      continue;
+    }
+
+    bool inside_range = (has_lower ? lower >= range.min : range.min == 0) &&
+                        upper <= range.max;
+    children.push_back({child_page, inside_range});
+  }
+
+  if (_reader.readahead() && children.size() > 1) {
+    std::vector<uint32_t> pages;
+    pages.reserve(children.size());
+    for (const Child &child : children) {
+      pages.push_back(child.page);
+    }
+    adviseRuns(_reader, std::move(pages), _header.page_size);
+  }
+
+  for (size_t n = 0; n < children.size(); ++n) {
+    // Keep the reads of the next children in flight while this one is
+    // decoded; requests for pages already pending are dropped
+    if (_reader.prefetching()) {
+      size_t end = std::min(children.size(), n + _reader.prefetchDepth());
+      for (size_t k = n; k < end; ++k) {
+        _reader.prefetch(children[k].page, _header.page_size);
+      }
+    }
+
+    const Child &child = children[n];
+    if (scan.offset > 0 && scan.filter == nullptr && rowids == nullptr &&
+        child.inside_range) {
+      uint64_t rows = countSubtreeRows(child.page);
+      if (rows <= scan.offset) {
+        LOG_DEBUG("Skipping " << rows << " rows under page " << child.page);
+        scan.offset -= rows;
+        continue;
+      }
+    }
+
+    LOG_DEBUG("Traversing child page: " << child.page);
+    if (!traversePage(child.page, scan)) {
+      return false;
+    }
   }
 
-  if (page.getHeader().right_most_pointer) {
-    LOG_DEBUG("Traversing right-most pointer: "
-              << page.getHeader().right_most_pointer);
-    traverse(page.getHeader().right_most_pointer, column_positions,
-             where_col_pos, where, results);
+  // Once every child is summarised, so is this subtree
+  if (zones != nullptr && zones->map->find(page.getPageNumber()) == nullptr) {
+    std::vector<uint32_t> child_pages;
+    child_pages.reserve(child_count);
+    for (const auto &cell : cells) {
+      child_pages.push_back(cell.left_pointer);
+    }
+    if (right_most != 0) {
+      child_pages.push_back(right_most);
+    }
+    zones->map->rollUp(page.getPageNumber(), child_pages);
   }
+  return true;
 }
 
-std::vector<uint64_t> BTree::scanIndex(uint32_t index_root_page,
-                                       const std::string &search_value) const {
-  LOG_INFO("Scanning index starting at root page: " << index_root_page);
-  LOG_DEBUG("Searching for value: " << search_value);
+uint64_t BTree::countSubtreeRows(uint32_t page_num) const {
+  PageType type = pageTypeOf(page_num);
+  if (type == PageType::LeafTable) {
+    return leafCellCount(page_num, PageType::LeafTable);
+  }
+  // WITHOUT ROWID tables are index trees
+  if (type != PageType::InteriorTable) {
+    return countIndexEntries(page_num);
+  }
 
-  std::vector<uint64_t> rowids;
-  traverseIndexBTree(index_root_page, search_value, rowids);
+  auto page = loadPage<PageType::InteriorTable>(page_num);
+  uint64_t rows = 0;
+  for (const auto &cell : page->getCells()) {
+    rows += countSubtreeRows(cell.left_pointer);
+  }
+  if (page->getHeader().right_most_pointer) {
+    rows += countSubtreeRows(page->getHeader().right_most_pointer);
+  }
+  return rows;
+}
 
-  LOG_INFO("Found " << rowids.size() << " matching rows");
-  return rowids;
+std::optional<uint64_t> BTree::findRowidExtreme(uint32_t page_num,
+                                                bool max) const {
+  if (pageTypeOf(page_num) == PageType::LeafTable) {
+    auto page = loadPage<PageType::LeafTable>(page_num);
+    const auto &cells = page->getCells();
+    if (cells.empty()) {
+      return std::nullopt;
+    }
+    return max ? cells.back().row_id : cells.front().row_id;
+  }
+
+  // Only an empty edge child sends the descent on to its neighbour
+  auto page = loadPage<PageType::InteriorTable>(page_num);
+  const auto &cells = page->getCells();
+  const size_t child_count = cells.size() + 1;
+  for (size_t n = 0; n < child_count; ++n) {
+    size_t i = max ? child_count - 1 - n : n;
+    uint32_t child_page = i < cells.size()
+                              ? cells[i].left_pointer
+                              : page->getHeader().right_most_pointer;
+    if (child_page == 0) {
+      continue;
+    }
+    if (auto rowid = findRowidExtreme(child_page, max)) {
+      return rowid;
+    }
+  }
+  return std::nullopt;
 }
 
-void BTree::traverseIndexBTree(uint32_t page_num,
-                               const std::string &search_value,
-                               std::vector<uint64_t> &rowids) const {
-  LOG_DEBUG("Traversing index B-tree page: " << page_num);
+std::optional<std::vector<RecordValue>>
+BTree::findIndexExtreme(uint32_t page_num, bool max) const {
+  CellRecords records(residentNode(page_num));
+  auto entryOf = [&records](const auto &cells, const auto &cell) {
+    return records.of(cells, cell);
+  };
+  // NULL keys sort first, so the minimum lies past them
+  auto nullKeyIn = [&records](const auto &cells) {
+    return [&records, &cells](const auto &cell) {
+      const auto &entry = records.of(cells, cell);
+      return entry.empty() ||
+             std::holds_alternative<std::monostate>(entry[0]);
+    };
+  };
 
-  _reader.seekToPage(page_num, _header.page_size);
-  uint8_t page_type = _reader.readU8();
-  _reader.seek(_header.page_size * (page_num - 1));
+  if (pageTypeOf(page_num) == PageType::LeafIndex) {
+    auto page = loadPage<PageType::LeafIndex>(page_num);
+    const auto &cells = page->getCells();
+    if (max) {
+      return cells.empty() ? std::nullopt
+                           : std::optional(entryOf(cells, cells.back()));
+    }
+    auto first =
+        std::partition_point(cells.begin(), cells.end(), nullKeyIn(cells));
+    return first == cells.end() ? std::nullopt
+                                : std::optional(entryOf(cells, *first));
+  }
 
-  if (static_cast<PageType>(page_type) == PageType::LeafIndex) {
-    LOG_DEBUG("Processing leaf index page");
-    BTreePage<PageType::LeafIndex> page(_reader, _header.page_size, page_num);
+  auto page = loadPage<PageType::InteriorIndex>(page_num);
+  const auto &cells = page->getCells();
+  const uint32_t right_most = page->getHeader().right_most_pointer;
 
-    for (const auto &cell : page.getCells()) {
-      BTreeRecord record(cell.payload);
-      const auto &values = record.getValues();
-
-      if (values.size() >= 2 &&
-          std::holds_alternative<std::string>(values[0]) &&
-          std::holds_alternative<int64_t>(values[1])) {
-
-        std::string key = std::get<std::string>(values[0]);
-        LOG_DEBUG("Comparing key: " << key
-                                    << " with search value: " << search_value);
-
-        if (key == search_value) {
-          uint64_t rowid = static_cast<uint64_t>(std::get<int64_t>(values[1]));
-          LOG_DEBUG("Found matching rowid: " << rowid);
-          // Check for duplicates before adding
-          if (std::find(rowids.begin(), rowids.end(), rowid) == rowids.end()) {
-            rowids.push_back(rowid);
-          }
-        }
+  // The last key is larger than everything left of the right-most child
+  if (max) {
+    if (right_most != 0) {
+      if (auto entry = findIndexExtreme(right_most, true)) {
+        return entry;
       }
     }
-  } else {
-    LOG_DEBUG("Processing interior index page");
-    BTreePage<PageType::InteriorIndex> page(_reader, _header.page_size,
-                                            page_num);
+    return cells.empty() ? std::nullopt
+                         : std::optional(entryOf(cells, cells.back()));
+  }
 
-    // Check interior cells for matching keys (they contain key + rowid payload)
-    for (const auto &cell : page.getCells()) {
-      BTreeRecord record(cell.payload);
-      const auto &values = record.getValues();
-
-      if (!values.empty() && std::holds_alternative<std::string>(values[0])) {
-        std::string key = std::get<std::string>(values[0]);
-        
-        if (key == search_value && values.size() >= 2 && 
-            std::holds_alternative<int64_t>(values[1])) {
-          uint64_t rowid = static_cast<uint64_t>(std::get<int64_t>(values[1]));
-          // Check for duplicates before adding
-          if (std::find(rowids.begin(), rowids.end(), rowid) == rowids.end()) {
-            rowids.push_back(rowid);
-          }
-        }
+  // The first non-NULL entry lies in the child left of the first non-NULL
+  // key, or is that key itself
+  auto first =
+      std::partition_point(cells.begin(), cells.end(), nullKeyIn(cells));
+  uint32_t child_page = first == cells.end() ? right_most : first->page_number;
+  if (child_page != 0) {
+    if (auto entry = findIndexExtreme(child_page, false)) {
+      return entry;
+    }
+  }
+  return first == cells.end() ? std::nullopt
+                              : std::optional(entryOf(cells, *first));
+}
+
+TreeEstimate BTree::estimateTree(uint32_t root_page) const {
+  TreeEstimate estimate;
+  uint64_t pages_at_level = 1;
+  uint32_t page_num = root_page;
+
+  // Resident trees are walked through their child pointers
+  if (const ResidentNode *node = residentNode(root_page)) {
+    while (node != nullptr) {
+      ++estimate.depth;
+      uint64_t cell_count = node->cellCount();
+      if (node->type == PageType::LeafTable ||
+          node->type == PageType::LeafIndex) {
+        estimate.rows += pages_at_level * cell_count;
+        return estimate;
+      }
+      if (node->type == PageType::InteriorIndex) {
+        estimate.rows += pages_at_level * cell_count;
+      }
+      pages_at_level *= cell_count + 1;
+      node = node->children.front();
+    }
+    return estimate;
+  }
+
+  while (true) {
+    _reader.seekToPage(page_num, _header.page_size);
+    auto type = static_cast<PageType>(_reader.readU8());
+    (void)_reader.readU16(); // first freeblock
+    uint16_t cell_count = _reader.readU16();
+    countPageRead(type);
+    ++estimate.depth;
+
+    if (type == PageType::LeafTable || type == PageType::LeafIndex) {
+      estimate.rows += pages_at_level * cell_count;
+      return estimate;
+    }
+
+    // Interior index cells are entries too; count them alongside the leaves
+    if (type == PageType::InteriorIndex) {
+      estimate.rows += pages_at_level * cell_count;
+    }
+    pages_at_level *= static_cast<uint64_t>(cell_count) + 1;
+
+    (void)_reader.readU16(); // cell content start
+    (void)_reader.readU8();  // fragmented free bytes
+    uint32_t right_most = _reader.readU32();
+    if (cell_count == 0) {
+      page_num = right_most;
+      continue;
+    }
+
+    // The first cell pointer leads to the leftmost cell's child pointer
+    uint16_t first_cell = _reader.readU16();
+    _reader.seek(static_cast<size_t>(page_num - 1) * _header.page_size +
+                 first_cell);
+    page_num = _reader.readU32();
+  }
+}
+
+bool BTree::walkIndexInOrder(uint32_t index_root_page, bool reverse,
+                             const IndexEntryVisitor &visit,
+                             const std::vector<RecordValue> *after) const {
+  const ResidentNode *node = residentNode(index_root_page);
+
+  // Entries at or beyond `after` in walk order have already been visited
+  auto alreadyVisited = [&](const std::vector<RecordValue> &entry) {
+    if (after == nullptr) {
+      return false;
+    }
+    int cmp = compareRecords(entry, *after);
+    return reverse ? cmp >= 0 : cmp <= 0;
+  };
+
+  auto visitEntry = [&](const std::vector<RecordValue> &entry) {
+    if (entry.empty() || alreadyVisited(entry)) {
+      return true;
+    }
+    return visit(entryRowid(entry), entry);
+  };
+
+  if (pageTypeOf(index_root_page) == PageType::LeafIndex) {
+    auto page = loadPage<PageType::LeafIndex>(index_root_page);
+    const auto &cells = page->getCells();
+    CellRecords records(node);
+    for (size_t n = 0; n < cells.size(); ++n) {
+      size_t i = reverse ? cells.size() - 1 - n : n;
+      if (!visitEntry(records.at(cells, i))) {
+        return false;
       }
-      
-      // Continue traversing child pages
-      traverseIndexBTree(cell.page_number, search_value, rowids);
     }
+    return true;
+  }
+
+  // Child i holds the entries between interior keys i - 1 and i; each
+  // interior key is itself an entry that sorts between those children.
+  auto page = loadPage<PageType::InteriorIndex>(index_root_page);
+  const auto &cells = page->getCells();
+  std::vector<std::vector<RecordValue>> decoded;
+  if (node == nullptr) {
+    decoded.reserve(cells.size());
+    for (const auto &cell : cells) {
+      decoded.push_back(BTreeRecord(cell.payload).getValues());
+    }
+  }
+  const auto &keys = node != nullptr ? node->records : decoded;
+
+  const uint32_t right_most = page->getHeader().right_most_pointer;
+  const size_t child_count = cells.size() + 1;
+
+  for (size_t n = 0; n < child_count; ++n) {
+    size_t i = reverse ? child_count - 1 - n : n;
+    bool has_upper = i < cells.size();
+    uint32_t child_page = has_upper ? cells[i].page_number : right_most;
+
+    // Forward walks skip children bounded above by a visited key, reverse
+    // walks skip children bounded below by one.
+    bool skip_child = reverse ? (i > 0 && alreadyVisited(keys[i - 1]))
+                              : (has_upper && alreadyVisited(keys[i]));
+
+    if (reverse && has_upper && !visitEntry(keys[i])) {
+      return false;
+    }
+    if (child_page != 0 && !skip_child &&
+        !walkIndexInOrder(child_page, reverse, visit, after)) {
+      return false;
+    }
+    if (!reverse && has_upper && !visitEntry(keys[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BTree::mayContainRowid(uint32_t root_page, uint64_t rowid) const {
+  const BloomFilter *bloom =
+      _bloom_filters ? _bloom_filters->find(root_page) : nullptr;
+  if (bloom && !bloom->mayContain(BloomFilter::hashRowid(rowid))) {
+    countStat(&QueryStats::bloom_rejections);
+    return false;
+  }
+  return true;
+}
+
+bool BTree::mayContainKey(uint32_t index_root_page,
+                          const IndexKeyRange &range) const {
+  if (range.equal.empty()) {
+    return true;
+  }
+  const BloomFilter *bloom =
+      _bloom_filters ? _bloom_filters->find(index_root_page) : nullptr;
+  if (bloom && !bloom->mayContain(BloomFilter::hashKey(range.equal[0]))) {
+    countStat(&QueryStats::bloom_rejections);
+    return false;
+  }
+  return true;
+}
+
+bool BTree::seekIndex(uint32_t index_root_page, const IndexKeyRange &range,
+                      const IndexEntryVisitor &visit) const {
+  return !mayContainKey(index_root_page, range) ||
+         seekIndexIn(index_root_page, range, visit);
+}
+
+bool BTree::seekIndexIn(uint32_t page_num, const IndexKeyRange &range,
+                        const IndexEntryVisitor &visit) const {
+  KeyProbe probe(residentNode(page_num), range);
+  auto visitEntry = [&](const std::vector<RecordValue> &entry) {
+    return entry.empty() || visit(entryRowid(entry), entry);
+  };
+
+  if (pageTypeOf(page_num) == PageType::LeafIndex) {
+    auto page = loadPage<PageType::LeafIndex>(page_num);
+    const auto &cells = page->getCells();
+    for (size_t i = probe.first(); i < cells.size(); ++i) {
+      int cmp = probe.position(cells, i);
+      if (cmp > 0) {
+        break;
+      }
+      if (cmp == 0 && !visitEntry(probe.entry(cells, i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Child i holds the entries between interior keys i - 1 and i. Keys are
+  // sorted, so children left of the first key in the range cannot match and
+  // the seek is over after the first child bounded by a key above it.
+  auto page = loadPage<PageType::InteriorIndex>(page_num);
+  const auto &cells = page->getCells();
+  for (size_t i = probe.first(); i < cells.size(); ++i) {
+    int cmp = probe.position(cells, i);
+    if (cmp >= 0 && !seekIndexIn(cells[i].page_number, range, visit)) {
+      return false;
+    }
+    if (cmp > 0) {
+      return true;
+    }
+    if (cmp == 0 && !visitEntry(probe.entry(cells, i))) {
+      return false;
+    }
+  }
+
+  uint32_t right_most = page->getHeader().right_most_pointer;
+  return right_most == 0 || seekIndexIn(right_most, range, visit);
+}
+
+bool BTree::traverseClustered(uint32_t root_page,
+                              const std::vector<int> &storage,
+                              const std::vector<int> &column_positions,
+                              const CompiledPredicate *filter,
+                              const RowSink &sink, const IndexKeyRange *range,
+                              bool reverse) const {
+  TraceSpan span("clustered_scan", root_page);
+  // Entries hold the key columns first; rows are put back in column order
+  std::vector<RecordValue> values(storage.size());
+  auto visit = [&](uint64_t, const std::vector<RecordValue> &entry) {
+    for (size_t i = 0; i < storage.size(); ++i) {
+      values[i] = static_cast<size_t>(storage[i]) < entry.size()
+                      ? entry[storage[i]]
+                      : RecordValue{};
+    }
+    if (filter != nullptr && !filter->matches(values)) {
+      return true;
+    }
+    return sink(projectRow(values, 0, column_positions));
+  };
+  return range ? seekIndex(root_page, *range, visit)
+               : walkIndexInOrder(root_page, reverse, visit);
+}
+
+uint64_t BTree::countIndexEntries(uint32_t page_num) const {
+  if (pageTypeOf(page_num) == PageType::LeafIndex) {
+    return leafCellCount(page_num, PageType::LeafIndex);
+  }
+
+  auto page = loadPage<PageType::InteriorIndex>(page_num);
+  uint64_t entries = page->getCells().size();
+  for (const auto &cell : page->getCells()) {
+    entries += countIndexEntries(cell.page_number);
+  }
+  if (page->getHeader().right_most_pointer) {
+    entries += countIndexEntries(page->getHeader().right_most_pointer);
+  }
+  return entries;
+}
 
-    if (page.getHeader().right_most_pointer) {
-      traverseIndexBTree(page.getHeader().right_most_pointer, search_value,
-                         rowids);
+uint64_t BTree::countIndexKey(uint32_t index_root_page,
+                              const IndexKeyRange &range,
+                              uint64_t limit) const {
+  TraceSpan span("index_count", index_root_page);
+  uint64_t count = 0;
+  if (mayContainKey(index_root_page, range)) {
+    countIndexKeyIn(index_root_page, range, limit, count);
+  }
+  LOG_INFO("Counted " << count << " index entries on root page "
+                      << index_root_page);
+  return count;
+}
+
+bool BTree::countIndexKeyIn(uint32_t page_num, const IndexKeyRange &range,
+                            uint64_t limit, uint64_t &count) const {
+  KeyProbe probe(residentNode(page_num), range);
+
+  if (pageTypeOf(page_num) == PageType::LeafIndex) {
+    auto page = loadPage<PageType::LeafIndex>(page_num);
+    const auto &cells = page->getCells();
+    auto first = std::partition_point(
+        cells.begin() + probe.first(), cells.end(),
+        [&](const auto &cell) { return probe.position(cells, cell) < 0; });
+    auto last = std::partition_point(first, cells.end(), [&](const auto &cell) {
+      return probe.position(cells, cell) == 0;
+    });
+    count += static_cast<uint64_t>(last - first);
+    return count < limit;
+  }
+
+  // Child i holds the entries between interior keys i - 1 and i, so children
+  // left of the first key in the range cannot match, and a child between two
+  // matching keys holds nothing but matches.
+  auto page = loadPage<PageType::InteriorIndex>(page_num);
+  const auto &cells = page->getCells();
+  auto before = [&](const auto &cell) {
+    return probe.position(cells, cell) < 0;
+  };
+  bool previous_matches = false;
+  for (auto it = std::partition_point(cells.begin() + probe.first(),
+                                      cells.end(), before);
+       it != cells.end(); ++it) {
+    int cmp = probe.position(cells, *it);
+    if (previous_matches && cmp == 0) {
+      count += countIndexEntries(it->page_number);
+    } else if (!countIndexKeyIn(it->page_number, range, limit, count)) {
+      return false;
+    }
+    if (cmp > 0) {
+      return count < limit;
     }
+    if (++count >= limit) {
+      return false;
+    }
+    previous_matches = true;
   }
+
+  uint32_t right_most = page->getHeader().right_most_pointer;
+  return right_most == 0 ||
+         countIndexKeyIn(right_most, range, limit, count);
+}
+
+void BTree::scanIndex(uint32_t index_root_page, const IndexKeyRange &range,
+                      RowidBitmap &rowids) const {
+  LOG_INFO("Scanning index starting at root page: " << index_root_page);
+  TraceSpan span("index_seek", index_root_page);
+
+  uint64_t found = 0;
+  seekIndex(index_root_page, range,
+            [&](uint64_t rowid, const std::vector<RecordValue> &) {
+              rowids.add(rowid);
+              ++found;
+              return true;
+            });
+
+  LOG_INFO("Found " << found << " matching rows");
 }
 
 void BTree::findRow(uint32_t page_num, uint64_t target_rowid,
                     const std::vector<int> &column_positions,
-                    sqlite::QueryResult &results) const {
+                    sqlite::QueryResult &results,
+                    const CompiledPredicate *filter) const {
+  if (mayContainRowid(page_num, target_rowid)) {
+    findRowIn(page_num, target_rowid, column_positions, results, filter);
+  }
+}
+
+void BTree::findRowIn(uint32_t page_num, uint64_t target_rowid,
+                      const std::vector<int> &column_positions,
+                      sqlite::QueryResult &results,
+                      const CompiledPredicate *filter) const {
+  // Resident trees are descended by searching each page's dense key array,
+  // following child pointers instead of page numbers
+  if (const ResidentNode *node = residentNode(page_num)) {
+    while (node != nullptr && node->type == PageType::InteriorTable) {
+      node = node->children[searchKeys(node->keys.data(), node->keys.size(),
+                                       target_rowid)];
+    }
+    if (node == nullptr || node->type != PageType::LeafTable) {
+      return;
+    }
+    size_t i = searchKeys(node->keys.data(), node->keys.size(), target_rowid);
+    if (i == node->keys.size() || node->keys[i] != target_rowid) {
+      return;
+    }
+    const auto &values = node->records[i];
+    if (filter == nullptr || filter->matches(values, target_rowid)) {
+      results.push_back(projectRow(values, target_rowid, column_positions));
+    }
+    return;
+  }
+
   _reader.seekToPage(page_num, _header.page_size);
   uint8_t page_type = _reader.readU8();
   _reader.seekToPage(page_num, _header.page_size);
@@ -176,7 +937,8 @@ void BTree::findRow(uint32_t page_num, uint64_t target_rowid,
     }
     
     if (target_rowid < cells[0].interior_row_id) {
-      findRow(cells[0].left_pointer, target_rowid, column_positions, results);
+      findRowIn(cells[0].left_pointer, target_rowid, column_positions,
+                results, filter);
       return;
     }
 
@@ -186,9 +948,11 @@ void BTree::findRow(uint32_t page_num, uint64_t target_rowid,
                               });
 
     if (it == cells.end()) {
-      findRow(page.getHeader().right_most_pointer, target_rowid, column_positions, results);
+      findRowIn(page.getHeader().right_most_pointer, target_rowid,
+                column_positions, results, filter);
     } else {
-      findRow(it->left_pointer, target_rowid, column_positions, results);
+      findRowIn(it->left_pointer, target_rowid, column_positions, results,
+                filter);
     }
   } else {
     BTreePage<PageType::LeafTable> page(_reader, _header.page_size, page_num);
@@ -197,42 +961,81 @@ void BTree::findRow(uint32_t page_num, uint64_t target_rowid,
       if (cell.row_id == target_rowid) {
         BTreeRecord record(cell.payload);
         const auto &values = record.getValues();
-        Row row;
-        row.reserve(column_positions.size());
-
-        for (int pos : column_positions) {
-          if (pos == -1) {
-            row.push_back(static_cast<int64_t>(cell.row_id));
-          } else if (pos < values.size()) {
-            row.push_back(values[pos]);
-          }
+        if (filter == nullptr || filter->matches(values, cell.row_id)) {
+          results.push_back(projectRow(values, cell.row_id, column_positions));
         }
-        results.push_back(row);
         return;
       }
     }
   }
 }
 
-bool BTree::matchesWhereCondition(const std::vector<RecordValue> &values,
-                                  int where_col_pos, const WhereClause &where) noexcept {
-  if (where_col_pos < 0 || where_col_pos >= values.size()) {
-    return false;
-  }
-
-  const auto &cell_value = values[where_col_pos];
-  if (std::holds_alternative<std::string>(cell_value)) {
-    const std::string &value = std::get<std::string>(cell_value);
-    std::string_view where_value = where.value;
+std::vector<TableIndex>
+BTree::getIndexes(const std::string &table_name) const {
+  auto schema_page = loadPage<PageType::LeafTable>(sqlite::SCHEMA_PAGE);
+  LOG_DEBUG("Reading sqlite_schema (page 1), found "
+            << schema_page->getHeader().cell_count << " entries");
 
-    if (where_value.front() == '\'' && where_value.back() == '\'') {
-      where_value = where_value.substr(1, where_value.length() - 2);
+  std::vector<TableIndex> indexes;
+  std::optional<SchemaRecord> table;
+  for (const auto &cell : schema_page->getCells()) {
+    BTreeRecord record(cell.payload);
+    const auto &values = record.getValues();
+    using namespace sqlite::schema;
+    if (values.size() <= SQL) {
+      continue;
     }
-
-    return where.operator_type == "=" && value == where_value;
+    const auto *type = std::get_if<std::string>(&values[TYPE]);
+    const auto *tbl_name = std::get_if<std::string>(&values[TBL_NAME]);
+    const auto *root_page = std::get_if<int64_t>(&values[ROOTPAGE]);
+    const auto *sql = std::get_if<std::string>(&values[SQL]);
+    if (!type || !tbl_name || *tbl_name != table_name) {
+      continue;
+    }
+    if (*type == sqlite::record_type::TABLE) {
+      table.emplace(record);
+      if (table->isWithoutRowid()) {
+        LOG_INFO(table_name << " is WITHOUT ROWID; its index entries end "
+                               "with the primary key, not a rowid");
+        return {};
+      }
+    }
+    if (*type != sqlite::record_type::INDEX || !root_page || !sql) {
+      continue;
+    }
+    // Indexes this parser cannot read are left to scans
+    try {
+      indexes.push_back({static_cast<uint32_t>(*root_page),
+                         std::move(*SQLParser::parseCreateIndex(*sql))});
+    } catch (const std::runtime_error &e) {
+      LOG_INFO("Skipping index: " << e.what());
+      continue;
+    }
+    LOG_DEBUG("Found index " << indexes.back().definition.index_name
+                             << " on root page " << *root_page);
   }
 
-  return false;
+  auto columnCollation = [&table](const std::string &name) {
+    if (table) {
+      for (const auto &column : table->getColumns()) {
+        if (equalsIgnoreCase(column.name, name)) {
+          return column.collation;
+        }
+      }
+    }
+    return std::string();
+  };
+  // Key columns without a COLLATE of their own sort by their column's
+  for (auto &index : indexes) {
+    for (auto &key_column : index.definition.columns) {
+      std::string collation = columnCollation(key_column.name);
+      if (key_column.collation.empty()) {
+        key_column.collation = collation;
+      }
+      index.column_collations.push_back(std::move(collation));
+    }
+  }
+  return indexes;
 }
 
 int64_t BTree::getIndexRootPage(const std::string &table_name,
@@ -240,41 +1043,15 @@ int64_t BTree::getIndexRootPage(const std::string &table_name,
   LOG_INFO("Looking for table: " << table_name);
   LOG_INFO("Index column: " << column_name);
 
-  BTreePage<PageType::LeafTable> schema_page(_reader, _header.page_size,
-                                             sqlite::SCHEMA_PAGE);
-  LOG_DEBUG("Reading sqlite_schema (page 1), found "
-            << schema_page.getHeader().cell_count << " entries");
-
-  int64_t index_root_page = 0;
-  for (const auto &cell : schema_page.getCells()) {
-    BTreeRecord record(cell.payload);
-    const auto &values = record.getValues();
-
-    if (values.empty() || !std::holds_alternative<std::string>(values[0])) {
-      continue;
+  for (const auto &index : getIndexes(table_name)) {
+    if (!index.definition.partial && index.seekableColumns() > 0 &&
+        equalsIgnoreCase(index.definition.columns.front().name,
+                         column_name)) {
+      LOG_INFO("Found matching index! Root page: " << index.root_page);
+      return index.root_page;
     }
-
-    std::string type = std::get<std::string>(values[0]);
-    LOG_DEBUG("Examining entry type: " << type);
-
-    if (type == "index" && values.size() >= 5) {
-      std::string tbl_name = std::get<std::string>(values[2]);
-      std::string sql = std::get<std::string>(values[4]);
-
-      if (tbl_name == table_name &&
-          sql.find(column_name) != std::string::npos) {
-        index_root_page = std::get<int64_t>(values[3]);
-        LOG_INFO("Found matching index! Root page: " << index_root_page);
-        break;
-      }
-    }
-  }
-
-  if (index_root_page == 0) {
-    throw std::runtime_error("Index not found for column: " + column_name);
   }
-
-  return index_root_page;
+  throw std::runtime_error("Index not found for column: " + column_name);
 }
 
 QueryResult BTree::fetchRowsByIds(const std::vector<uint64_t> &rowids,
@@ -1,28 +1,209 @@
 #pragma once
 
+#include "bloom_filter.hpp"
 #include "btree_page.hpp"
 #include "file_reader.hpp"
+#include "predicate.hpp"
+#include "resident_tree.hpp"
+#include "rowid_bitmap.hpp"
 #include "schema_record.hpp"
 #include "sqlite_constants.hpp"
+#include "zone_map.hpp"
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
 using Row = sqlite::Row;
 using QueryResult = sqlite::QueryResult;
+using RowSink = sqlite::RowSink;
+
+// Receives the rowid and the full decoded entry (key columns followed by the
+// rowid) of an index entry; returning false stops the walk. The entries of
+// WITHOUT ROWID tables have no rowid, and give 0 unless their last column
+// holds an integer.
+using IndexEntryVisitor =
+    std::function<bool(uint64_t rowid, const std::vector<RecordValue> &entry)>;
+
+// An index of a table, as its CREATE INDEX statement declares it, with
+// the collation each key column inherits from its table column filled in
+struct TableIndex {
+  uint32_t root_page{0};
+  CreateIndexStatement definition;
+  // Per key column, the collation of its table column, which comparisons
+  // against it use whatever the index sorts by; empty for BINARY
+  std::vector<std::string> column_collations{};
+
+  // How many leading columns seeks can use: plain columns, stored in
+  // ascending binary order and compared in binary
+  [[nodiscard]] size_t seekableColumns() const noexcept;
+};
+
+// The index entries whose leading columns equal `equal` and whose next
+// column then lies within the bounds given. With bounds on that column,
+// NULLs are left out of it, as no comparison holds for them.
+struct IndexKeyRange {
+  std::vector<RecordValue> equal{};
+  std::optional<RecordValue> lower{};
+  std::optional<RecordValue> upper{};
+  bool lower_inclusive{true};
+  bool upper_inclusive{true};
+};
+
+struct RowidRange {
+  uint64_t min{0};
+  uint64_t max{UINT64_MAX};
+
+  [[nodiscard]] bool contains(uint64_t rowid) const noexcept {
+    return rowid >= min && rowid <= max;
+  }
+};
+
+struct TreeEstimate {
+  uint64_t rows{0};
+  uint32_t depth{0};
+};
+
+struct ScanOptions {
+  bool reverse{false};
+  RowidRange range{};
+  // Leading matches to skip. Subtrees of unfiltered scans are skipped by
+  // summing leaf cell counts, without decoding any of their records.
+  uint64_t offset{0};
+  // When set, only these rowids are visited, and only subtrees holding at
+  // least one of them are read
+  const RowidBitmap *rowids{nullptr};
+  // When set, subtrees whose zones rule out the filter are not read, and
+  // pages read are summarised into the zone map
+  const ZoneScan *zones{nullptr};
+
+  [[nodiscard]] bool admits(uint64_t rowid) const noexcept {
+    return range.contains(rowid) &&
+           (rowids == nullptr || rowids->contains(rowid));
+  }
+};
 
 class BTree {
 public:
   BTree(FileReader &reader, const sqlite::Header &header) noexcept;
 
+  // Decodes every table and index tree into memory, records included, so
+  // that later queries neither read nor decode pages. Returns what it holds.
+  const ResidentFootprint &loadResident();
+
+  [[nodiscard]] bool resident() const noexcept { return _resident != nullptr; }
+
+  // Bloom filters that seeks with an equal leading key, and findRow, consult
+  // before reading any page; null for none
+  void setBloomFilters(const BloomFilters *filters) noexcept {
+    _bloom_filters = filters;
+  }
+
+  // False when the table's Bloom filter rules out the rowid
+  [[nodiscard]] bool mayContainRowid(uint32_t root_page,
+                                     uint64_t rowid) const;
+
   void traverse(uint32_t page_num, const std::vector<int> &column_positions,
-                int where_col_pos, const WhereClause &where,
+                const CompiledPredicate *filter,
                 sqlite::QueryResult &results) const;
 
-  std::vector<uint64_t> scanIndex(uint32_t index_root_page,
-                                  const std::string &search_value) const;
+  // Streams the rows passing `filter` (all rows when null) to `sink` in rowid
+  // order (descending when options.reverse is set), descending only into
+  // subtrees that overlap options.range and hold one of options.rowids.
+  // Each leaf page is filtered as one batch. Returns false if the sink
+  // stopped the scan.
+  bool traverse(uint32_t page_num, const std::vector<int> &column_positions,
+                const CompiledPredicate *filter, const RowSink &sink,
+                const ScanOptions &options = {}) const;
+
+  // Visits every index entry in key order (descending when `reverse` is set),
+  // including the entries stored in interior cells. When `after` is given,
+  // the walk seeks past it and starts with the next entry in walk order.
+  // Returns false if the visitor stopped the walk.
+  bool walkIndexInOrder(uint32_t index_root_page, bool reverse,
+                        const IndexEntryVisitor &visit,
+                        const std::vector<RecordValue> *after = nullptr) const;
+
+  // Visits, in key order, the index entries within `range`, descending only
+  // into subtrees whose bounds can hold some. Returns false if the visitor
+  // stopped the seek.
+  bool seekIndex(uint32_t index_root_page, const IndexKeyRange &range,
+                 const IndexEntryVisitor &visit) const;
+
+  // Seeks the entries whose leading column equals `key`
+  bool seekIndex(uint32_t index_root_page, const RecordValue &key,
+                 const IndexEntryVisitor &visit) const {
+    return seekIndex(index_root_page, IndexKeyRange{{key}}, visit);
+  }
 
+  // Streams the rows of a WITHOUT ROWID table, whose B-tree is an index
+  // keyed by its primary key, that pass `filter` (all when null): those
+  // whose key lies in `range`, found with one descent, or else every row in
+  // key order (descending with `reverse`). `storage` gives each column's
+  // field in the stored records. Returns false if the sink stopped the scan.
+  bool traverseClustered(uint32_t root_page, const std::vector<int> &storage,
+                         const std::vector<int> &column_positions,
+                         const CompiledPredicate *filter, const RowSink &sink,
+                         const IndexKeyRange *range = nullptr,
+                         bool reverse = false) const;
+
+  // Number of rows below `page_num`, read from leaf page headers only (and
+  // interior ones, for the index trees of WITHOUT ROWID tables).
+  uint64_t countSubtreeRows(uint32_t page_num) const;
+
+  // Number of entries below index page `page_num`, read from leaf page
+  // headers and the interior pages above them.
+  uint64_t countIndexEntries(uint32_t page_num) const;
+
+  // Number of index entries within `range`, counted from the index alone.
+  // Subtrees bounded by matching keys on both sides are counted from page
+  // headers, and leaf runs are found by binary search. Counting stops once
+  // at least `limit` entries are found.
+  uint64_t countIndexKey(uint32_t index_root_page, const IndexKeyRange &range,
+                         uint64_t limit = UINT64_MAX) const;
+
+  // Counts the entries whose leading column equals `key`
+  uint64_t countIndexKey(uint32_t index_root_page, const RecordValue &key,
+                         uint64_t limit = UINT64_MAX) const {
+    return countIndexKey(index_root_page, IndexKeyRange{{key}}, limit);
+  }
+
+  // Smallest rowid in a table, or the largest with `max`, found along the
+  // leftmost or rightmost root-to-leaf path. Empty tables have none.
+  std::optional<uint64_t> findRowidExtreme(uint32_t root_page, bool max) const;
+
+  // The first index entry whose leading column is not NULL, or the last
+  // entry with `max`, found along a single root-to-leaf descent.
+  std::optional<std::vector<RecordValue>>
+  findIndexExtreme(uint32_t index_root_page, bool max) const;
+
+  // Approximates a tree's size from its leftmost root-to-leaf path, assuming
+  // every page at a level has the same fanout as the one on that path.
+  TreeEstimate estimateTree(uint32_t root_page) const;
+
+  // Adds to `rowids` the rowids of the index entries within `range`.
+  void scanIndex(uint32_t index_root_page, const IndexKeyRange &range,
+                 RowidBitmap &rowids) const;
+
+  // Adds the rowids of the entries whose leading column equals `key`
+  void scanIndex(uint32_t index_root_page, const RecordValue &key,
+                 RowidBitmap &rowids) const {
+    scanIndex(index_root_page, IndexKeyRange{{key}}, rowids);
+  }
+
+  // Appends the row with `target_rowid` to `results` if it exists and passes
+  // `filter`.
   void findRow(uint32_t page_num, uint64_t target_rowid,
                const std::vector<int> &column_positions,
-               sqlite::QueryResult &results) const;
+               sqlite::QueryResult &results,
+               const CompiledPredicate *filter = nullptr) const;
+
+  // The table's indexes, in schema order. Indexes SQLite creates for
+  // UNIQUE and PRIMARY KEY constraints have no statement and are left out.
+  std::vector<TableIndex> getIndexes(const std::string &table_name) const;
+
+  // Root page of an index that seeks can use on `column_name`, the leading
+  // column of it; throws when the table has none.
   int64_t getIndexRootPage(const std::string &table_name,
                            const std::string &column_name) const;
   QueryResult fetchRowsByIds(const std::vector<uint64_t> &rowids,
@@ -33,20 +214,60 @@ public:
 private:
   FileReader &_reader;
   const sqlite::Header &_header;
+  std::unique_ptr<const ResidentTree> _resident;
+  const BloomFilters *_bloom_filters{nullptr};
+
+  // The page from the resident tree when loaded, decoded from the file
+  // otherwise
+  template <PageType T>
+  std::shared_ptr<const BTreePage<T>> loadPage(uint32_t page_num) const {
+    if (_resident) {
+      if (auto page = _resident->template page<T>(page_num)) {
+        return page;
+      }
+    }
+    return std::make_shared<const BTreePage<T>>(_reader, _header.page_size,
+                                                page_num);
+  }
+
+  PageType pageTypeOf(uint32_t page_num) const;
+
+  // The page's cell count, read from its header alone when not resident
+  uint64_t leafCellCount(uint32_t page_num, PageType type) const;
+
+  const ResidentNode *residentNode(uint32_t page_num) const noexcept {
+    return _resident ? _resident->node(page_num) : nullptr;
+  }
+
+  struct TableScan {
+    const std::vector<int> &column_positions;
+    const CompiledPredicate *filter;
+    const RowSink &sink;
+    const ScanOptions &options;
+    uint64_t offset;
+  };
+
+  bool traversePage(uint32_t page_num, TableScan &scan) const;
+
+  // False when the index's Bloom filter rules out the range's leading key
+  bool mayContainKey(uint32_t index_root_page,
+                     const IndexKeyRange &range) const;
+
+  bool seekIndexIn(uint32_t page_num, const IndexKeyRange &range,
+                   const IndexEntryVisitor &visit) const;
 
-  void traverseIndexBTree(uint32_t page_num, const std::string &search_value,
-                          std::vector<uint64_t> &rowids) const;
+  void findRowIn(uint32_t page_num, uint64_t target_rowid,
+                 const std::vector<int> &column_positions,
+                 sqlite::QueryResult &results,
+                 const CompiledPredicate *filter) const;
 
-  void processLeafPage(const BTreePage<PageType::LeafTable> &page,
-                       const std::vector<int> &column_positions,
-                       int where_col_pos, const WhereClause &where,
-                       sqlite::QueryResult &results) const;
+  // Adds matches below `page_num` to `count`; false once `limit` is reached
+  bool countIndexKeyIn(uint32_t page_num, const IndexKeyRange &range,
+                       uint64_t limit, uint64_t &count) const;
 
-  void processInteriorPage(const BTreePage<PageType::InteriorTable> &page,
-                           const std::vector<int> &column_positions,
-                           int where_col_pos, const WhereClause &where,
-                           sqlite::QueryResult &results) const;
+  bool processLeafPage(const BTreePage<PageType::LeafTable> &page,
+                       TableScan &scan) const;
 
-  static bool matchesWhereCondition(const std::vector<RecordValue> &values,
-                                     int where_col_pos, const WhereClause &where) noexcept;
+  bool processInteriorPage(const BTreePage<PageType::InteriorTable> &page,
+                           TableScan &scan) const;
 };
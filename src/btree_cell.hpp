@@ -30,7 +30,7 @@ public:
 
     // For leaf table pages
     std::conditional_t<PageTraits<T>::is_table && PageTraits<T>::is_leaf,
-                       uint32_t, std::monostate>
+                       uint64_t, std::monostate>
         row_id{};
   };
 
@@ -73,7 +73,7 @@ private:
 
     if constexpr (PageTraits<T>::is_table && PageTraits<T>::is_leaf) {
       auto [row_id, row_id_bytes] = reader_.readVarint();
-      cell.row_id = static_cast<uint32_t>(row_id);
+      cell.row_id = static_cast<uint64_t>(row_id);
       LOG_DEBUG("Leaf cell row ID: " << cell.row_id
                                      << ", payload size: " << payload_size);
     }
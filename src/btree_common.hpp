@@ -1,3 +1,5 @@
+#pragma once
+
 #include <cstdint>
 
 // Page type traits
@@ -2,6 +2,8 @@
 #include "btree_cell.hpp"
 #include "debug.hpp"
 #include "file_reader.hpp"
+#include "query_stats.hpp"
+#include "trace.hpp"
 #include <concepts>
 #include <cstdint>
 #include <type_traits>
@@ -26,8 +28,12 @@ public:
                      uint32_t page_number)
       : reader_(reader), page_size_(page_size), page_number_(page_number) {
     LOG_DEBUG("Creating BTreePage with page size: " << page_size);
+    TraceSpan span("page_fetch", page_number);
+    PhaseTimer timer(QueryPhase::IO);
     parseHeader();
+    countPageRead(T);
     readCellPointers();
+    countStat(&QueryStats::cells_decoded, cells_.size());
   }
 
   [[nodiscard]] auto getHeader() const noexcept -> const Header & {
@@ -40,6 +46,10 @@ public:
     return cells_;
   }
 
+  [[nodiscard]] auto getPageNumber() const noexcept -> uint32_t {
+    return page_number_;
+  }
+
   static constexpr auto isLeaf() noexcept -> bool {
     return PageTraits<T>::is_leaf;
   }
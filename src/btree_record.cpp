@@ -1,13 +1,183 @@
 #include "btree_record.hpp"
 #include "debug.hpp"
+#include "query_stats.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace {
+
+int typeClass(const RecordValue &value) noexcept {
+  switch (value.index()) {
+  case 0:
+    return 0; // NULL
+  case 1:
+  case 2:
+    return 1; // INTEGER / REAL
+  case 3:
+    return 2; // TEXT
+  default:
+    return 3; // BLOB
+  }
+}
+
+template <typename T> int threeWay(const T &lhs, const T &rhs) noexcept {
+  return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+}
+
+int compareNumeric(const RecordValue &lhs, const RecordValue &rhs) noexcept {
+  if (std::holds_alternative<int64_t>(lhs) &&
+      std::holds_alternative<int64_t>(rhs)) {
+    return threeWay(std::get<int64_t>(lhs), std::get<int64_t>(rhs));
+  }
+  double left = std::holds_alternative<int64_t>(lhs)
+                    ? static_cast<double>(std::get<int64_t>(lhs))
+                    : std::get<double>(lhs);
+  double right = std::holds_alternative<int64_t>(rhs)
+                     ? static_cast<double>(std::get<int64_t>(rhs))
+                     : std::get<double>(rhs);
+  return threeWay(left, right);
+}
+
+int compareBytes(const uint8_t *lhs, size_t lhs_size, const uint8_t *rhs,
+                 size_t rhs_size) noexcept {
+  size_t common = std::min(lhs_size, rhs_size);
+  int result = common == 0 ? 0 : std::memcmp(lhs, rhs, common);
+  return result != 0 ? result : threeWay(lhs_size, rhs_size);
+}
+
+int compareText(std::string_view lhs, std::string_view rhs,
+                Collation collation) noexcept {
+  if (collation == Collation::RTrim) {
+    lhs = lhs.substr(0, lhs.find_last_not_of(' ') + 1);
+    rhs = rhs.substr(0, rhs.find_last_not_of(' ') + 1);
+  }
+  if (collation == Collation::NoCase) {
+    auto fold = [](char c) {
+      auto byte = static_cast<uint8_t>(c);
+      return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+    };
+    size_t common = std::min(lhs.size(), rhs.size());
+    for (size_t i = 0; i < common; ++i) {
+      if (int diff = fold(lhs[i]) - fold(rhs[i]); diff != 0) {
+        return diff;
+      }
+    }
+    return threeWay(lhs.size(), rhs.size());
+  }
+  return compareBytes(reinterpret_cast<const uint8_t *>(lhs.data()),
+                      lhs.size(),
+                      reinterpret_cast<const uint8_t *>(rhs.data()),
+                      rhs.size());
+}
+
+} // namespace
+
+int compareRecordValues(const RecordValue &lhs, const RecordValue &rhs,
+                        Collation collation) noexcept {
+  int lhs_class = typeClass(lhs);
+  int rhs_class = typeClass(rhs);
+  if (lhs_class != rhs_class) {
+    return lhs_class < rhs_class ? -1 : 1;
+  }
+
+  switch (lhs_class) {
+  case 0:
+    return 0;
+  case 1:
+    return compareNumeric(lhs, rhs);
+  case 2:
+    return compareText(std::get<std::string>(lhs), std::get<std::string>(rhs),
+                       collation);
+  default: {
+    const auto &left = std::get<std::vector<uint8_t>>(lhs);
+    const auto &right = std::get<std::vector<uint8_t>>(rhs);
+    return compareBytes(left.data(), left.size(), right.data(), right.size());
+  }
+  }
+}
 
 BTreeRecord::BTreeRecord(const std::vector<uint8_t> &payload)
     : reader_(payload) {
   LOG_DEBUG("Creating BTreeRecord with payload size: " << payload.size());
+  TraceSpan span("record_decode", payload.size());
+  PhaseTimer timer(QueryPhase::Decode);
+  countStat(&QueryStats::records_materialized);
   parseHeader();
   parseValues();
 }
 
+int compareRecords(const std::vector<RecordValue> &lhs,
+                   const std::vector<RecordValue> &rhs) noexcept {
+  size_t common = std::min(lhs.size(), rhs.size());
+  for (size_t i = 0; i < common; ++i) {
+    int result = compareRecordValues(lhs[i], rhs[i]);
+    if (result != 0) {
+      return result;
+    }
+  }
+  return threeWay(lhs.size(), rhs.size());
+}
+
+size_t hashRecordValue(const RecordValue &value) noexcept {
+  constexpr size_t BLOB_SEED = 0x9e3779b97f4a7c15ULL;
+
+  switch (value.index()) {
+  case 0:
+    return 0;
+  case 1:
+    return std::hash<int64_t>{}(std::get<int64_t>(value));
+  case 2: {
+    double real = std::get<double>(value);
+    // Integral reals must land in the same bucket as the equal integer
+    if (real >= -9.2e18 && real <= 9.2e18 &&
+        real == static_cast<double>(static_cast<int64_t>(real))) {
+      return std::hash<int64_t>{}(static_cast<int64_t>(real));
+    }
+    return std::hash<double>{}(real);
+  }
+  case 3:
+    return std::hash<std::string_view>{}(std::get<std::string>(value));
+  default: {
+    const auto &blob = std::get<std::vector<uint8_t>>(value);
+    return BLOB_SEED ^ std::hash<std::string_view>{}(std::string_view(
+                           reinterpret_cast<const char *>(blob.data()),
+                           blob.size()));
+  }
+  }
+}
+
+std::string recordValueToText(const RecordValue &value) {
+  switch (value.index()) {
+  case 0:
+    return {};
+  case 1:
+    return std::to_string(std::get<int64_t>(value));
+  case 2: {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", std::get<double>(value));
+    std::string text = buffer;
+    if (text.find_first_of(".ein") == std::string::npos) {
+      text += ".0";
+    } else if (size_t exponent = text.find('e');
+               exponent != std::string::npos &&
+               text.find('.') == std::string::npos) {
+      text.insert(exponent, ".0");
+    }
+    return text;
+  }
+  case 3:
+    return std::get<std::string>(value);
+  default: {
+    const auto &blob = std::get<std::vector<uint8_t>>(value);
+    return std::string(blob.begin(), blob.end());
+  }
+  }
+}
+
 const std::vector<RecordValue> &BTreeRecord::getValues() const {
   return values_;
 }
@@ -61,17 +231,17 @@ RecordValue BTreeRecord::readValue(SerialType type) {
   case SerialType::Null:
     return std::monostate{};
   case SerialType::Int8:
-    return static_cast<int64_t>(reader_.readU8());
+    return static_cast<int64_t>(reader_.readI8());
   case SerialType::Int16:
-    return static_cast<int64_t>(reader_.readU16());
+    return static_cast<int64_t>(reader_.readI16());
   case SerialType::Int24:
-    return static_cast<int64_t>(reader_.read24());
+    return static_cast<int64_t>(reader_.readI24());
   case SerialType::Int32:
-    return static_cast<int64_t>(reader_.readU32());
+    return static_cast<int64_t>(reader_.readI32());
   case SerialType::Int48:
-    return static_cast<int64_t>(reader_.read48());
+    return static_cast<int64_t>(reader_.readI48());
   case SerialType::Int64:
-    return static_cast<int64_t>(reader_.readU64());
+    return static_cast<int64_t>(reader_.readI64());
   case SerialType::Float64:
     return reader_.readDouble();
   case SerialType::Zero:
@@ -26,6 +26,30 @@ using RecordValue = std::variant<std::monostate,      // NULL
                                  std::vector<uint8_t> // BLOB
                                  >;
 
+// How TEXT values compare, as SQLite's built-in collations do: NOCASE folds
+// ASCII letters only, and RTRIM ignores trailing spaces.
+enum class Collation { Binary, NoCase, RTrim };
+
+// Compares two values using SQLite's cross-type ordering: NULL sorts first,
+// then numeric values, then TEXT (under `collation`), then BLOB. Returns a
+// negative, zero or positive value like memcmp.
+[[nodiscard]] int
+compareRecordValues(const RecordValue &lhs, const RecordValue &rhs,
+                    Collation collation = Collation::Binary) noexcept;
+
+// Compares two records column by column with compareRecordValues; a record
+// that is a prefix of the other sorts first.
+[[nodiscard]] int compareRecords(const std::vector<RecordValue> &lhs,
+                                 const std::vector<RecordValue> &rhs) noexcept;
+
+// Hash consistent with compareRecordValues: values that compare equal (such
+// as the integer 3 and the real 3.0) hash equally.
+[[nodiscard]] size_t hashRecordValue(const RecordValue &value) noexcept;
+
+// Renders a value the way SQLite converts it to TEXT: reals use 15
+// significant digits and always show a decimal point, NULL becomes "".
+[[nodiscard]] std::string recordValueToText(const RecordValue &value);
+
 class BTreeRecord {
 public:
   explicit BTreeRecord(const std::vector<uint8_t> &payload);
@@ -1,11 +1,20 @@
 #include "database.hpp"
 #include "btree.hpp"
 #include "debug.hpp"
+#include "lexer.hpp"
+#include "query_stats.hpp"
+#include "resume_token.hpp"
+#include "trace.hpp"
+#include "rowid_bitmap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 Database::Database(const std::string &filename)
     : _reader(filename), _table_manager(_reader, _header),
       _btree(_reader, _header) {
   LOG_INFO("Opening database file: " << filename);
+  _btree.setBloomFilters(&_bloom_filters);
 }
 
 sqlite::Header Database::readHeader() {
@@ -67,6 +76,7 @@ sqlite::Header Database::readHeader() {
 
 uint16_t Database::getTableCount() const {
   LOG_INFO("Counting tables in database");
+  auto read = _reader.beginRead();
   uint16_t table_count = 0;
   BTreePage<PageType::LeafTable> schema_page(_reader, _header.page_size,
                                              sqlite::SCHEMA_PAGE);
@@ -83,6 +93,7 @@ uint16_t Database::getTableCount() const {
 
 std::vector<std::string> Database::getTableNames() const {
   LOG_INFO("Getting table names from database");
+  auto read = _reader.beginRead();
   std::vector<std::string> table_names;
   BTreePage<PageType::LeafTable> schema_page(_reader, _header.page_size,
                                              sqlite::SCHEMA_PAGE);
@@ -99,59 +110,1458 @@ std::vector<std::string> Database::getTableNames() const {
   return table_names;
 }
 
+namespace {
+
+// Rows an equality filter is assumed to keep out of every FILTER_SELECTIVITY
+// when estimating join input sizes.
+constexpr uint64_t FILTER_SELECTIVITY = 10;
+
+// SQLite may store an integral REAL as an integer; it reads back as REAL
+void applyReadAffinity(Affinity affinity, RecordValue &value) {
+  if (affinity == Affinity::Real) {
+    if (const auto *integer = std::get_if<int64_t>(&value)) {
+      value = static_cast<double>(*integer);
+    }
+  }
+}
+
+// Appends rows to `results`, dropping hidden key columns past the output
+// columns whose `affinities` are given, and stops the producer once `limit`
+// rows are in.
+sqlite::RowSink collectInto(QueryResult &results,
+                            std::vector<Affinity> affinities, uint64_t limit) {
+  return [&results, affinities = std::move(affinities), limit](Row &&row) {
+    PhaseTimer timer(QueryPhase::Output);
+    traceInstant("row_emit", results.size());
+    row.resize(affinities.size());
+    for (size_t i = 0; i < row.size(); ++i) {
+      applyReadAffinity(affinities[i], row[i]);
+    }
+    results.push_back(std::move(row));
+    return results.size() < limit;
+  };
+}
+
+// Resolves WHERE column names, bare or qualified with the table name or
+// alias, against a single table.
+ColumnResolver tableResolver(const SelectStatement &stmt,
+                             const SchemaRecord &schema) {
+  return [&stmt, &schema](const std::string &name) {
+    auto [qualifier, column] = splitQualifiedName(name);
+    std::optional<ResolvedColumn> resolved;
+    if (qualifier.empty() || qualifier == stmt.table_name ||
+        qualifier == stmt.table_alias) {
+      resolved = schema.resolveColumn(column);
+    }
+    if (!resolved) {
+      throw std::runtime_error("Unknown column: " + name);
+    }
+    return *resolved;
+  };
+}
+
+// Splits a comparison into its column and constant sides, mirroring the
+// operator when the constant was written first.
+struct ColumnComparison {
+  ResolvedColumn column;
+  std::string name;
+  ExprOp op;
+  RecordValue constant;
+};
+
+std::optional<ColumnComparison>
+asColumnComparison(const Expr &term, const ColumnResolver &resolve) {
+  if (term.kind != ExprKind::Compare) {
+    return std::nullopt;
+  }
+  const Expr *column = term.operands[0].get();
+  const Expr *constant = term.operands[1].get();
+  ExprOp op = term.op;
+  if (column->kind == ExprKind::Literal) {
+    std::swap(column, constant);
+    switch (op) {
+    case ExprOp::Lt:
+      op = ExprOp::Gt;
+      break;
+    case ExprOp::Le:
+      op = ExprOp::Ge;
+      break;
+    case ExprOp::Gt:
+      op = ExprOp::Lt;
+      break;
+    case ExprOp::Ge:
+      op = ExprOp::Le;
+      break;
+    default:
+      break;
+    }
+  }
+  if (column->kind != ExprKind::Column || constant->kind != ExprKind::Literal ||
+      std::holds_alternative<std::monostate>(constant->value)) {
+    return std::nullopt;
+  }
+
+  ColumnComparison comparison{resolve(column->column), column->column, op,
+                              constant->value};
+  applyAffinity(comparison.column.affinity, comparison.constant);
+  return comparison;
+}
+
+// False when the range is a single rowid that the table's Bloom filter
+// rules out
+bool rowidRangeMayMatch(const BTree &btree, uint32_t root_page,
+                        const RowidRange &range) {
+  return range.min != range.max || btree.mayContainRowid(root_page, range.min);
+}
+
+// Intersects `range` with the rowid bounds implied by comparisons of the
+// rowid against constants. Returns false when no rowid can match.
+bool narrowRowidRange(const std::vector<ExprPtr> &terms,
+                      const ColumnResolver &resolve, RowidRange &range) {
+  for (const auto &term : terms) {
+    auto comparison = asColumnComparison(*term, resolve);
+    if (!comparison || comparison->column.position != -1) {
+      continue;
+    }
+
+    // Rowids are integers, so bounds on reals round inwards
+    const RecordValue &value = comparison->constant;
+    double lower = 0;
+    double upper = 0;
+    if (const auto *integer = std::get_if<int64_t>(&value)) {
+      lower = upper = static_cast<double>(*integer);
+    } else if (const auto *real = std::get_if<double>(&value)) {
+      lower = std::ceil(*real);
+      upper = std::floor(*real);
+    } else {
+      continue;
+    }
+
+    double min = 0;
+    double max = 1.8e19;
+    switch (comparison->op) {
+    case ExprOp::Eq:
+      min = lower;
+      max = upper;
+      break;
+    case ExprOp::Gt:
+      min = upper + 1;
+      break;
+    case ExprOp::Ge:
+      min = lower;
+      break;
+    case ExprOp::Lt:
+      max = lower - 1;
+      break;
+    case ExprOp::Le:
+      max = upper;
+      break;
+    default:
+      continue;
+    }
+
+    if (max < 0 || min > max) {
+      return false;
+    }
+    if (min > 0) {
+      range.min = std::max(range.min, static_cast<uint64_t>(min));
+    }
+    if (max < 1.8e19) {
+      range.max = std::min(range.max, static_cast<uint64_t>(max));
+    }
+    if (range.min > range.max) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Rowids gathered from index seeks; `exact` is false when the set may also
+// hold rowids the predicate rejects or that no row has.
+struct IndexedRowids {
+  RowidBitmap rowids;
+  bool exact;
+};
+
+// The column and distinct constant keys of `column = constant` or
+// `column IN (constants)`, converted to the column's affinity and sorted
+// under its collation
+struct EqualityKeys {
+  ResolvedColumn column;
+  std::vector<RecordValue> keys;
+};
+
+std::optional<EqualityKeys> asEqualityKeys(const Expr &term,
+                                           const ColumnResolver &resolve) {
+  EqualityKeys equalities{};
+  if (auto comparison = asColumnComparison(term, resolve)) {
+    if (comparison->op != ExprOp::Eq) {
+      return std::nullopt;
+    }
+    equalities.column = comparison->column;
+    equalities.keys.push_back(std::move(comparison->constant));
+    return equalities;
+  }
+  if (term.kind != ExprKind::InList || term.negated ||
+      term.operands[0]->kind != ExprKind::Column) {
+    return std::nullopt;
+  }
+
+  equalities.column = resolve(term.operands[0]->column);
+  for (size_t i = 1; i < term.operands.size(); ++i) {
+    const Expr &item = *term.operands[i];
+    if (item.kind != ExprKind::Literal) {
+      return std::nullopt;
+    }
+    // A NULL item never equals anything, so it adds no rows
+    if (!std::holds_alternative<std::monostate>(item.value)) {
+      equalities.keys.push_back(item.value);
+      applyAffinity(equalities.column.affinity, equalities.keys.back());
+    }
+  }
+  auto &keys = equalities.keys;
+  const Collation collation = equalities.column.collation;
+  std::sort(keys.begin(), keys.end(),
+            [collation](const RecordValue &lhs, const RecordValue &rhs) {
+              return compareRecordValues(lhs, rhs, collation) < 0;
+            });
+  keys.erase(
+      std::unique(keys.begin(), keys.end(),
+                  [collation](const RecordValue &lhs, const RecordValue &rhs) {
+                    return compareRecordValues(lhs, rhs, collation) == 0;
+                  }),
+      keys.end());
+  return equalities;
+}
+
+// Root page of the index on a table column, if it has one
+std::optional<uint32_t> findIndexRootPage(const BTree &btree,
+                                          const std::string &table_name,
+                                          const std::string &column_name) {
+  try {
+    return static_cast<uint32_t>(
+        btree.getIndexRootPage(table_name, column_name));
+  } catch (const std::runtime_error &) {
+    LOG_INFO("No index on " << column_name);
+    return std::nullopt;
+  }
+}
+
+// Answers `column = constant` and `column IN (constants)` from the column's
+// index, or directly for the rowid. Indexes are only seeked for columns
+// compared in BINARY, so NOCASE and RTRIM columns count as unindexed.
+// Unindexed columns are answered from an adaptive index once they have
+// earned one. Returns nullopt for other shapes and for the remaining
+// unindexed columns.
+std::optional<IndexedRowids> lookupEqualities(const BTree &btree,
+                                              AdaptiveIndexes *adaptive,
+                                              const std::string &table_name,
+                                              const SchemaRecord &schema,
+                                              const Expr &term,
+                                              const ColumnResolver &resolve) {
+  auto equalities = asEqualityKeys(term, resolve);
+  if (!equalities) {
+    return std::nullopt;
+  }
+
+  // Rowid keys are taken as they are, unless the table's Bloom filter rules
+  // them out; they need not name existing rows
+  IndexedRowids result{{}, true};
+  if (equalities->column.position == -1) {
+    auto root_page = static_cast<uint32_t>(schema.getRootPage());
+    auto add = [&](uint64_t rowid) {
+      if (btree.mayContainRowid(root_page, rowid)) {
+        result.rowids.add(rowid);
+      }
+    };
+    for (const auto &key : equalities->keys) {
+      if (const auto *integer = std::get_if<int64_t>(&key)) {
+        add(static_cast<uint64_t>(*integer));
+      } else if (const auto *real = std::get_if<double>(&key);
+                 real && *real >= 0 && *real < 1.8e19 &&
+                 std::floor(*real) == *real) {
+        add(static_cast<uint64_t>(*real));
+      }
+    }
+    result.exact = false;
+    return result;
+  }
+
+  const std::string &name =
+      schema.getColumns()[equalities->column.position].name;
+  auto index_root_page = findIndexRootPage(btree, table_name, name);
+  if (!index_root_page) {
+    const ColumnIndex *index =
+        adaptive ? adaptive->use(static_cast<uint32_t>(schema.getRootPage()),
+                                 equalities->column.position,
+                                 equalities->column.collation)
+                 : nullptr;
+    if (index == nullptr) {
+      return std::nullopt;
+    }
+    LOG_INFO("Looking up " << equalities->keys.size() << " keys of " << name
+                           << " in its adaptive index");
+    for (const auto &key : equalities->keys) {
+      index->find(key, result.rowids);
+    }
+    return result;
+  }
+  LOG_INFO("Seeking index on " << name << " for " << equalities->keys.size()
+                               << " keys");
+  for (const auto &key : equalities->keys) {
+    btree.scanIndex(*index_root_page, key, result.rowids);
+  }
+  return result;
+}
+
+// A key range over some columns, and the terms it was built from
+struct KeyMatch {
+  IndexKeyRange range;
+  std::vector<size_t> terms;
+};
+
+// The comparisons of `terms` that a key range can answer: column versus
+// constant with any operator but `!=`, on a column other than the rowid
+std::vector<std::optional<ColumnComparison>>
+keyComparisons(const std::vector<ExprPtr> &terms,
+               const ColumnResolver &resolve) {
+  std::vector<std::optional<ColumnComparison>> comparisons;
+  comparisons.reserve(terms.size());
+  for (const auto &term : terms) {
+    auto comparison = asColumnComparison(*term, resolve);
+    if (comparison && (comparison->column.position == -1 ||
+                       comparison->op == ExprOp::Ne)) {
+      comparison.reset();
+    }
+    comparisons.push_back(std::move(comparison));
+  }
+  return comparisons;
+}
+
+// Matches comparisons to the columns of a key, given by position in key
+// order: equalities on a prefix of them, then bounds on the next one. Bounds
+// on the first column are only taken with `leading_range`.
+KeyMatch
+matchKeyColumns(const std::vector<std::optional<ColumnComparison>> &comparisons,
+                const std::vector<int> &key, bool leading_range) {
+  // The first term comparing `position` with `op`, or with `alternative`
+  auto findTerm = [&](int position, ExprOp op, ExprOp alternative) {
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+      const auto &comparison = comparisons[i];
+      if (comparison && comparison->column.position == position &&
+          (comparison->op == op || comparison->op == alternative)) {
+        return std::optional<size_t>(i);
+      }
+    }
+    return std::optional<size_t>();
+  };
+
+  KeyMatch match;
+  IndexKeyRange &range = match.range;
+  for (int position : key) {
+    if (auto eq = findTerm(position, ExprOp::Eq, ExprOp::Eq)) {
+      range.equal.push_back(comparisons[*eq]->constant);
+      match.terms.push_back(*eq);
+      continue;
+    }
+    if (range.equal.empty() && !leading_range) {
+      break;
+    }
+    if (auto lower = findTerm(position, ExprOp::Gt, ExprOp::Ge)) {
+      range.lower = comparisons[*lower]->constant;
+      range.lower_inclusive = comparisons[*lower]->op == ExprOp::Ge;
+      match.terms.push_back(*lower);
+    }
+    if (auto upper = findTerm(position, ExprOp::Lt, ExprOp::Le)) {
+      range.upper = comparisons[*upper]->constant;
+      range.upper_inclusive = comparisons[*upper]->op == ExprOp::Le;
+      match.terms.push_back(*upper);
+    }
+    break;
+  }
+  return match;
+}
+
+// Answers the equalities and comparisons among an AND's terms with one seek
+// on the index whose leading columns they cover: equalities on a prefix of
+// its columns, then bounds on the next one. Marks the terms it answered in
+// `used`; returns nullopt unless some index covers two columns, or bounds
+// one after an equality, as lone equalities are looked up on their own.
+std::optional<IndexedRowids> seekCompositeIndex(
+    const BTree &btree, const std::string &table_name,
+    const SchemaRecord &schema, const std::vector<ExprPtr> &terms,
+    const ColumnResolver &resolve, std::vector<bool> &used) {
+  auto comparisons = keyComparisons(terms, resolve);
+  uint32_t best_root = 0;
+  KeyMatch best;
+  for (const auto &index : btree.getIndexes(table_name)) {
+    if (index.definition.partial) {
+      continue;
+    }
+    std::vector<int> key;
+    for (size_t n = 0; n < index.seekableColumns(); ++n) {
+      auto column = schema.resolveColumn(index.definition.columns[n].name);
+      if (!column || column->position == -1) {
+        break;
+      }
+      key.push_back(column->position);
+    }
+    KeyMatch match = matchKeyColumns(comparisons, key, false);
+    if (match.terms.size() > best.terms.size()) {
+      best_root = index.root_page;
+      best = std::move(match);
+    }
+  }
+  if (best.terms.size() < 2) {
+    return std::nullopt;
+  }
+
+  LOG_INFO("Seeking composite index on " << best.range.equal.size()
+                                         << " equal columns");
+  IndexedRowids result{{}, true};
+  btree.scanIndex(best_root, best.range, result.rowids);
+  for (size_t i : best.terms) {
+    used[i] = true;
+  }
+  return result;
+}
+
+// Rowids of the rows satisfying `term`, gathered from index seeks alone, or
+// nullopt when it cannot be answered that way. OR unions its branches and
+// needs all of them answered; AND intersects whichever of its terms are,
+// seeking a composite index once for the terms it covers.
+std::optional<IndexedRowids> indexedRowids(const BTree &btree,
+                                           AdaptiveIndexes *adaptive,
+                                           const std::string &table_name,
+                                           const SchemaRecord &schema,
+                                           const Expr &term,
+                                           const ColumnResolver &resolve) {
+  switch (term.kind) {
+  case ExprKind::Or: {
+    IndexedRowids result{{}, true};
+    for (const auto &operand : term.operands) {
+      auto branch =
+          indexedRowids(btree, adaptive, table_name, schema, *operand,
+                        resolve);
+      if (!branch) {
+        return std::nullopt;
+      }
+      result.rowids |= branch->rowids;
+      result.exact = result.exact && branch->exact;
+    }
+    return result;
+  }
+  case ExprKind::And: {
+    // Nested ANDs, such as BETWEEN's, are flattened so that one composite
+    // seek can answer terms from any of them
+    std::vector<ExprPtr> operands;
+    for (const auto &operand : term.operands) {
+      auto nested = splitConjuncts(operand);
+      operands.insert(operands.end(), nested.begin(), nested.end());
+    }
+    std::vector<bool> used(operands.size());
+    std::optional<IndexedRowids> result = seekCompositeIndex(
+        btree, table_name, schema, operands, resolve, used);
+    bool covered = true;
+    for (size_t i = 0; i < operands.size(); ++i) {
+      if (used[i]) {
+        continue;
+      }
+      const Expr &operand = *operands[i];
+      auto part = indexedRowids(btree, adaptive, table_name, schema, operand,
+                                resolve);
+      if (!part) {
+        covered = false;
+      } else if (!result) {
+        result = std::move(part);
+      } else {
+        result->rowids &= part->rowids;
+        result->exact = result->exact && part->exact;
+      }
+    }
+    if (result) {
+      result->exact = result->exact && covered;
+    }
+    return result;
+  }
+  default:
+    return lookupEqualities(btree, adaptive, table_name, schema, term,
+                            resolve);
+  }
+}
+
+// The table's zone map, if it has one, bounded by the terms it can rule
+// subtrees out with: comparisons, IN lists and IS [NOT] NULL on its columns.
+// Zones hold BINARY extremes, which bound no other collation's comparisons.
+std::optional<ZoneScan> zoneScan(ZoneMaps &maps, const SchemaRecord &schema,
+                                 const std::vector<ExprPtr> &terms,
+                                 const ColumnResolver &resolve) {
+  ZoneMap *map = maps.find(static_cast<uint32_t>(schema.getRootPage()));
+  if (map == nullptr) {
+    return std::nullopt;
+  }
+  auto slotOf = [map](const ResolvedColumn &column) -> std::optional<size_t> {
+    const auto &columns = map->columns();
+    auto it = std::find(columns.begin(), columns.end(), column.position);
+    if (column.position == -1 || it == columns.end()) {
+      return std::nullopt;
+    }
+    return static_cast<size_t>(it - columns.begin());
+  };
+
+  ZoneScan zones{map, {}};
+  for (const auto &term : terms) {
+    ZoneBound bound;
+    if (auto comparison = asColumnComparison(*term, resolve)) {
+      auto slot = slotOf(comparison->column);
+      if (!slot || comparison->column.collation != Collation::Binary) {
+        continue;
+      }
+      bound.slot = *slot;
+      switch (comparison->op) {
+      case ExprOp::Eq:
+        bound.lower = comparison->constant;
+        bound.upper = std::move(comparison->constant);
+        break;
+      case ExprOp::Lt:
+      case ExprOp::Le:
+        bound.upper = std::move(comparison->constant);
+        bound.upper_inclusive = comparison->op == ExprOp::Le;
+        break;
+      case ExprOp::Gt:
+      case ExprOp::Ge:
+        bound.lower = std::move(comparison->constant);
+        bound.lower_inclusive = comparison->op == ExprOp::Ge;
+        break;
+      default:
+        continue;
+      }
+    } else if (auto equalities = asEqualityKeys(*term, resolve)) {
+      // An IN list's keys come sorted, so its extremes bound it
+      auto slot = slotOf(equalities->column);
+      if (!slot || equalities->keys.empty() ||
+          equalities->column.collation != Collation::Binary) {
+        continue;
+      }
+      bound.slot = *slot;
+      bound.lower = equalities->keys.front();
+      bound.upper = equalities->keys.back();
+    } else if (term->kind == ExprKind::IsNull &&
+               term->operands[0]->kind == ExprKind::Column) {
+      auto slot = slotOf(resolve(term->operands[0]->column));
+      if (!slot) {
+        continue;
+      }
+      bound.slot = *slot;
+      bound.is_null = !term->negated;
+    } else {
+      continue;
+    }
+    zones.bounds.push_back(std::move(bound));
+  }
+  return zones;
+}
+
+// Whether a WHERE term over the right side of a LEFT JOIN is never TRUE for
+// the NULL-extended rows, so that pushing it down cannot change the result.
+bool rejectsNulls(const Expr &term) {
+  switch (term.kind) {
+  case ExprKind::Compare:
+  case ExprKind::InList:
+  case ExprKind::Like:
+  case ExprKind::Column:
+  case ExprKind::Arithmetic:
+  case ExprKind::Negate:
+    return true;
+  case ExprKind::IsNull:
+    return term.negated;
+  case ExprKind::And:
+    return std::any_of(term.operands.begin(), term.operands.end(),
+                       [](const ExprPtr &operand) {
+                         return rejectsNulls(*operand);
+                       });
+  case ExprKind::Or:
+    return std::all_of(term.operands.begin(), term.operands.end(),
+                       [](const ExprPtr &operand) {
+                         return rejectsNulls(*operand);
+                       });
+  case ExprKind::Not: {
+    ExprKind inner = term.operands[0]->kind;
+    return inner == ExprKind::Compare || inner == ExprKind::InList ||
+           inner == ExprKind::Like;
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
 QueryResult Database::executeSelect(const SelectStatement &stmt) const {
-  if (stmt.is_count_star) {
-    return executeCountStar(stmt.table_name);
+  TraceSpan span("query");
+  PhaseTimer timer(QueryPhase::Execute);
+  // Cached results are checked against the data version this takes in
+  auto read = _reader.beginRead();
+  std::string cache_key;
+  if (_result_cache.enabled()) {
+    cache_key = ResultCache::keyOf(stmt);
+    if (const QueryResult *cached = _result_cache.find(cache_key)) {
+      countStat(&QueryStats::result_cache_hits);
+      countStat(&QueryStats::rows_output, cached->size());
+      return *cached;
+    }
   }
-  return stmt.where_clause ? executeSelectWithWhere(stmt)
-                           : executeSelectWithoutWhere(stmt);
+
+  auto start = std::chrono::steady_clock::now();
+  _bloom_filters.refresh();
+  QueryResult results = runSelect(stmt, nullptr, nullptr);
+  if (_result_cache.enabled()) {
+    _result_cache.insert(std::move(cache_key), results,
+                         std::chrono::steady_clock::now() - start);
+  }
+  countStat(&QueryStats::rows_output, results.size());
+  return results;
+}
+
+QueryResult Database::executeSelect(const SelectStatement &stmt,
+                                    QueryStats &stats) const {
+  StatsScope scope(stats);
+  return executeSelect(stmt);
+}
+
+PagedResult Database::executePage(const SelectStatement &stmt,
+                                  const std::string &resume_token) const {
+  std::optional<ResumePosition> resume_after;
+  if (!resume_token.empty()) {
+    resume_after = decodeResumeToken(resume_token);
+  }
+
+  TraceSpan span("query_page");
+  PhaseTimer timer(QueryPhase::Execute);
+  auto read = _reader.beginRead();
+  _bloom_filters.refresh();
+  PagedResult page;
+  ResumePosition last_emitted;
+  page.rows = runSelect(stmt, resume_after ? &*resume_after : nullptr,
+                        &last_emitted);
+  countStat(&QueryStats::rows_output, page.rows.size());
+  if (!stmt.is_count_star && stmt.aggregates.empty() && stmt.limit &&
+      *stmt.limit > 0 && page.rows.size() == *stmt.limit) {
+    page.next_token = encodeResumeToken(last_emitted);
+  }
+  return page;
+}
+
+void Database::setZoneMapColumns(const std::string &table_name,
+                                 const std::vector<std::string> &columns) {
+  auto read = _reader.beginRead();
+  SchemaRecord schema = _table_manager.getTableSchema(table_name);
+  if (schema.isWithoutRowid()) {
+    throw std::runtime_error(
+        "Zone maps are not supported for WITHOUT ROWID tables");
+  }
+  std::vector<int> positions;
+  for (const auto &name : columns) {
+    auto column = schema.resolveColumn(name);
+    if (!column) {
+      throw std::runtime_error("Unknown column: " + name);
+    }
+    // Interior keys already bound the rowid
+    if (column->position == -1) {
+      throw std::runtime_error("Zone maps do not cover the rowid: " + name);
+    }
+    positions.push_back(column->position);
+  }
+  _zone_maps.define(static_cast<uint32_t>(schema.getRootPage()),
+                    std::move(positions));
+}
+
+size_t Database::buildZoneMap(const std::string &table_name,
+                              const std::vector<std::string> &columns) {
+  auto read = _reader.beginRead();
+  setZoneMapColumns(table_name, columns);
+  uint32_t root_page = _table_manager.getTableRootPage(table_name);
+  ZoneScan zones{_zone_maps.find(root_page), {}};
+  ScanOptions options;
+  options.zones = &zones;
+  _btree.traverse(root_page, {}, nullptr, [](Row &&) { return true; },
+                  options);
+  _zone_maps.save();
+  return zones.map->pageCount();
+}
+
+const BloomFilter &Database::buildBloomFilter(const std::string &table_name,
+                                              const std::string &index_name,
+                                              size_t memory_bytes) {
+  auto read = _reader.beginRead();
+  SchemaRecord schema = _table_manager.getTableSchema(table_name);
+  auto root_page = static_cast<uint32_t>(schema.getRootPage());
+  // WITHOUT ROWID tables are index trees keyed by their primary key
+  bool keyed = schema.isWithoutRowid();
+  if (keyed && !index_name.empty()) {
+    // Seeks do not use their other indexes
+    throw std::runtime_error(
+        "Bloom filters on WITHOUT ROWID tables cover the primary key only");
+  }
+  if (!index_name.empty()) {
+    auto indexes = _btree.getIndexes(table_name);
+    auto it = std::find_if(indexes.begin(), indexes.end(),
+                           [&](const TableIndex &index) {
+                             return equalsIgnoreCase(
+                                 index.definition.index_name, index_name);
+                           });
+    if (it == indexes.end()) {
+      throw std::runtime_error("Unknown index: " + index_name);
+    }
+    root_page = it->root_page;
+    keyed = true;
+  }
+
+  TraceSpan span("bloom_build", root_page);
+  uint64_t keys = keyed ? _btree.countIndexEntries(root_page)
+                        : _btree.countSubtreeRows(root_page);
+  BloomFilter filter(memory_bytes ? memory_bytes
+                                  : keys * DEFAULT_BLOOM_BITS_PER_KEY / 8,
+                     keys);
+  if (keyed) {
+    _btree.walkIndexInOrder(
+        root_page, false,
+        [&](uint64_t, const std::vector<RecordValue> &entry) {
+          if (!entry.empty()) {
+            filter.add(BloomFilter::hashKey(entry[0]));
+          }
+          return true;
+        });
+  } else {
+    _btree.traverse(root_page, {-1}, nullptr, [&](Row &&row) {
+      filter.add(BloomFilter::hashRowid(
+          static_cast<uint64_t>(std::get<int64_t>(row[0]))));
+      return true;
+    });
+  }
+  const BloomFilter &added = _bloom_filters.add(root_page, std::move(filter));
+  _bloom_filters.save();
+  LOG_INFO("Built a Bloom filter on the tree at page "
+           << root_page << ": " << added.keyCount() << " keys, "
+           << added.memoryBytes() << " bytes");
+  return added;
 }
 
 QueryResult Database::executeCountStar(const std::string &table_name) const {
-  QueryResult results;
-  Row count_row;
-  count_row.push_back(
-      static_cast<int64_t>(_table_manager.getTableRowCount(table_name)));
-  results.push_back(count_row);
-  return results;
+  uint32_t root_page = _table_manager.getTableRootPage(table_name);
+  return {{static_cast<int64_t>(_btree.countSubtreeRows(root_page))}};
+}
+
+bool Database::executeExists(const SelectStatement &stmt) const {
+  if (stmt.join) {
+    throw std::runtime_error("Existence checks are not supported for joins");
+  }
+  auto read = _reader.beginRead();
+  _bloom_filters.refresh();
+  SchemaRecord schema = _table_manager.getTableSchema(stmt.table_name);
+  uint32_t root_page = _table_manager.getTableRootPage(stmt.table_name);
+  return countRows(stmt, schema, root_page, 1) > 0;
+}
+
+uint64_t Database::countRows(const SelectStatement &stmt,
+                             const SchemaRecord &schema, uint32_t root_page,
+                             uint64_t limit) const {
+  if (!stmt.where_clause) {
+    return _btree.countSubtreeRows(root_page);
+  }
+  if (schema.isWithoutRowid()) {
+    uint64_t count = 0;
+    scanClustered(stmt, schema, root_page, {},
+                  [&count, limit](Row &&) { return ++count < limit; });
+    return count;
+  }
+
+  // A lone equality or IN list on an indexed column is counted in the index
+  std::optional<PhaseTimer> planning(std::in_place, QueryPhase::Plan);
+  ColumnResolver resolve = tableResolver(stmt, schema);
+  auto equalities = asEqualityKeys(*stmt.where_clause, resolve);
+  if (equalities && equalities->column.position != -1) {
+    const std::string &name =
+        schema.getColumns()[equalities->column.position].name;
+    if (auto index_root_page =
+            findIndexRootPage(_btree, stmt.table_name, name)) {
+      uint64_t count = 0;
+      for (const auto &key : equalities->keys) {
+        count += _btree.countIndexKey(*index_root_page, key, limit - count);
+        if (count >= limit) {
+          break;
+        }
+      }
+      return count;
+    }
+  }
+
+  ScanOptions options;
+  std::vector<ExprPtr> terms = splitConjuncts(stmt.where_clause);
+  if (!narrowRowidRange(terms, resolve, options.range) ||
+      !rowidRangeMayMatch(_btree, root_page, options.range)) {
+    return 0;
+  }
+
+  // Bitmaps that answer the predicate exactly are counted without the table
+  std::optional<IndexedRowids> indexed;
+  if (options.range.min != options.range.max) {
+    indexed = indexedRowids(_btree, &_adaptive_indexes, stmt.table_name,
+                            schema, *stmt.where_clause, resolve);
+  }
+  if (indexed && indexed->exact) {
+    return indexed->rowids.cardinality();
+  }
+  if (indexed) {
+    options.rowids = &indexed->rowids;
+  }
+
+  std::optional<ZoneScan> zones;
+  if (!indexed) {
+    zones = zoneScan(_zone_maps, schema, terms, resolve);
+    options.zones = zones ? &*zones : nullptr;
+  }
+
+  CompiledPredicate filter(*stmt.where_clause, resolve);
+  planning.reset();
+  uint64_t count = 0;
+  _btree.traverse(root_page, {}, &filter,
+                  [&count, limit](Row &&) { return ++count < limit; },
+                  options);
+  return count;
 }
 
-QueryResult Database::executeSelectWithoutWhere(const SelectStatement &stmt) const {
+QueryResult Database::executeMinMax(const SelectStatement &stmt) const {
+  if (stmt.limit == 0 || stmt.offset.value_or(0) > 0) {
+    return {};
+  }
   SchemaRecord schema = _table_manager.getTableSchema(stmt.table_name);
   uint32_t root_page = _table_manager.getTableRootPage(stmt.table_name);
+  ColumnResolver resolve = tableResolver(stmt, schema);
+
+  // Unfiltered rowid and indexed-column aggregates take one B-tree descent;
+  // the rest share a single scan, comparing under each column's collation
+  Row row(stmt.aggregates.size());
+  std::vector<size_t> scanned;
+  std::vector<int> scan_positions;
+  std::vector<Collation> scan_collations;
+  std::vector<Affinity> scan_affinities;
+  for (size_t i = 0; i < stmt.aggregates.size(); ++i) {
+    const AggregateTerm &aggregate = stmt.aggregates[i];
+    const bool max = aggregate.function == AggregateFunction::Max;
+    ResolvedColumn column = resolve(aggregate.column);
+
+    if (column.position == -1 && !stmt.where_clause) {
+      if (auto rowid = _btree.findRowidExtreme(root_page, max)) {
+        row[i] = static_cast<int64_t>(*rowid);
+      }
+      continue;
+    }
+    // With a filter, the first match in rowid order is the answer
+    if (column.position == -1) {
+      ScanOptions options;
+      options.reverse = max;
+      scanRows(stmt, schema, root_page, {-1},
+               [&row, i](Row &&match) {
+                 row[i] = std::move(match.front());
+                 return false;
+               },
+               options);
+      continue;
+    }
+    // The leading key column of a WITHOUT ROWID table is the one its
+    // entries sort by, and is never NULL
+    const auto &key = schema.getSeekableKey();
+    if (!stmt.where_clause && schema.isWithoutRowid() && !key.empty() &&
+        column.position == key.front()) {
+      if (auto entry = _btree.findIndexExtreme(root_page, max)) {
+        row[i] = std::move(entry->front());
+        applyReadAffinity(column.affinity, row[i]);
+      }
+      continue;
+    }
+    if (!stmt.where_clause) {
+      const std::string &name = schema.getColumns()[column.position].name;
+      if (auto index_root_page =
+              findIndexRootPage(_btree, stmt.table_name, name)) {
+        LOG_INFO("Reading " << (max ? "MAX" : "MIN") << "(" << name
+                            << ") from its index");
+        if (auto entry = _btree.findIndexExtreme(*index_root_page, max)) {
+          row[i] = std::move(entry->front());
+          applyReadAffinity(column.affinity, row[i]);
+        }
+        continue;
+      }
+    }
+    scanned.push_back(i);
+    scan_positions.push_back(column.position);
+    scan_collations.push_back(column.collation);
+    scan_affinities.push_back(column.affinity);
+  }
+
+  if (!scanned.empty()) {
+    scanRows(stmt, schema, root_page, scan_positions, [&](Row &&values) {
+      for (size_t n = 0; n < scanned.size(); ++n) {
+        RecordValue &best = row[scanned[n]];
+        RecordValue &value = values[n];
+        if (std::holds_alternative<std::monostate>(value)) {
+          continue;
+        }
+        int cmp = compareRecordValues(value, best, scan_collations[n]);
+        if (std::holds_alternative<std::monostate>(best) ||
+            (stmt.aggregates[scanned[n]].function == AggregateFunction::Max
+                 ? cmp > 0
+                 : cmp < 0)) {
+          best = std::move(value);
+          applyReadAffinity(scan_affinities[n], best);
+        }
+      }
+      return true;
+    });
+  }
+  return {row};
+}
+
+QueryResult Database::runSelect(const SelectStatement &stmt,
+                                const ResumePosition *resume_after,
+                                ResumePosition *last_emitted) const {
+  if (stmt.join) {
+    if (resume_after || last_emitted) {
+      throw std::runtime_error("Keyset pagination is not supported for joins");
+    }
+    if (!stmt.aggregates.empty()) {
+      throw std::runtime_error("MIN/MAX is not supported for joins");
+    }
+    return executeJoin(stmt);
+  }
+  if (!stmt.aggregates.empty()) {
+    return executeMinMax(stmt);
+  }
+  if (stmt.is_count_star && !stmt.where_clause) {
+    return executeCountStar(stmt.table_name);
+  }
+
+  SchemaRecord schema = _table_manager.getTableSchema(stmt.table_name);
+  uint32_t root_page = _table_manager.getTableRootPage(stmt.table_name);
+
+  if (stmt.is_count_star) {
+    return {{static_cast<int64_t>(countRows(stmt, schema, root_page))}};
+  }
+
   std::vector<int> column_positions =
       schema.mapColumnPositions(stmt.column_names);
+  const size_t output_width = column_positions.size();
+  const uint64_t limit = stmt.limit.value_or(UINT64_MAX);
+  const uint64_t offset = stmt.offset.value_or(0);
 
   QueryResult results;
-  _btree.traverse(root_page, column_positions, -1, WhereClause(), results);
+  if (limit == 0) {
+    return results;
+  }
+
+  std::vector<Affinity> affinities;
+  for (const auto &name : stmt.column_names) {
+    if (auto column = schema.resolveColumn(name)) {
+      affinities.push_back(column->affinity);
+    }
+  }
+  sqlite::RowSink collect =
+      collectInto(results, std::move(affinities), limit);
+
+  // WITHOUT ROWID tables come out of their B-tree in primary key order
+  const std::vector<int> &key = schema.getSeekableKey();
+  if (schema.isWithoutRowid() &&
+      (stmt.order_by.empty() ||
+       (stmt.order_by.size() == 1 && !key.empty() &&
+        schema.mapColumnPositions({stmt.order_by[0].column}) ==
+            std::vector<int>{key.front()}))) {
+    if (resume_after) {
+      throw std::runtime_error(
+          "Keyset pagination is not supported for WITHOUT ROWID tables");
+    }
+    uint64_t skip = offset;
+    scanClustered(stmt, schema, root_page, column_positions,
+                  [&](Row &&row) {
+                    if (skip > 0) {
+                      --skip;
+                      return true;
+                    }
+                    return collect(std::move(row));
+                  },
+                  !stmt.order_by.empty() && stmt.order_by[0].descending);
+    return results;
+  }
+
+  if (isRowidOrdered(stmt, schema)) {
+    ScanOptions options;
+    options.reverse = !stmt.order_by.empty() && stmt.order_by[0].descending;
+    options.offset = offset;
+
+    if (resume_after) {
+      if (resume_after->isIndexPosition()) {
+        throw std::runtime_error("Resume token does not match query order");
+      }
+      uint64_t last_rowid = resume_after->rowid;
+      if (options.reverse ? last_rowid == 0 : last_rowid == UINT64_MAX) {
+        return results;
+      }
+      if (options.reverse) {
+        options.range.max = last_rowid - 1;
+      } else {
+        options.range.min = last_rowid + 1;
+      }
+    }
+
+    std::vector<int> scan_positions = column_positions;
+    if (last_emitted) {
+      scan_positions.push_back(-1);
+    }
+    scanRows(stmt, schema, root_page, scan_positions,
+             [&](Row &&row) {
+               if (last_emitted) {
+                 last_emitted->rowid =
+                     static_cast<uint64_t>(std::get<int64_t>(row.back()));
+               }
+               return collect(std::move(row));
+             },
+             options);
+    return results;
+  }
+
+  if (scanInIndexOrder(stmt, root_page, column_positions, offset, collect,
+                       resume_after, last_emitted)) {
+    return results;
+  }
+
+  if (resume_after || last_emitted) {
+    throw std::runtime_error(
+        "Keyset pagination requires ordering by rowid or an indexed column");
+  }
+
+  // Sort keys are appended after the projected columns and dropped on output
+  std::vector<int> scan_positions = column_positions;
+  std::vector<Collation> collations;
+  for (const auto &term : stmt.order_by) {
+    auto column = schema.resolveColumn(term.column);
+    if (!column) {
+      throw std::runtime_error("Unknown ORDER BY column: " + term.column);
+    }
+    scan_positions.push_back(column->position);
+    collations.push_back(column->collation);
+  }
+  sortRows(
+      stmt, output_width, collations,
+      [&](const sqlite::RowSink &sink) {
+        scanRows(stmt, schema, root_page, scan_positions, sink);
+      },
+      offset, collect);
   return results;
 }
 
-QueryResult Database::executeSelectWithWhere(const SelectStatement &stmt) const {
+QueryResult Database::executeJoin(const SelectStatement &stmt) const {
+  const JoinClause &join = *stmt.join;
+  JoinType type = join.type;
+  const SchemaRecord schemas[2] = {
+      _table_manager.getTableSchema(stmt.table_name),
+      _table_manager.getTableSchema(join.table_name)};
+  const std::string *table_names[2][2] = {{&stmt.table_name, &stmt.table_alias},
+                                          {&join.table_name, &join.alias}};
+
+  // The table a (possibly qualified) column name belongs to
+  auto sideOf = [&](const std::string &name) {
+    auto [qualifier, column] = splitQualifiedName(name);
+    std::optional<size_t> found;
+    for (size_t side = 0; side < 2; ++side) {
+      if (!qualifier.empty() && qualifier != *table_names[side][0] &&
+          qualifier != *table_names[side][1]) {
+        continue;
+      }
+      if (schemas[side].resolveColumn(column)) {
+        if (found) {
+          throw std::runtime_error("Ambiguous column name: " + name);
+        }
+        found = side;
+      }
+    }
+    if (!found) {
+      throw std::runtime_error("Unknown column: " + name);
+    }
+    return *found;
+  };
+
+  // Each AND term of WHERE that reads a single table is pushed down into that
+  // table's scan; the others are evaluated on joined rows. Under a LEFT JOIN
+  // a right-side term is only pushed down when it rejects the NULL-extended
+  // rows, which turns the join into an inner one.
+  std::vector<ExprPtr> pushed[2];
+  std::vector<ExprPtr> residual;
+  for (const auto &term : splitConjuncts(stmt.where_clause)) {
+    std::vector<std::string> names;
+    collectColumns(*term, names);
+    unsigned sides = 0;
+    for (const auto &name : names) {
+      sides |= 1u << sideOf(name);
+    }
+
+    if (sides <= 1) {
+      pushed[0].push_back(term);
+    } else if (sides == 2 &&
+               (join.type == JoinType::Inner || rejectsNulls(*term))) {
+      pushed[1].push_back(term);
+      type = JoinType::Inner;
+    } else {
+      residual.push_back(term);
+    }
+  }
+
+  JoinExecutor executor(
+      _btree, type,
+      makeJoinInput(stmt.table_name, stmt.table_alias,
+                    joinConjuncts(pushed[0])),
+      makeJoinInput(join.table_name, join.alias, joinConjuncts(pushed[1])),
+      join.left_column, join.right_column);
+
+  // Output columns, then ORDER BY keys, then the columns the residual
+  // filter reads; everything past the output is dropped by collectInto.
+  std::vector<std::string> columns;
+  if (!stmt.is_count_star) {
+    columns = stmt.column_names;
+    for (const auto &term : stmt.order_by) {
+      columns.push_back(term.column);
+    }
+  }
+
+  std::optional<CompiledPredicate> residual_filter;
+  if (ExprPtr residual_expr = joinConjuncts(residual)) {
+    const size_t first = columns.size();
+    collectColumns(*residual_expr, columns);
+    residual_filter.emplace(*residual_expr, [&](const std::string &name) {
+      auto it = std::find(columns.begin() + first, columns.end(), name);
+      size_t side = sideOf(name);
+      auto column =
+          schemas[side].resolveColumn(splitQualifiedName(name).second);
+      return ResolvedColumn{static_cast<int>(it - columns.begin()),
+                            column->affinity, column->collation};
+    });
+    LOG_INFO("Filtering joined rows by " << toString(*residual_expr));
+  }
+
+  auto produce = [&](const sqlite::RowSink &sink) {
+    if (!residual_filter) {
+      executor.execute(columns, sink);
+      return;
+    }
+    executor.execute(columns, [&](Row &&row) {
+      return !residual_filter->matches(row) || sink(std::move(row));
+    });
+  };
+
+  QueryResult results;
+  if (stmt.is_count_star) {
+    int64_t count = 0;
+    produce([&count](Row &&) {
+      ++count;
+      return true;
+    });
+    results.push_back({count});
+    return results;
+  }
+
+  const uint64_t limit = stmt.limit.value_or(UINT64_MAX);
+  if (limit == 0) {
+    return results;
+  }
+
+  std::vector<Affinity> affinities;
+  for (const auto &column : resolveColumns(stmt, stmt.column_names)) {
+    affinities.push_back(column.affinity);
+  }
+  sqlite::RowSink collect = collectInto(results, std::move(affinities), limit);
+
+  uint64_t skip = stmt.offset.value_or(0);
+  if (!stmt.order_by.empty()) {
+    std::vector<std::string> keys;
+    for (const auto &term : stmt.order_by) {
+      keys.push_back(term.column);
+    }
+    sortRows(stmt, stmt.column_names.size(), collationsOf(stmt, keys), produce,
+             skip, collect);
+    return results;
+  }
+
+  produce([&](Row &&row) {
+    if (skip > 0) {
+      --skip;
+      return true;
+    }
+    return collect(std::move(row));
+  });
+  return results;
+}
+
+JoinInput Database::makeJoinInput(const std::string &table_name,
+                                  const std::string &alias,
+                                  const ExprPtr &where) const {
+  SelectStatement side;
+  side.table_name = table_name;
+  side.table_alias = alias;
+  side.where_clause = where;
+
+  JoinInput input{table_name,
+                  alias,
+                  _table_manager.getTableSchema(table_name),
+                  _table_manager.getTableRootPage(table_name),
+                  {},
+                  0,
+                  where != nullptr,
+                  {}};
+  input.tree = _btree.estimateTree(input.root_page);
+  input.estimated_rows =
+      input.filtered
+          ? std::max<uint64_t>(1, input.tree.rows / FILTER_SELECTIVITY)
+          : input.tree.rows;
+  input.scan = [this, side = std::move(side), schema = input.schema,
+                root_page = input.root_page](
+                   const std::vector<int> &positions,
+                   const sqlite::RowSink &sink) {
+    scanRows(side, schema, root_page, positions, sink);
+  };
+  return input;
+}
+
+bool Database::isRowidOrdered(const SelectStatement &stmt,
+                              const SchemaRecord &schema) const {
+  if (schema.isWithoutRowid()) {
+    return false;
+  }
+  if (stmt.order_by.empty()) {
+    return true;
+  }
+  if (stmt.order_by.size() != 1) {
+    return false;
+  }
+  std::vector<int> key_position =
+      schema.mapColumnPositions({stmt.order_by[0].column});
+  return !key_position.empty() && key_position.front() == -1;
+}
+
+std::vector<Collation>
+Database::collationsOf(const SelectStatement &stmt,
+                       const std::vector<std::string> &columns) const {
+  std::vector<Collation> collations;
+  for (const auto &column : resolveColumns(stmt, columns)) {
+    collations.push_back(column.collation);
+  }
+  return collations;
+}
+
+std::vector<ResolvedColumn>
+Database::resolveColumns(const SelectStatement &stmt,
+                         const std::vector<std::string> &columns) const {
+  std::vector<std::pair<const std::string *, const std::string *>> tables{
+      {&stmt.table_name, &stmt.table_alias}};
+  if (stmt.join) {
+    tables.emplace_back(&stmt.join->table_name, &stmt.join->alias);
+  }
+  std::vector<SchemaRecord> schemas;
+  for (const auto &table : tables) {
+    schemas.push_back(_table_manager.getTableSchema(*table.first));
+  }
+
+  std::vector<ResolvedColumn> resolved;
+  for (const auto &name : columns) {
+    auto [qualifier, column] = splitQualifiedName(name);
+    ResolvedColumn found{-1, Affinity::None, Collation::Binary};
+    for (size_t side = 0; side < tables.size(); ++side) {
+      if (!qualifier.empty() && qualifier != *tables[side].first &&
+          qualifier != *tables[side].second) {
+        continue;
+      }
+      if (auto match = schemas[side].resolveColumn(column)) {
+        found = *match;
+        break;
+      }
+    }
+    resolved.push_back(found);
+  }
+  return resolved;
+}
+
+void Database::sortRows(const SelectStatement &stmt, size_t key_column,
+                        const std::vector<Collation> &collations,
+                        const RowProducer &produce, uint64_t offset,
+                        const sqlite::RowSink &sink) const {
+  std::vector<SortKey> keys;
+  for (const auto &term : stmt.order_by) {
+    keys.push_back({key_column + keys.size(), term.descending,
+                    collations.at(keys.size())});
+  }
+  RowComparator comparator(std::move(keys));
+
+  uint64_t skip = offset;
+  sqlite::RowSink emit = [&](Row &&row) {
+    if (skip > 0) {
+      --skip;
+      return true;
+    }
+    return sink(std::move(row));
+  };
+
+  if (stmt.limit) {
+    uint64_t keep = *stmt.limit > UINT64_MAX - offset ? UINT64_MAX
+                                                      : *stmt.limit + offset;
+    TopKSorter sorter(std::move(comparator), keep);
+    produce([&sorter](Row &&row) {
+      sorter.add(std::move(row));
+      return true;
+    });
+    sorter.finish(emit);
+  } else {
+    ExternalSorter sorter(std::move(comparator), _sort_memory_budget);
+    produce([&sorter](Row &&row) {
+      sorter.add(std::move(row));
+      return true;
+    });
+    sorter.finish(emit);
+  }
+}
+
+bool Database::scanInIndexOrder(const SelectStatement &stmt,
+                                uint32_t root_page,
+                                const std::vector<int> &column_positions,
+                                uint64_t offset, const sqlite::RowSink &sink,
+                                const ResumePosition *resume_after,
+                                ResumePosition *last_emitted) const {
+  if (stmt.order_by.size() != 1 || stmt.where_clause) {
+    return false;
+  }
+
+  const OrderByTerm &term = stmt.order_by.front();
+  int64_t index_root_page = 0;
   try {
-    uint32_t index_root_page =
-        _btree.getIndexRootPage(stmt.table_name, stmt.where_clause->column);
-    std::string search_value = stmt.where_clause->value;
-    if (search_value.front() == '\'' && search_value.back() == '\'') {
-      search_value = search_value.substr(1, search_value.length() - 2);
-    }
-
-    std::vector<uint64_t> rowids =
-        _btree.scanIndex(index_root_page, search_value);
-    SchemaRecord schema = _table_manager.getTableSchema(stmt.table_name);
-    uint32_t root_page = _table_manager.getTableRootPage(stmt.table_name);
-    return _btree.fetchRowsByIds(rowids, stmt.column_names, schema, root_page);
+    index_root_page = _btree.getIndexRootPage(stmt.table_name, term.column);
   } catch (const std::runtime_error &) {
-    SchemaRecord schema = _table_manager.getTableSchema(stmt.table_name);
-    uint32_t root_page = _table_manager.getTableRootPage(stmt.table_name);
-    std::vector<int> column_positions =
-        schema.mapColumnPositions(stmt.column_names);
-    int where_col_pos =
-        schema.findWhereColumnPosition(stmt.where_clause->column);
-
-    QueryResult results;
-    _btree.traverse(root_page, column_positions, where_col_pos,
-                    *stmt.where_clause, results);
-    return results;
+    return false;
+  }
+
+  if (resume_after && !resume_after->isIndexPosition()) {
+    throw std::runtime_error("Resume token does not match query order");
+  }
+
+  LOG_INFO("ORDER BY " << term.column << " satisfied by index walk");
+  uint64_t skip = offset;
+  QueryResult fetched;
+  _btree.walkIndexInOrder(
+      static_cast<uint32_t>(index_root_page), term.descending,
+      [&](uint64_t rowid, const std::vector<RecordValue> &entry) {
+        // OFFSET is applied to index entries, before any row is fetched
+        if (skip > 0) {
+          --skip;
+          return true;
+        }
+        fetched.clear();
+        _btree.findRow(root_page, rowid, column_positions, fetched);
+        if (fetched.empty()) {
+          return true;
+        }
+        if (last_emitted) {
+          last_emitted->rowid = rowid;
+          last_emitted->index_entry = entry;
+        }
+        return sink(std::move(fetched.front()));
+      },
+      resume_after ? &resume_after->index_entry : nullptr);
+  return true;
+}
+
+void Database::scanRows(const SelectStatement &stmt, const SchemaRecord &schema,
+                        uint32_t root_page,
+                        const std::vector<int> &column_positions,
+                        const sqlite::RowSink &sink,
+                        const ScanOptions &options) const {
+  if (schema.isWithoutRowid()) {
+    scanClustered(stmt, schema, root_page, column_positions, sink,
+                  options.reverse);
+    return;
   }
+  if (!stmt.where_clause) {
+    _btree.traverse(root_page, column_positions, nullptr, sink, options);
+    return;
+  }
+
+  std::optional<PhaseTimer> planning(std::in_place, QueryPhase::Plan);
+  ColumnResolver resolve = tableResolver(stmt, schema);
+  CompiledPredicate filter(*stmt.where_clause, resolve);
+  std::vector<ExprPtr> terms = splitConjuncts(stmt.where_clause);
+
+  // Rowid comparisons bound the traversal
+  ScanOptions narrowed = options;
+  if (!narrowRowidRange(terms, resolve, narrowed.range) ||
+      !rowidRangeMayMatch(_btree, root_page, narrowed.range)) {
+    return;
+  }
+
+  // Equalities and IN lists on indexed columns yield rowid bitmaps, which are
+  // intersected across AND terms and united across OR branches. The table is
+  // then read in rowid order, descending only into subtrees that hold one of
+  // them; the predicate is re-checked unless the bitmap matches it exactly.
+  std::optional<IndexedRowids> indexed;
+  if (narrowed.range.min != narrowed.range.max) {
+    indexed = indexedRowids(_btree, &_adaptive_indexes, stmt.table_name,
+                            schema, *stmt.where_clause, resolve);
+  }
+  planning.reset();
+
+  if (!indexed) {
+    LOG_INFO("Scanning " << stmt.table_name << " with filter "
+                         << toString(*stmt.where_clause));
+    std::optional<ZoneScan> zones =
+        zoneScan(_zone_maps, schema, terms, resolve);
+    narrowed.zones = zones ? &*zones : nullptr;
+    _btree.traverse(root_page, column_positions, &filter, sink, narrowed);
+    return;
+  }
+
+  LOG_INFO("Fetching " << indexed->rowids.cardinality()
+                       << " rowids found through indexes ("
+                       << indexed->rowids.memoryBytes() << " bytes)");
+  narrowed.rowids = &indexed->rowids;
+  _btree.traverse(root_page, column_positions,
+                  indexed->exact ? nullptr : &filter, sink, narrowed);
 }
+
+void Database::scanClustered(const SelectStatement &stmt,
+                             const SchemaRecord &schema, uint32_t root_page,
+                             const std::vector<int> &column_positions,
+                             const sqlite::RowSink &sink, bool reverse) const {
+  const std::vector<int> &storage = schema.getStoragePositions();
+  if (!stmt.where_clause) {
+    _btree.traverseClustered(root_page, storage, column_positions, nullptr,
+                             sink, nullptr, reverse);
+    return;
+  }
+
+  std::optional<PhaseTimer> planning(std::in_place, QueryPhase::Plan);
+  ColumnResolver resolve = tableResolver(stmt, schema);
+  CompiledPredicate filter(*stmt.where_clause, resolve);
+
+  // Comparisons on the primary key bound one descent of the table itself;
+  // reverse walks cover the whole key, as seeks only run forwards
+  std::optional<KeyMatch> match;
+  if (!reverse) {
+    match = matchKeyColumns(
+        keyComparisons(splitConjuncts(stmt.where_clause), resolve),
+        schema.getSeekableKey(), true);
+  }
+  planning.reset();
+
+  if (match && !match->terms.empty()) {
+    LOG_INFO("Seeking " << stmt.table_name << " on its primary key");
+    _btree.traverseClustered(root_page, storage, column_positions, &filter,
+                             sink, &match->range);
+    return;
+  }
+  _btree.traverseClustered(root_page, storage, column_positions, &filter,
+                           sink, nullptr, reverse);
+}
+
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "adaptive_index.hpp"
 #include "btree.hpp"
 #include "file_reader.hpp"
+#include "join_executor.hpp"
+#include "query_stats.hpp"
+#include "result_cache.hpp"
+#include "resume_token.hpp"
+#include "sorter.hpp"
 #include "sqlite_constants.hpp"
 #include "table_manager.hpp"
 #include <memory>
@@ -10,6 +16,13 @@
 using SqliteHeader = sqlite::Header;
 using QueryResult = sqlite::QueryResult;
 
+struct PagedResult {
+  QueryResult rows;
+  // Opaque token that resumes right after the last row of this page; empty
+  // when fewer than LIMIT rows were left.
+  std::string next_token;
+};
+
 class Database {
 public:
   explicit Database(const std::string &filename);
@@ -24,14 +37,139 @@ public:
   std::vector<std::string> getTableNames() const;
   sqlite::QueryResult executeSelect(const SelectStatement &stmt) const;
 
+  // Runs the query while collecting its I/O, decoding and timing counters
+  // into `stats`.
+  sqlite::QueryResult executeSelect(const SelectStatement &stmt,
+                                    QueryStats &stats) const;
+
+  // Runs one page of a keyset-paginated query: LIMIT is the page size, and a
+  // token from the previous page seeks straight past its last row. The query
+  // must be ordered by rowid (the default) or by a single indexed column.
+  PagedResult executePage(const SelectStatement &stmt,
+                          const std::string &resume_token = {}) const;
+
+  // Whether any row of the table matches the statement's WHERE clause,
+  // answered from an index alone when one covers the predicate.
+  bool executeExists(const SelectStatement &stmt) const;
+
+  // Bytes of row data ORDER BY may buffer before spilling sorted runs to
+  // temporary files.
+  void setSortMemoryBudget(size_t bytes) noexcept {
+    _sort_memory_budget = bytes;
+  }
+
+  // Whether table scans read upcoming child pages on background threads
+  // while decoding the current one.
+  void setPrefetching(bool enabled) { _reader.setPrefetching(enabled); }
+
+  // Whether table scans hint the kernel to read upcoming leaves ahead, in
+  // sorted runs of page numbers. On by default.
+  void setReadahead(bool enabled) noexcept { _reader.setReadahead(enabled); }
+
+  // Memory for indexes built on columns that queries keep filtering on by
+  // equality without an index; zero turns them off.
+  void setAdaptiveIndexBudget(size_t bytes) {
+    _adaptive_indexes.setBudget(bytes);
+  }
+
+  // Equality or IN filters on an unindexed column before the next one builds
+  // an index of it in memory. Indexes last until the file or its
+  // write-ahead log changes.
+  void setAdaptiveIndexThreshold(uint32_t uses) noexcept {
+    _adaptive_indexes.setThreshold(uses);
+  }
+
+  // Memory for the results of executeSelect, served again to identical
+  // statements with identical literals until the file or its write-ahead
+  // log changes; zero, the default, turns the cache off.
+  void setResultCacheBudget(size_t bytes) { _result_cache.setBudget(bytes); }
+
+  // Keeps zones (min, max and NULL count) of the table's columns for every
+  // page, filled in as filtered scans read pages, so that later scans skip
+  // the subtrees a filter rules out.
+  void setZoneMapColumns(const std::string &table_name,
+                         const std::vector<std::string> &columns);
+
+  // Maps the columns and summarises every page of the table now, then saves
+  // all zone maps to `<database>-zonemap` for later processes. Returns the
+  // pages summarised.
+  size_t buildZoneMap(const std::string &table_name,
+                      const std::vector<std::string> &columns);
+
+  // Builds a Bloom filter over the leading column of the table's index
+  // `index_name`, or over its rowids (its primary key when WITHOUT ROWID)
+  // when that is empty, and saves all filters to `<database>-bloom`. Seeks
+  // and rowid lookups for keys it rules out return at once. It takes about
+  // `memory_bytes`, or DEFAULT_BLOOM_BITS_PER_KEY bits per key when zero.
+  const BloomFilter &buildBloomFilter(const std::string &table_name,
+                                      const std::string &index_name = {},
+                                      size_t memory_bytes = 0);
+
+  // The collation each of `columns`, named as in the statement and
+  // qualified or not, compares under; BINARY for names it does not know
+  std::vector<Collation>
+  collationsOf(const SelectStatement &stmt,
+               const std::vector<std::string> &columns) const;
+
+  // Decodes every table and index into memory, records included, so that
+  // queries read and decode no pages from then on. Call after readHeader;
+  // returns the memory the trees take.
+  const ResidentFootprint &loadResident() { return _btree.loadResident(); }
+
 private:
   FileReader _reader;
   SqliteHeader _header;
   TableManager _table_manager;
   BTree _btree;
+  size_t _sort_memory_budget{DEFAULT_SORT_MEMORY_BUDGET};
+  // Built lazily by const queries
+  mutable AdaptiveIndexes _adaptive_indexes{_reader, _btree};
+  mutable ZoneMaps _zone_maps{_reader};
+  mutable BloomFilters _bloom_filters{_reader};
+  mutable ResultCache _result_cache{_reader};
 
   sqlite::QueryResult executeCountStar(const std::string &table_name) const;
-  sqlite::QueryResult executeSelectWithoutWhere(const SelectStatement &stmt) const;
-  sqlite::QueryResult executeSelectWithWhere(const SelectStatement &stmt) const;
+  sqlite::QueryResult executeMinMax(const SelectStatement &stmt) const;
+  // Rows matching the WHERE clause, stopping once `limit` are found
+  uint64_t countRows(const SelectStatement &stmt, const SchemaRecord &schema,
+                     uint32_t root_page, uint64_t limit = UINT64_MAX) const;
+  sqlite::QueryResult runSelect(const SelectStatement &stmt,
+                                const ResumePosition *resume_after,
+                                ResumePosition *last_emitted) const;
+  bool isRowidOrdered(const SelectStatement &stmt,
+                      const SchemaRecord &schema) const;
+  sqlite::QueryResult executeJoin(const SelectStatement &stmt) const;
+  // Each of `columns`, named as in the statement and qualified or not;
+  // position -1 with no affinity and BINARY for names it does not know
+  std::vector<ResolvedColumn>
+  resolveColumns(const SelectStatement &stmt,
+                 const std::vector<std::string> &columns) const;
+  JoinInput makeJoinInput(const std::string &table_name,
+                          const std::string &alias,
+                          const ExprPtr &where) const;
+
+  // Feeds every row of `produce` through a top-K heap (with LIMIT) or the
+  // external sorter, ordering by the ORDER BY keys stored from `key_column`
+  // onwards, each compared under its column's entry of `collations`.
+  using RowProducer = std::function<void(const sqlite::RowSink &)>;
+  void sortRows(const SelectStatement &stmt, size_t key_column,
+                const std::vector<Collation> &collations,
+                const RowProducer &produce, uint64_t offset,
+                const sqlite::RowSink &sink) const;
+  bool scanInIndexOrder(const SelectStatement &stmt, uint32_t root_page,
+                        const std::vector<int> &column_positions,
+                        uint64_t offset, const sqlite::RowSink &sink,
+                        const ResumePosition *resume_after,
+                        ResumePosition *last_emitted) const;
+  void scanRows(const SelectStatement &stmt, const SchemaRecord &schema,
+                uint32_t root_page, const std::vector<int> &column_positions,
+                const sqlite::RowSink &sink,
+                const ScanOptions &options = {}) const;
+  // Scans a WITHOUT ROWID table in primary key order, seeking the key when
+  // the WHERE clause bounds it
+  void scanClustered(const SelectStatement &stmt, const SchemaRecord &schema,
+                     uint32_t root_page,
+                     const std::vector<int> &column_positions,
+                     const sqlite::RowSink &sink, bool reverse = false) const;
 };
 
@@ -0,0 +1,165 @@
+#include "expression.hpp"
+
+namespace {
+
+const char *opText(ExprOp op) noexcept {
+  switch (op) {
+  case ExprOp::Eq:
+    return "=";
+  case ExprOp::Ne:
+    return "!=";
+  case ExprOp::Lt:
+    return "<";
+  case ExprOp::Le:
+    return "<=";
+  case ExprOp::Gt:
+    return ">";
+  case ExprOp::Ge:
+    return ">=";
+  case ExprOp::Add:
+    return "+";
+  case ExprOp::Sub:
+    return "-";
+  case ExprOp::Mul:
+    return "*";
+  case ExprOp::Div:
+    return "/";
+  case ExprOp::Mod:
+    return "%";
+  default:
+    return "?";
+  }
+}
+
+std::string literalText(const RecordValue &value) {
+  if (std::holds_alternative<std::monostate>(value)) {
+    return "NULL";
+  }
+  if (const auto *text = std::get_if<std::string>(&value)) {
+    std::string quoted = "'";
+    for (char c : *text) {
+      quoted += c;
+      if (c == '\'') {
+        quoted += '\'';
+      }
+    }
+    return quoted + "'";
+  }
+  if (const auto *blob = std::get_if<std::vector<uint8_t>>(&value)) {
+    static constexpr char HEX[] = "0123456789ABCDEF";
+    std::string text = "X'";
+    for (uint8_t byte : *blob) {
+      text += HEX[byte >> 4];
+      text += HEX[byte & 0x0F];
+    }
+    return text + "'";
+  }
+  return recordValueToText(value);
+}
+
+} // namespace
+
+ExprPtr makeLiteral(RecordValue value) {
+  auto expr = std::make_shared<Expr>();
+  expr->kind = ExprKind::Literal;
+  expr->value = std::move(value);
+  return expr;
+}
+
+ExprPtr makeColumnRef(std::string name) {
+  auto expr = std::make_shared<Expr>();
+  expr->kind = ExprKind::Column;
+  expr->column = std::move(name);
+  return expr;
+}
+
+ExprPtr makeExpr(ExprKind kind, ExprOp op, std::vector<ExprPtr> operands,
+                 bool negated) {
+  auto expr = std::make_shared<Expr>();
+  expr->kind = kind;
+  expr->op = op;
+  expr->negated = negated;
+  expr->operands = std::move(operands);
+  return expr;
+}
+
+std::vector<ExprPtr> splitConjuncts(const ExprPtr &expr) {
+  std::vector<ExprPtr> terms;
+  if (!expr) {
+    return terms;
+  }
+  if (expr->kind != ExprKind::And) {
+    terms.push_back(expr);
+    return terms;
+  }
+  for (const auto &operand : expr->operands) {
+    auto nested = splitConjuncts(operand);
+    terms.insert(terms.end(), nested.begin(), nested.end());
+  }
+  return terms;
+}
+
+ExprPtr joinConjuncts(const std::vector<ExprPtr> &terms) {
+  if (terms.empty()) {
+    return nullptr;
+  }
+  if (terms.size() == 1) {
+    return terms.front();
+  }
+  return makeExpr(ExprKind::And, ExprOp::None, terms);
+}
+
+void collectColumns(const Expr &expr, std::vector<std::string> &names) {
+  if (expr.kind == ExprKind::Column) {
+    names.push_back(expr.column);
+    return;
+  }
+  for (const auto &operand : expr.operands) {
+    collectColumns(*operand, names);
+  }
+}
+
+std::string toString(const Expr &expr) {
+  auto operand = [&expr](size_t i) { return toString(*expr.operands[i]); };
+  const std::string not_text = expr.negated ? "NOT " : "";
+
+  switch (expr.kind) {
+  case ExprKind::Literal:
+    return literalText(expr.value);
+  case ExprKind::Column:
+    return expr.column;
+  case ExprKind::Negate:
+    return "(-" + operand(0) + ")";
+  case ExprKind::Arithmetic:
+  case ExprKind::Compare:
+    return "(" + operand(0) + " " + opText(expr.op) + " " + operand(1) + ")";
+  case ExprKind::And:
+  case ExprKind::Or: {
+    std::string text = "(";
+    for (size_t i = 0; i < expr.operands.size(); ++i) {
+      if (i > 0) {
+        text += expr.kind == ExprKind::And ? " AND " : " OR ";
+      }
+      text += operand(i);
+    }
+    return text + ")";
+  }
+  case ExprKind::Not:
+    return "(NOT " + operand(0) + ")";
+  case ExprKind::IsNull:
+    return "(" + operand(0) + " IS " + not_text + "NULL)";
+  case ExprKind::InList: {
+    std::string text = "(" + operand(0) + " " + not_text + "IN (";
+    for (size_t i = 1; i < expr.operands.size(); ++i) {
+      if (i > 1) {
+        text += ", ";
+      }
+      text += operand(i);
+    }
+    return text + "))";
+  }
+  case ExprKind::Like:
+    return "(" + operand(0) + " " + not_text + "LIKE " + operand(1) + ")";
+  }
+  return {};
+}
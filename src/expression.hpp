@@ -0,0 +1,54 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class ExprKind {
+  Literal,
+  Column,
+  Negate,     // unary minus
+  Arithmetic, // + - * / %
+  Compare,    // = != < <= > >=
+  And,
+  Or,
+  Not,
+  IsNull, // IS [NOT] NULL
+  InList, // [NOT] IN (...); operands[0] is the tested value
+  Like,   // [NOT] LIKE
+};
+
+enum class ExprOp { None, Eq, Ne, Lt, Le, Gt, Ge, Add, Sub, Mul, Div, Mod };
+
+struct Expr;
+using ExprPtr = std::shared_ptr<const Expr>;
+
+// A parsed WHERE expression node. Nodes are immutable and share their
+// operands, so AND terms can be split off and pushed down without copying.
+struct Expr {
+  ExprKind kind;
+  ExprOp op{ExprOp::None};
+  // IS NOT NULL, NOT IN and NOT LIKE
+  bool negated{false};
+  RecordValue value;  // Literal
+  std::string column; // Column, as written (possibly qualified)
+  std::vector<ExprPtr> operands;
+};
+
+ExprPtr makeLiteral(RecordValue value);
+ExprPtr makeColumnRef(std::string name);
+ExprPtr makeExpr(ExprKind kind, ExprOp op, std::vector<ExprPtr> operands,
+                 bool negated = false);
+
+// Splits a predicate into its top-level AND terms.
+std::vector<ExprPtr> splitConjuncts(const ExprPtr &expr);
+
+// ANDs `terms` back together; nullptr when there are none.
+ExprPtr joinConjuncts(const std::vector<ExprPtr> &terms);
+
+// Appends the name of every column `expr` references to `names`.
+void collectColumns(const Expr &expr, std::vector<std::string> &names);
+
+// Renders the expression as fully parenthesized SQL.
+std::string toString(const Expr &expr);
@@ -1,40 +1,105 @@
 #pragma once
+#include "page_prefetcher.hpp"
+#include "query_stats.hpp"
 #include "sqlite_constants.hpp"
+#include "wal_index.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
+// Reads `length` bytes at `offset` with pread(2), which may return fewer;
+// false on an error or at the end of the file
+inline bool readFully(int fd, uint8_t *buffer, size_t length, off_t offset) {
+  while (length > 0) {
+    ssize_t n = pread(fd, buffer, length, offset);
+    if (n <= 0) {
+      return false;
+    }
+    buffer += n;
+    length -= static_cast<size_t>(n);
+    offset += n;
+  }
+  return true;
+}
+
+// What identifies the database contents being read: the header's change
+// counter, the main file's modification time, and the write-ahead log's
+// salts and committed frames when pages come from one. In WAL mode commits
+// leave the change counter alone, so once a checkpoint has copied them into
+// the main file and the log is gone, only the time tells them apart
+struct DataVersion {
+  uint32_t change_counter{0};
+  int64_t modified_ns{0};
+  uint64_t wal_salt{0};
+  uint64_t wal_frames{0};
+
+  bool operator==(const DataVersion &) const = default;
+};
+
 class FileReader {
 public:
   explicit FileReader(const std::string &filename)
-      : file_(filename, std::ios::binary) {
-    if (!file_.is_open()) {
+      : file_(filename, std::ios::binary), filename_(filename),
+        raw_file_(std::fopen(filename.c_str(), "rb"), &std::fclose) {
+    if (!file_.is_open() || !raw_file_) {
       throw std::runtime_error("Failed to open file: " + filename);
     }
 
-    // Get file size
-    file_.seekg(0, std::ios::end);
-    size_ = file_.tellg();
-    file_.seekg(0, std::ios::beg);
+    // Committed pages still in the write-ahead log take precedence, and may
+    // have grown the database past the end of the main file
+    wal_ = WalIndex::open(filename);
+    measure();
+  }
+
+  // Keeps the reader's view of the file for as long as a query runs
+  class ReadScope {
+  public:
+    explicit ReadScope(const FileReader &reader) noexcept : reader_(reader) {}
+    ReadScope(const ReadScope &) = delete;
+    ReadScope &operator=(const ReadScope &) = delete;
+    ~ReadScope() { reader_.endRead(); }
+
+  private:
+    const FileReader &reader_;
+  };
+
+  // Starts a query, outermost first: takes in the commits made since the
+  // last one, by indexing the write-ahead log further (or afresh once a
+  // checkpoint has restarted it) and dropping copies of pages that may
+  // have changed, then holds a read mark of the log until the scope ends,
+  // so that no checkpoint overwrites the pages the query reads
+  [[nodiscard]] ReadScope beginRead() const {
+    if (readers_++ == 0) {
+      refresh();
+    }
+    return ReadScope(*this);
   }
 
   // Read methods for different integer types
   [[nodiscard]] auto readU8() const -> uint8_t {
     uint8_t value;
-    file_.read(reinterpret_cast<char *>(&value), sizeof(value));
+    readBytes(&value, sizeof(value));
     return value;
   }
 
   [[nodiscard]] auto readU16() const -> uint16_t {
     uint16_t value;
-    file_.read(reinterpret_cast<char *>(&value), sizeof(value));
+    readBytes(&value, sizeof(value));
     return toBigEndian(value);
   }
 
   [[nodiscard]] auto readU32() const -> uint32_t {
     uint32_t value;
-    file_.read(reinterpret_cast<char *>(&value), sizeof(value));
+    readBytes(&value, sizeof(value));
     return toBigEndian(value);
   }
 
@@ -61,7 +126,16 @@ public:
 
   // Read bytes into buffer
   void readBytes(void *buffer, size_t length) const {
-    file_.read(reinterpret_cast<char *>(buffer), length);
+    if (window_ && pos_ >= window_start_ &&
+        pos_ + length <= window_start_ + window_->size()) {
+      std::memcpy(buffer, window_->data() + (pos_ - window_start_), length);
+    } else if (wal_) {
+      readPages(static_cast<uint8_t *>(buffer), pos_, length);
+    } else {
+      readFile(buffer, pos_, length);
+    }
+    pos_ += length;
+    countStat(&QueryStats::bytes_read, length);
   }
 
   // Read bytes at specific offset
@@ -78,18 +152,21 @@ public:
   }
 
   // Position management
-  void seek(size_t pos) const { file_.seekg(pos); }
+  void seek(size_t pos) const { pos_ = pos; }
 
-  void seekRelative(std::streamoff offset) const {
-    file_.seekg(offset, std::ios::cur);
-  }
+  void seekRelative(std::streamoff offset) const { pos_ += offset; }
 
-  [[nodiscard]] auto position() const -> size_t {
-    return static_cast<size_t>(file_.tellg());
-  }
+  [[nodiscard]] auto position() const -> size_t { return pos_; }
 
+  // Reads of a page that was prefetched are served from its copy in memory
   void seekToPage(uint32_t page_number, uint16_t page_size) const {
     uint32_t page_offset = (page_number - 1) * page_size;
+    if (prefetcher_) {
+      if (auto page = prefetcher_->take(page_number)) {
+        window_ = std::move(page);
+        window_start_ = page_offset;
+      }
+    }
 
     if (page_number == 1) {
       seek(page_offset + sqlite::HEADER_SIZE);
@@ -98,7 +175,94 @@ public:
     }
   }
 
+  // Reads the byte range into memory and serves later reads that fall in it
+  // from there, until a prefetched page takes its place
+  void pin(size_t offset, size_t length) {
+    length = offset < size_ ? std::min(length, size_ - offset) : 0;
+    auto data = std::make_shared<std::vector<uint8_t>>(length);
+    file_.clear();
+    stream_pos_ = SIZE_MAX;
+    if (!(wal_ ? readPages(data->data(), offset, length)
+               : readFile(data->data(), offset, length))) {
+      file_.clear();
+      throw std::runtime_error("Failed to read file: " + filename_);
+    }
+    countStat(&QueryStats::bytes_read, length);
+    window_ = std::move(data);
+    window_start_ = offset;
+  }
+
+  // Starts or stops reading pages ahead on background threads
+  void setPrefetching(bool enabled) {
+    prefetcher_ = enabled ? std::make_unique<PagePrefetcher>(filename_)
+                          : nullptr;
+  }
+
+  [[nodiscard]] bool prefetching() const noexcept {
+    return prefetcher_ != nullptr;
+  }
+
+  // Requests the page in the background when prefetching is on; pages in
+  // the write-ahead log are read from there instead
+  void prefetch(uint32_t page_number, uint16_t page_size) const {
+    if (prefetcher_ && !(wal_ && wal_->contains(page_number))) {
+      prefetcher_->prefetch(page_number, page_size);
+    }
+  }
+
+  [[nodiscard]] size_t prefetchDepth() const noexcept {
+    return prefetcher_ ? prefetcher_->depth() : 0;
+  }
+
+  void setReadahead(bool enabled) noexcept { readahead_ = enabled; }
+
+  [[nodiscard]] bool readahead() const noexcept { return readahead_; }
+
+  // Tells the kernel the byte range will be read soon, so that it can read
+  // it in the background as one sequential request
+  void adviseWillNeed(size_t offset, size_t length) const {
+    if (!readahead_) {
+      return;
+    }
+    posix_fadvise(fileno(raw_file_.get()), static_cast<off_t>(offset),
+                  static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+  }
+
+  // Reads the change counter and modification time afresh from the main
+  // file, past any copy of page 1 in memory, and takes the write-ahead log's
+  // state as of the query's start: beginRead() re-reads it from the log's
+  // file
+  [[nodiscard]] DataVersion dataVersion() const {
+    const int fd = fileno(raw_file_.get());
+    uint8_t counter[sizeof(uint32_t)] = {};
+    struct stat status {};
+    if (!readFully(fd, counter, sizeof(counter),
+                   sqlite::CHANGE_COUNTER_OFFSET) ||
+        fstat(fd, &status) != 0) {
+      throw std::runtime_error("Failed to read file: " + filename_);
+    }
+    const std::chrono::nanoseconds modified =
+        std::chrono::seconds(status.st_mtim.tv_sec) +
+        std::chrono::nanoseconds(status.st_mtim.tv_nsec);
+    DataVersion version{static_cast<uint32_t>(counter[0]) << 24 |
+                            static_cast<uint32_t>(counter[1]) << 16 |
+                            static_cast<uint32_t>(counter[2]) << 8 |
+                            counter[3],
+                        modified.count()};
+    if (wal_) {
+      version.wal_salt = wal_->salt();
+      version.wal_frames = wal_->frameCount();
+    }
+    return version;
+  }
+
+  // The write-ahead log read through, if the database has one
+  [[nodiscard]] const WalIndex *wal() const noexcept { return wal_.get(); }
+
   [[nodiscard]] auto size() const -> size_t { return size_; }
+  [[nodiscard]] const std::string &filename() const noexcept {
+    return filename_;
+  }
   [[nodiscard]] uint8_t peekU8() const {
     auto current_pos = position();
     uint8_t value = readU8();
@@ -107,6 +271,78 @@ public:
   }
 
 private:
+  // Attempts at a read mark before a query reads without one
+  static constexpr int READ_MARK_ATTEMPTS = 3;
+
+  void endRead() const {
+    if (--readers_ == 0 && wal_) {
+      wal_->unlockReadMark();
+    }
+  }
+
+  void refresh() const {
+    DataVersion before = dataVersion();
+    for (int attempt = 1;; ++attempt) {
+      if (!wal_ || !wal_->refresh()) {
+        wal_ = WalIndex::open(filename_);
+      }
+      if (!wal_ || wal_->lockReadMark() || attempt == READ_MARK_ATTEMPTS) {
+        break;
+      }
+    }
+    measure();
+    if (dataVersion() == before) {
+      return;
+    }
+    // Pages read before may be out of date
+    window_.reset();
+    file_.clear();
+    stream_pos_ = SIZE_MAX;
+    if (prefetcher_) {
+      prefetcher_ = std::make_unique<PagePrefetcher>(filename_);
+    }
+  }
+
+  // The main file's size, or the last commit's when it is in the log
+  void measure() const {
+    struct stat status {};
+    if (fstat(fileno(raw_file_.get()), &status) != 0) {
+      throw std::runtime_error("Failed to read file: " + filename_);
+    }
+    size_ = static_cast<size_t>(status.st_size);
+    if (wal_) {
+      size_ = std::max(size_, size_t{wal_->databasePages()} *
+                                  wal_->pageSize());
+    }
+  }
+
+  bool readFile(void *buffer, size_t offset, size_t length) const {
+    if (stream_pos_ != offset) {
+      file_.seekg(offset);
+    }
+    file_.read(reinterpret_cast<char *>(buffer), length);
+    stream_pos_ = file_ ? offset + length : SIZE_MAX;
+    return static_cast<bool>(file_);
+  }
+
+  // Reads page by page, from the log for the pages it holds a frame of
+  bool readPages(uint8_t *buffer, size_t offset, size_t length) const {
+    const size_t page_size = wal_->pageSize();
+    bool read = true;
+    while (length > 0) {
+      auto page_number = static_cast<uint32_t>(offset / page_size + 1);
+      size_t within = offset % page_size;
+      size_t n = std::min(length, page_size - within);
+      if (!wal_->read(page_number, within, buffer, n)) {
+        read = readFile(buffer, offset, n) && read;
+      }
+      buffer += n;
+      offset += n;
+      length -= n;
+    }
+    return read;
+  }
+
   // Endianness conversion helpers
   template <typename T> static T toBigEndian(T value) {
     if constexpr (std::endian::native == std::endian::little) {
@@ -125,5 +361,22 @@ private:
   }
 
   mutable std::ifstream file_;
-  size_t size_;
+  std::string filename_;
+  // The same file for pread(2), fstat(2) and hints; ifstream does not
+  // expose its descriptor
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> raw_file_;
+  mutable size_t size_{0};
+  // Logical read position, and where the stream actually is (SIZE_MAX when
+  // unknown), so that sequential reads need no seek
+  mutable size_t pos_{0};
+  mutable size_t stream_pos_{0};
+  // The last prefetched page handed out, or the pinned range, which later
+  // reads may fall in
+  mutable PagePrefetcher::PageData window_;
+  mutable size_t window_start_{0};
+  mutable std::unique_ptr<PagePrefetcher> prefetcher_;
+  mutable std::unique_ptr<WalIndex> wal_;
+  // Queries under way, nested ones included
+  mutable size_t readers_{0};
+  bool readahead_{true};
 };
@@ -0,0 +1,337 @@
+#include "join_executor.hpp"
+#include "debug.hpp"
+#include "normalized_key.hpp"
+#include <bit>
+#include <stdexcept>
+
+namespace {
+
+// Rough cost, in decoded-row equivalents, of reading one page during an
+// index or rowid probe.
+constexpr uint64_t PROBE_PAGE_COST = 4;
+
+bool isJoinable(const RecordValue &key) noexcept {
+  return !std::holds_alternative<std::monostate>(key);
+}
+
+std::optional<uint64_t> asRowid(const RecordValue &key) noexcept {
+  if (const auto *integer = std::get_if<int64_t>(&key)) {
+    return *integer >= 0 ? std::optional<uint64_t>(*integer) : std::nullopt;
+  }
+  if (const auto *real = std::get_if<double>(&key)) {
+    if (*real >= 0 && *real < 9.2e18 &&
+        *real == static_cast<double>(static_cast<int64_t>(*real))) {
+      return static_cast<uint64_t>(*real);
+    }
+  }
+  return std::nullopt;
+}
+
+// Hash consistent with comparing under `collation`: TEXT hashes folded or
+// trimmed as the collation compares it
+size_t hashKey(const RecordValue &key, Collation collation) {
+  if (collation == Collation::Binary ||
+      !std::holds_alternative<std::string>(key)) {
+    return hashRecordValue(key);
+  }
+  std::string normalized;
+  NormalizedKey::append(normalized, key, collation);
+  return std::hash<std::string>{}(normalized);
+}
+
+// Chained hash table over a flat row array: buckets hold the index of the
+// first row with that hash slot, and `next_` links rows sharing a slot. Each
+// row keeps a 32-bit hash tag so most mismatches never touch the row itself.
+// Keys match under the join's collation.
+class JoinHashTable {
+public:
+  static constexpr uint32_t END = UINT32_MAX;
+
+  explicit JoinHashTable(Collation collation) noexcept
+      : collation_(collation) {}
+
+  void add(Row &&row) {
+    tags_.push_back(static_cast<uint32_t>(hashKey(row.front(), collation_)));
+    rows_.push_back(std::move(row));
+  }
+
+  void build() {
+    size_t bucket_count = std::bit_ceil(std::max<size_t>(rows_.size() * 2, 16));
+    mask_ = bucket_count - 1;
+    buckets_.assign(bucket_count, END);
+    next_.assign(rows_.size(), END);
+    for (uint32_t i = 0; i < rows_.size(); ++i) {
+      uint32_t &head = buckets_[tags_[i] & mask_];
+      next_[i] = head;
+      head = i;
+    }
+  }
+
+  // Calls `visit(row_index)` for every row whose key equals `key`; returning
+  // false from the visitor stops the lookup.
+  template <typename Visitor>
+  bool forEachMatch(const RecordValue &key, Visitor &&visit) const {
+    uint32_t tag = static_cast<uint32_t>(hashKey(key, collation_));
+    for (uint32_t i = buckets_[tag & mask_]; i != END; i = next_[i]) {
+      if (tags_[i] == tag &&
+          compareRecordValues(rows_[i].front(), key, collation_) == 0 &&
+          !visit(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  [[nodiscard]] const Row &row(uint32_t index) const { return rows_[index]; }
+  [[nodiscard]] size_t size() const noexcept { return rows_.size(); }
+
+private:
+  Collation collation_;
+  std::vector<Row> rows_;
+  std::vector<uint32_t> tags_;
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> buckets_;
+  size_t mask_{0};
+};
+
+} // namespace
+
+JoinExecutor::JoinExecutor(const BTree &btree, JoinType type, JoinInput left,
+                           JoinInput right, const std::string &left_key,
+                           const std::string &right_key)
+    : btree_(btree), type_(type), inputs_{std::move(left), std::move(right)} {
+  ColumnRef first = resolve(left_key);
+  ColumnRef second = resolve(right_key);
+  if (first.side == second.side) {
+    throw std::runtime_error("Join condition must compare both tables");
+  }
+  key_positions_[first.side] = first.position;
+  key_positions_[second.side] = second.position;
+  // As in SQLite, the ON condition compares under its left column's
+  // collation
+  collation_ = first.collation;
+  plan();
+}
+
+JoinExecutor::ColumnRef
+JoinExecutor::resolve(const std::string &name) const {
+  auto [qualifier, column] = splitQualifiedName(name);
+
+  std::optional<ColumnRef> found;
+  for (size_t side = 0; side < 2; ++side) {
+    const JoinInput &input = inputs_[side];
+    if (!qualifier.empty() && qualifier != input.table_name &&
+        qualifier != input.alias) {
+      continue;
+    }
+    auto resolved = input.schema.resolveColumn(column);
+    if (!resolved) {
+      continue;
+    }
+    if (found) {
+      throw std::runtime_error("Ambiguous column name: " + name);
+    }
+    found = ColumnRef{side, resolved->position, resolved->collation};
+  }
+
+  if (!found) {
+    throw std::runtime_error("Unknown column: " + name);
+  }
+  return *found;
+}
+
+void JoinExecutor::plan() {
+  const JoinInput &left = inputs_[0];
+  const JoinInput &right = inputs_[1];
+
+  uint64_t hash_cost = left.estimated_rows + right.estimated_rows;
+  build_side_ = right.estimated_rows <= left.estimated_rows ? 1 : 0;
+
+  // Probing needs an unfiltered inner side, and LEFT JOIN must keep every
+  // row of the left table, so only the right side can be probed there.
+  uint64_t best_probe_cost = UINT64_MAX;
+  for (size_t inner = 0; inner < 2; ++inner) {
+    if ((type_ == JoinType::Left && inner == 0) || inputs_[inner].filtered) {
+      continue;
+    }
+
+    const JoinInput &input = inputs_[inner];
+    std::optional<uint32_t> index_root;
+    uint64_t pages_per_probe = input.tree.depth;
+    if (key_positions_[inner] != -1) {
+      // Index seeks compare in BINARY
+      if (collation_ != Collation::Binary) {
+        continue;
+      }
+      const std::string &column =
+          input.schema.getColumns()[key_positions_[inner]].name;
+      try {
+        index_root = static_cast<uint32_t>(
+            btree_.getIndexRootPage(input.table_name, column));
+      } catch (const std::runtime_error &) {
+        continue;
+      }
+      pages_per_probe += btree_.estimateTree(*index_root).depth;
+    }
+
+    uint64_t cost = inputs_[1 - inner].estimated_rows * pages_per_probe *
+                    PROBE_PAGE_COST;
+    if (cost < best_probe_cost) {
+      best_probe_cost = cost;
+      inner_side_ = inner;
+      inner_index_root_ = index_root;
+    }
+  }
+
+  strategy_ = best_probe_cost < hash_cost ? Strategy::IndexNestedLoop
+                                          : Strategy::HashJoin;
+  LOG_INFO("Join plan: "
+           << (strategy_ == Strategy::HashJoin ? "hash join building on "
+                                               : "index nested-loop into ")
+           << inputs_[strategy_ == Strategy::HashJoin ? build_side_
+                                                      : inner_side_]
+                  .table_name
+           << " (hash cost " << hash_cost << ", probe cost "
+           << best_probe_cost << ")");
+}
+
+JoinExecutor::Layout
+JoinExecutor::makeLayout(const std::vector<std::string> &columns) const {
+  Layout layout;
+  for (size_t side = 0; side < 2; ++side) {
+    layout.positions[side].push_back(key_positions_[side]);
+  }
+  for (const auto &name : columns) {
+    ColumnRef ref = resolve(name);
+    layout.outputs.emplace_back(ref.side, layout.positions[ref.side].size());
+    layout.positions[ref.side].push_back(ref.position);
+  }
+  return layout;
+}
+
+Row JoinExecutor::combine(const Layout &layout, const Row *left,
+                          const Row *right) {
+  const Row *sides[2] = {left, right};
+  Row row;
+  row.reserve(layout.outputs.size());
+  for (auto [side, index] : layout.outputs) {
+    if (sides[side] != nullptr) {
+      row.push_back((*sides[side])[index]);
+    } else {
+      row.emplace_back(std::monostate{});
+    }
+  }
+  return row;
+}
+
+void JoinExecutor::execute(const std::vector<std::string> &columns,
+                           const sqlite::RowSink &sink) const {
+  Layout layout = makeLayout(columns);
+  if (strategy_ == Strategy::HashJoin) {
+    hashJoin(layout, sink);
+  } else {
+    indexNestedLoopJoin(layout, sink);
+  }
+}
+
+void JoinExecutor::hashJoin(const Layout &layout,
+                            const sqlite::RowSink &sink) const {
+  const size_t build = build_side_;
+  const size_t probe = 1 - build;
+
+  // LEFT JOIN keeps unmatched left rows: directly while probing with the
+  // left side, or from the matched flags when the left side was built.
+  // Built left rows whose key can match nothing are set aside unhashed.
+  const bool outer_probe = type_ == JoinType::Left && probe == 0;
+  const bool outer_build = type_ == JoinType::Left && build == 0;
+
+  JoinHashTable table(collation_);
+  std::vector<Row> unjoinable;
+  inputs_[build].scan(layout.positions[build], [&](Row &&row) {
+    if (isJoinable(row.front())) {
+      table.add(std::move(row));
+    } else if (outer_build) {
+      unjoinable.push_back(std::move(row));
+    }
+    return true;
+  });
+  table.build();
+  LOG_INFO("Hash join built " << table.size() << " rows from "
+                              << inputs_[build].table_name);
+  std::vector<bool> matched(outer_build ? table.size() : 0);
+
+  auto emit = [&](const Row &probe_row, const Row *build_row) {
+    return probe == 0 ? sink(combine(layout, &probe_row, build_row))
+                      : sink(combine(layout, build_row, &probe_row));
+  };
+
+  bool stopped = false;
+  inputs_[probe].scan(layout.positions[probe], [&](Row &&row) {
+    bool any = false;
+    if (isJoinable(row.front())) {
+      stopped = !table.forEachMatch(row.front(), [&](uint32_t index) {
+        any = true;
+        if (outer_build) {
+          matched[index] = true;
+        }
+        return emit(row, &table.row(index));
+      });
+    }
+    if (!stopped && !any && outer_probe) {
+      stopped = !emit(row, nullptr);
+    }
+    return !stopped;
+  });
+
+  for (uint32_t i = 0; outer_build && !stopped && i < table.size(); ++i) {
+    if (!matched[i]) {
+      stopped = !sink(combine(layout, &table.row(i), nullptr));
+    }
+  }
+  for (size_t i = 0; !stopped && i < unjoinable.size(); ++i) {
+    stopped = !sink(combine(layout, &unjoinable[i], nullptr));
+  }
+}
+
+void JoinExecutor::indexNestedLoopJoin(const Layout &layout,
+                                       const sqlite::RowSink &sink) const {
+  const size_t inner = inner_side_;
+  const size_t outer = 1 - inner;
+  const JoinInput &inner_input = inputs_[inner];
+  const std::vector<int> &inner_positions = layout.positions[inner];
+
+  auto emit = [&](const Row &outer_row, const Row *inner_row) {
+    return outer == 0 ? sink(combine(layout, &outer_row, inner_row))
+                      : sink(combine(layout, inner_row, &outer_row));
+  };
+
+  QueryResult fetched;
+  inputs_[outer].scan(layout.positions[outer], [&](Row &&row) {
+    const RecordValue &key = row.front();
+    fetched.clear();
+
+    if (!inner_index_root_) {
+      if (auto rowid = asRowid(key)) {
+        btree_.findRow(inner_input.root_page, *rowid, inner_positions,
+                       fetched);
+      }
+    } else if (isJoinable(key)) {
+      btree_.seekIndex(*inner_index_root_, key,
+                       [&](uint64_t rowid, const std::vector<RecordValue> &) {
+                         btree_.findRow(inner_input.root_page, rowid,
+                                        inner_positions, fetched);
+                         return true;
+                       });
+    }
+
+    for (const auto &inner_row : fetched) {
+      if (!emit(row, &inner_row)) {
+        return false;
+      }
+    }
+    if (fetched.empty() && type_ == JoinType::Left) {
+      return emit(row, nullptr);
+    }
+    return true;
+  });
+}
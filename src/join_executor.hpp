@@ -0,0 +1,86 @@
+#pragma once
+
+#include "btree.hpp"
+#include "schema_record.hpp"
+#include "sql_parser.hpp"
+#include "sqlite_constants.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// One side of a join, prepared by the caller with any WHERE filter that
+// applies to it already pushed down into `scan`.
+struct JoinInput {
+  std::string table_name;
+  std::string alias;
+  SchemaRecord schema;
+  uint32_t root_page;
+  TreeEstimate tree;
+  // Rows expected from `scan`, after pushed-down filters
+  uint64_t estimated_rows;
+  bool filtered{false};
+  // Streams the table's rows projected to `positions`; stops when the sink
+  // returns false.
+  std::function<void(const std::vector<int> &positions,
+                     const sqlite::RowSink &sink)>
+      scan;
+};
+
+// Executes two-table equi-joins. A hash join builds a hash table over the
+// smaller input and streams the other one past it; an index nested-loop join
+// streams one input and probes the other by rowid or through an index on its
+// join key. The cheaper of the two is chosen from the inputs' size estimates.
+class JoinExecutor {
+public:
+  enum class Strategy { HashJoin, IndexNestedLoop };
+
+  JoinExecutor(const BTree &btree, JoinType type, JoinInput left,
+               JoinInput right, const std::string &left_key,
+               const std::string &right_key);
+
+  // Streams joined rows holding `columns` (bare or qualified names) in order.
+  void execute(const std::vector<std::string> &columns,
+               const sqlite::RowSink &sink) const;
+
+  [[nodiscard]] Strategy strategy() const noexcept { return strategy_; }
+
+private:
+  struct ColumnRef {
+    size_t side;
+    int position;
+    Collation collation;
+  };
+
+  // Per-execution projection: each side's scan positions (join key first)
+  // and where every output column comes from.
+  struct Layout {
+    std::vector<int> positions[2];
+    std::vector<std::pair<size_t, size_t>> outputs;
+  };
+
+  ColumnRef resolve(const std::string &name) const;
+  Layout makeLayout(const std::vector<std::string> &columns) const;
+  void plan();
+
+  void hashJoin(const Layout &layout, const sqlite::RowSink &sink) const;
+  void indexNestedLoopJoin(const Layout &layout,
+                           const sqlite::RowSink &sink) const;
+
+  static Row combine(const Layout &layout, const Row *left, const Row *right);
+
+  const BTree &btree_;
+  JoinType type_;
+  JoinInput inputs_[2];
+  int key_positions_[2];
+  // What the join keys compare under
+  Collation collation_{Collation::Binary};
+  Strategy strategy_{Strategy::HashJoin};
+  // Hash join: the side loaded into the hash table
+  size_t build_side_{0};
+  // Index nested-loop join: the side probed for every outer row, through
+  // `inner_index_root_` or, when unset, by rowid
+  size_t inner_side_{1};
+  std::optional<uint32_t> inner_index_root_;
+};
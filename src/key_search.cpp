@@ -0,0 +1,69 @@
+#include "key_search.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TEZ_KEY_SEARCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Ranges this short are counted whole rather than halved further
+constexpr size_t SEARCH_BLOCK = 16;
+
+size_t countLessScalar(const uint64_t *keys, size_t count,
+                       uint64_t target) noexcept {
+  size_t less = 0;
+  for (size_t i = 0; i < count; ++i) {
+    less += keys[i] < target;
+  }
+  return less;
+}
+
+#ifdef TEZ_KEY_SEARCH_AVX2
+
+// AVX2 only compares signed lanes; flipping the sign bit of both sides
+// turns that into the unsigned order
+__attribute__((target("avx2,popcnt"))) size_t
+countLessAvx2(const uint64_t *keys, size_t count, uint64_t target) noexcept {
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i needle =
+      _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(target)), sign);
+  size_t less = 0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i block = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)),
+        sign);
+    int mask = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, block)));
+    less += static_cast<size_t>(__builtin_popcount(mask));
+  }
+  return less + countLessScalar(keys + i, count - i, target);
+}
+
+bool hasAvx2() noexcept {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+#endif
+
+} // namespace
+
+size_t searchKeys(const uint64_t *keys, size_t count,
+                  uint64_t target) noexcept {
+  const uint64_t *base = keys;
+  while (count > SEARCH_BLOCK) {
+    size_t half = count / 2;
+    base = base[half - 1] < target ? base + half : base;
+    count -= half;
+  }
+#ifdef TEZ_KEY_SEARCH_AVX2
+  if (hasAvx2()) {
+    return static_cast<size_t>(base - keys) +
+           countLessAvx2(base, count, target);
+  }
+#endif
+  return static_cast<size_t>(base - keys) +
+         countLessScalar(base, count, target);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Position of the first of `count` ascending keys that is >= `target`, or
+// `count` when there is none: std::lower_bound over a dense key array.
+// Branch-free halving narrows the range to a short block, which is then
+// counted with AVX2 compares when the CPU has them.
+[[nodiscard]] size_t searchKeys(const uint64_t *keys, size_t count,
+                                uint64_t target) noexcept;
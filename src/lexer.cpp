@@ -1,5 +1,15 @@
 #include "lexer.hpp"
+#include <algorithm>
 #include <cctype>
+#include <string_view>
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                    [](char a, char b) {
+                      return std::tolower(static_cast<unsigned char>(a)) ==
+                             std::tolower(static_cast<unsigned char>(b));
+                    });
+}
 
 Lexer::Lexer(std::string input) : input_(std::move(input)) {}
 
@@ -21,7 +31,8 @@ bool Lexer::matchKeyword(const std::string &keyword, TokenType type) {
   }
 
   size_t next_pos = position_ + keyword.length();
-  if (next_pos < input_.length() && std::isalnum(input_[next_pos])) {
+  if (next_pos < input_.length() &&
+      (std::isalnum(input_[next_pos]) || input_[next_pos] == '_')) {
     return false;
   }
 
@@ -33,13 +44,46 @@ Token Lexer::readIdentifier() {
   std::string identifier;
   while (position_ < input_.length() &&
          (std::isalnum(input_[position_]) || input_[position_] == '_' ||
-          input_[position_] == '*')) {
+          input_[position_] == '.')) {
     identifier += input_[position_];
     position_++;
   }
+  if (identifier.empty()) {
+    // Unknown punctuation; hand it to the parser to reject
+    return readOperator();
+  }
   return Token(TokenType::Identifier, identifier);
 }
 
+Token Lexer::readNumber() {
+  size_t start = position_;
+  auto digits = [this] {
+    while (position_ < input_.length() && std::isdigit(input_[position_])) {
+      position_++;
+    }
+  };
+
+  digits();
+  if (position_ < input_.length() && input_[position_] == '.') {
+    position_++;
+    digits();
+  }
+  if (position_ < input_.length() &&
+      (input_[position_] == 'e' || input_[position_] == 'E')) {
+    size_t exponent = position_++;
+    if (position_ < input_.length() &&
+        (input_[position_] == '+' || input_[position_] == '-')) {
+      position_++;
+    }
+    if (position_ < input_.length() && std::isdigit(input_[position_])) {
+      digits();
+    } else {
+      position_ = exponent;
+    }
+  }
+  return Token(TokenType::Number, input_.substr(start, position_ - start));
+}
+
 Token Lexer::readString() {
   position_++; // Skip opening quote
   std::string value;
@@ -54,6 +98,15 @@ Token Lexer::readString() {
 }
 
 Token Lexer::readOperator() {
+  static constexpr const char *TWO_CHAR_OPERATORS[] = {"<=", ">=", "!=",
+                                                       "<>", "=="};
+  for (const char *op : TWO_CHAR_OPERATORS) {
+    if (input_.compare(position_, 2, op) == 0) {
+      position_ += 2;
+      return Token(TokenType::Operator, op);
+    }
+  }
+
   std::string op;
   op += input_[position_];
   position_++;
@@ -72,7 +125,15 @@ Token Lexer::nextToken() {
     position_++; // Skip opening quote
     std::string value;
 
-    while (position_ < input_.length() && input_[position_] != quote) {
+    // A doubled quote inside a quoted token stands for the quote itself
+    while (position_ < input_.length()) {
+      if (input_[position_] == quote) {
+        if (position_ + 1 < input_.length() && input_[position_ + 1] == quote) {
+          position_++;
+        } else {
+          break;
+        }
+      }
       value += input_[position_];
       position_++;
     }
@@ -105,8 +166,19 @@ Token Lexer::nextToken() {
     return readString();
   }
 
-  if (input_[position_] == '=' || input_[position_] == '<' ||
-      input_[position_] == '>') {
+  if (input_[position_] == '*') {
+    position_++;
+    return Token(TokenType::Star, "*");
+  }
+
+  if (std::isdigit(input_[position_]) ||
+      (input_[position_] == '.' && position_ + 1 < input_.length() &&
+       std::isdigit(input_[position_ + 1]))) {
+    return readNumber();
+  }
+
+  if (std::string_view("=<>!+-/%").find(input_[position_]) !=
+      std::string_view::npos) {
     return readOperator();
   }
 
@@ -135,6 +207,66 @@ Token Lexer::nextToken() {
   if (matchKeyword("KEY", TokenType::Key)) {
     return Token(TokenType::Key);
   }
+  if (matchKeyword("ORDER", TokenType::Order)) {
+    return Token(TokenType::Order);
+  }
+  if (matchKeyword("BY", TokenType::By)) {
+    return Token(TokenType::By);
+  }
+  if (matchKeyword("ASC", TokenType::Asc)) {
+    return Token(TokenType::Asc);
+  }
+  if (matchKeyword("DESC", TokenType::Desc)) {
+    return Token(TokenType::Desc);
+  }
+  if (matchKeyword("LIMIT", TokenType::Limit)) {
+    return Token(TokenType::Limit);
+  }
+  if (matchKeyword("OFFSET", TokenType::Offset)) {
+    return Token(TokenType::Offset);
+  }
+  if (matchKeyword("JOIN", TokenType::Join)) {
+    return Token(TokenType::Join);
+  }
+  if (matchKeyword("INNER", TokenType::Inner)) {
+    return Token(TokenType::Inner);
+  }
+  if (matchKeyword("LEFT", TokenType::Left)) {
+    return Token(TokenType::Left);
+  }
+  if (matchKeyword("OUTER", TokenType::Outer)) {
+    return Token(TokenType::Outer);
+  }
+  if (matchKeyword("ON", TokenType::On)) {
+    return Token(TokenType::On);
+  }
+  if (matchKeyword("AS", TokenType::As)) {
+    return Token(TokenType::As);
+  }
+  if (matchKeyword("AND", TokenType::And)) {
+    return Token(TokenType::And);
+  }
+  if (matchKeyword("OR", TokenType::Or)) {
+    return Token(TokenType::Or);
+  }
+  if (matchKeyword("NOT", TokenType::Not)) {
+    return Token(TokenType::Not);
+  }
+  if (matchKeyword("IN", TokenType::In)) {
+    return Token(TokenType::In);
+  }
+  if (matchKeyword("IS", TokenType::Is)) {
+    return Token(TokenType::Is);
+  }
+  if (matchKeyword("NULL", TokenType::Null)) {
+    return Token(TokenType::Null);
+  }
+  if (matchKeyword("LIKE", TokenType::Like)) {
+    return Token(TokenType::Like);
+  }
+  if (matchKeyword("BETWEEN", TokenType::Between)) {
+    return Token(TokenType::Between);
+  }
   if (matchKeyword("AUTOINCREMENT", TokenType::Identifier)) {
     return Token(TokenType::Identifier, "autoincrement");
   }
@@ -2,9 +2,14 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
+// ASCII case-insensitive equality, as SQL keywords, names and collation
+// names compare
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs);
+
 enum class TokenType {
   Select,
   From,
@@ -22,6 +27,26 @@ enum class TokenType {
   Primary,
   Key,
   Operator,
+  Order,
+  By,
+  Asc,
+  Desc,
+  Limit,
+  Offset,
+  Join,
+  Inner,
+  Left,
+  Outer,
+  On,
+  As,
+  And,
+  Or,
+  Not,
+  In,
+  Is,
+  Null,
+  Like,
+  Between,
   Eof,
   Multiply,
 
@@ -49,6 +74,7 @@ private:
   void skipWhitespace();
   bool matchKeyword(const std::string &keyword, TokenType type);
   Token readIdentifier();
+  Token readNumber();
   Token readString();
   Token readOperator();
 
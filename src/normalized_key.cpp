@@ -0,0 +1,121 @@
+#include "normalized_key.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+// Type bytes, in SQLite's cross-type order
+constexpr char NULL_TAG = 0x05;
+constexpr char NUMBER_TAG = 0x15;
+constexpr char TEXT_TAG = 0x25;
+constexpr char BLOB_TAG = 0x35;
+
+// 2^63, the first double past every int64_t
+constexpr double INT64_LIMIT = 9223372036854775808.0;
+
+void appendBigEndian(std::string &key, uint64_t value, int bytes) {
+  for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+    key.push_back(static_cast<char>((value >> shift) & 0xFF));
+  }
+}
+
+void appendNumber(std::string &key, double number, int64_t correction) {
+  // Flip all bits of negatives and the sign bit of the rest, so that the
+  // unsigned order of the bits is the numeric order
+  uint64_t bits = std::bit_cast<uint64_t>(number == 0.0 ? 0.0 : number);
+  bits = (bits >> 63) != 0 ? ~bits : bits | (uint64_t{1} << 63);
+  appendBigEndian(key, bits, 8);
+  // Integers near 2^63 are at most 1024 away from their double
+  appendBigEndian(key, static_cast<uint16_t>(correction + 0x8000), 2);
+}
+
+void appendBytes(std::string &key, const uint8_t *bytes, size_t size,
+                 Collation collation) {
+  for (size_t i = 0; i < size; ++i) {
+    uint8_t byte = bytes[i];
+    if (collation == Collation::NoCase && byte >= 'A' && byte <= 'Z') {
+      byte += 'a' - 'A';
+    }
+    key.push_back(static_cast<char>(byte));
+    if (byte == 0) {
+      key.push_back(static_cast<char>(0xFF));
+    }
+  }
+  key.append(2, '\0');
+}
+
+} // namespace
+
+void NormalizedKey::append(std::string &key, const RecordValue &value,
+                           Collation collation) {
+  switch (value.index()) {
+  case 0:
+    key.push_back(NULL_TAG);
+    return;
+  case 1: {
+    // Integers and reals compare exactly: the double orders them, and the
+    // distance to it breaks ties between integers it rounds together
+    int64_t integer = std::get<int64_t>(value);
+    double number = static_cast<double>(integer);
+    int64_t correction = number >= INT64_LIMIT
+                             ? (integer - INT64_MAX) - 1
+                             : integer - static_cast<int64_t>(number);
+    key.push_back(NUMBER_TAG);
+    appendNumber(key, number, correction);
+    return;
+  }
+  case 2:
+    key.push_back(NUMBER_TAG);
+    appendNumber(key, std::get<double>(value), 0);
+    return;
+  case 3: {
+    std::string_view text = std::get<std::string>(value);
+    if (collation == Collation::RTrim) {
+      text = text.substr(0, text.find_last_not_of(' ') + 1);
+    }
+    key.push_back(TEXT_TAG);
+    appendBytes(key, reinterpret_cast<const uint8_t *>(text.data()),
+                text.size(), collation);
+    return;
+  }
+  default: {
+    const auto &blob = std::get<std::vector<uint8_t>>(value);
+    key.push_back(BLOB_TAG);
+    appendBytes(key, blob.data(), blob.size(), Collation::Binary);
+    return;
+  }
+  }
+}
+
+std::string NormalizedKey::encode(const std::vector<RecordValue> &values,
+                                  const std::vector<Collation> &collations,
+                                  size_t count) {
+  std::string key;
+  count = std::min(count, values.size());
+  for (size_t i = 0; i < count; ++i) {
+    append(key, values[i],
+           i < collations.size() ? collations[i] : Collation::Binary);
+  }
+  return key;
+}
+
+int NormalizedKey::comparePrefix(std::string_view entry,
+                                 std::string_view target) noexcept {
+  size_t common = std::min(entry.size(), target.size());
+  int result = common == 0 ? 0 : std::memcmp(entry.data(), target.data(),
+                                             common);
+  if (result != 0) {
+    return result;
+  }
+  return entry.size() < target.size() ? -1 : 0;
+}
+
+uint64_t NormalizedKey::prefix(std::string_view key) noexcept {
+  uint64_t value = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    value = (value << 8) |
+            (i < key.size() ? static_cast<uint8_t>(key[i]) : uint64_t{0});
+  }
+  return value;
+}
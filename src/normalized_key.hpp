@@ -0,0 +1,42 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Encodes index keys as byte strings whose memcmp order is SQLite's
+// comparison order, so that keys compare without being decoded. Each value
+// is a type byte followed by:
+//
+//   NULL          nothing
+//   INTEGER/REAL  the value as an order-preserving double, then a 2-byte
+//                 correction for integers the double cannot hold exactly
+//   TEXT/BLOB     the bytes, 0x00 escaped as 0x00 0xFF, ended by 0x00 0x00;
+//                 TEXT is first folded or trimmed as its collation asks
+//
+// Every encoded value is prefix-free, so a record's values concatenate, and
+// a record that is a prefix of another sorts first.
+class NormalizedKey {
+public:
+  // Appends one value
+  static void append(std::string &key, const RecordValue &value,
+                     Collation collation = Collation::Binary);
+
+  // Encodes the first `count` values (all of them by default); missing
+  // collations are BINARY
+  [[nodiscard]] static std::string
+  encode(const std::vector<RecordValue> &values,
+         const std::vector<Collation> &collations = {},
+         size_t count = SIZE_MAX);
+
+  // Orders an encoded entry against an encoded leading-column target: 0
+  // when the entry starts with the target's values, else like memcmp
+  [[nodiscard]] static int comparePrefix(std::string_view entry,
+                                         std::string_view target) noexcept;
+
+  // The first 8 bytes as a big-endian integer, zero padded: a < b whenever
+  // prefix(a) < prefix(b), for searching dense prefix arrays
+  [[nodiscard]] static uint64_t prefix(std::string_view key) noexcept;
+};
@@ -17,6 +17,7 @@ public:
 
   [[nodiscard]] auto read() -> Data {
     Data overflow;
+    countStat(&QueryStats::overflow_pages);
 
     // Read next page pointer (4 bytes big-endian)
     overflow.next_page = reader_.readU32();
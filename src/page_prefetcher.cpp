@@ -0,0 +1,153 @@
+#include "page_prefetcher.hpp"
+#include "file_reader.hpp"
+#include "query_stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+// Prefetched pages kept before the oldest are dropped untaken
+constexpr size_t MAX_PREFETCH_SLOTS = 4 * MAX_PREFETCH_DEPTH;
+
+// Weight of the newest sample in the moving averages
+constexpr double SMOOTHING = 0.125;
+
+void smooth(double &average, double sample) {
+  average = average == 0.0 ? sample : average + SMOOTHING * (sample - average);
+}
+
+} // namespace
+
+PagePrefetcher::PagePrefetcher(const std::string &filename, size_t threads)
+    : fd_(open(filename.c_str(), O_RDONLY | O_CLOEXEC)) {
+  if (fd_ < 0) {
+    throw std::runtime_error("Failed to open file: " + filename);
+  }
+  for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+    workers_.emplace_back(&PagePrefetcher::work, this);
+  }
+}
+
+PagePrefetcher::~PagePrefetcher() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  close(fd_);
+}
+
+void PagePrefetcher::prefetch(uint32_t page_number, uint16_t page_size) {
+  {
+    std::lock_guard lock(mutex_);
+    if (slots_.contains(page_number)) {
+      return;
+    }
+    if (slots_.size() >= MAX_PREFETCH_SLOTS) {
+      evictOldest();
+    }
+    uint64_t sequence = next_sequence_++;
+    slots_.emplace(page_number, Slot{sequence});
+    queue_.push_back({page_number, page_size, sequence});
+  }
+  countStat(&QueryStats::pages_prefetched);
+  work_ready_.notify_one();
+}
+
+PagePrefetcher::PageData PagePrefetcher::take(uint32_t page_number) {
+  std::unique_lock lock(mutex_);
+  auto it = slots_.find(page_number);
+  if (it == slots_.end()) {
+    return nullptr;
+  }
+
+  auto now = Clock::now();
+  if (last_take_ != Clock::time_point{}) {
+    smooth(gap_ns_, std::chrono::duration<double, std::nano>(now - last_take_)
+                        .count());
+  }
+  last_take_ = now;
+
+  if (!it->second.ready) {
+    countStat(&QueryStats::prefetch_stalls);
+    PhaseTimer timer(QueryPhase::IO);
+    page_ready_.wait(lock, [&] {
+      it = slots_.find(page_number);
+      return it == slots_.end() || it->second.ready;
+    });
+    if (it == slots_.end()) {
+      return nullptr;
+    }
+  }
+  PageData data = std::move(it->second.data);
+  slots_.erase(it);
+  return data;
+}
+
+size_t PagePrefetcher::depth() const noexcept {
+  std::lock_guard lock(mutex_);
+  if (read_ns_ == 0.0 || gap_ns_ == 0.0) {
+    return MIN_PREFETCH_DEPTH;
+  }
+  double needed = std::ceil(read_ns_ / gap_ns_) + 1.0;
+  return static_cast<size_t>(
+      std::clamp(needed, static_cast<double>(MIN_PREFETCH_DEPTH),
+                 static_cast<double>(MAX_PREFETCH_DEPTH)));
+}
+
+void PagePrefetcher::work() {
+  while (true) {
+    Request request;
+    {
+      std::unique_lock lock(mutex_);
+      work_ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      request = queue_.front();
+      queue_.pop_front();
+    }
+
+    auto data = std::make_shared<std::vector<uint8_t>>(request.page_size);
+    auto start = Clock::now();
+    bool ok = readFully(fd_, data->data(), data->size(),
+                        static_cast<off_t>(request.page_number - 1) *
+                            request.page_size);
+    double read_ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    {
+      std::lock_guard lock(mutex_);
+      smooth(read_ns_, read_ns);
+      // The slot may have been evicted, or taken and requested again
+      auto it = slots_.find(request.page_number);
+      if (it != slots_.end() && it->second.sequence == request.sequence) {
+        it->second.ready = true;
+        if (ok) {
+          it->second.data = std::move(data);
+        }
+      }
+    }
+    page_ready_.notify_all();
+  }
+}
+
+void PagePrefetcher::evictOldest() {
+  auto oldest = slots_.end();
+  for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+    if (oldest == slots_.end() ||
+        it->second.sequence < oldest->second.sequence) {
+      oldest = it;
+    }
+  }
+  if (oldest != slots_.end()) {
+    slots_.erase(oldest);
+  }
+  page_ready_.notify_all();
+}
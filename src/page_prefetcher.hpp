@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reader threads started by a prefetcher
+constexpr size_t DEFAULT_PREFETCH_THREADS = 4;
+
+// Bounds on how many pages ahead of a scan are kept in flight
+constexpr size_t MIN_PREFETCH_DEPTH = 2;
+constexpr size_t MAX_PREFETCH_DEPTH = 64;
+
+// Reads whole pages on a pool of background threads, each with its own
+// descriptor, so that a scan can decode one page while the next ones are
+// still being read. The suggested depth follows Little's law: enough pages
+// in flight to cover the observed read latency at the rate pages are
+// consumed.
+class PagePrefetcher {
+public:
+  using PageData = std::shared_ptr<const std::vector<uint8_t>>;
+
+  explicit PagePrefetcher(const std::string &filename,
+                          size_t threads = DEFAULT_PREFETCH_THREADS);
+  ~PagePrefetcher();
+
+  PagePrefetcher(const PagePrefetcher &) = delete;
+  PagePrefetcher &operator=(const PagePrefetcher &) = delete;
+
+  // Queues a read of the page unless one is already pending
+  void prefetch(uint32_t page_number, uint16_t page_size);
+
+  // The page's bytes, waiting for its read to finish, if it was prefetched;
+  // null otherwise or when the read failed. Each prefetch is taken once.
+  [[nodiscard]] PageData take(uint32_t page_number);
+
+  // Pages a scan should keep requested ahead of the one it is reading
+  [[nodiscard]] size_t depth() const noexcept;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Slot {
+    uint64_t sequence;
+    bool ready{false};
+    PageData data{};
+  };
+
+  struct Request {
+    uint32_t page_number;
+    uint16_t page_size;
+    uint64_t sequence;
+  };
+
+  void work();
+  void evictOldest();
+
+  int fd_;
+  mutable std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable page_ready_;
+  std::deque<Request> queue_;
+  std::unordered_map<uint32_t, Slot> slots_;
+  std::vector<std::thread> workers_;
+  bool stopping_{false};
+  uint64_t next_sequence_{0};
+
+  // Moving averages of one read's duration and of the time between takes
+  double read_ns_{0.0};
+  double gap_ns_{0.0};
+  Clock::time_point last_take_{};
+};
@@ -0,0 +1,824 @@
+#include "predicate.hpp"
+#include "lexer.hpp"
+#include "query_stats.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+enum class Truth : uint8_t { False, True, Null };
+
+using Filter = std::function<void(const RowBatch &, Selection &)>;
+
+// A boolean node compiled into two filters: one keeping the rows where it is
+// TRUE and one keeping those where it is FALSE. Rows where it is NULL pass
+// neither, which is what lets NOT swap the two without breaking NULLs.
+struct Condition {
+  Filter when_true;
+  Filter when_false;
+};
+
+using ValueFn =
+    std::function<RecordValue(const std::vector<RecordValue> &, uint64_t)>;
+
+// A compiled scalar expression, remembering whether it is a bare column or a
+// row-independent constant so comparisons can specialise on it.
+struct Operand {
+  ValueFn eval;
+  Affinity affinity{Affinity::None};
+  // Only bare columns carry a collation into comparisons
+  Collation collation{Collation::Binary};
+  std::optional<int> column;
+  std::optional<RecordValue> constant;
+};
+
+const RecordValue NULL_VALUE{};
+
+bool isNull(const RecordValue &value) noexcept {
+  return std::holds_alternative<std::monostate>(value);
+}
+
+bool isNumeric(Affinity affinity) noexcept {
+  return affinity == Affinity::Numeric || affinity == Affinity::Integer ||
+         affinity == Affinity::Real;
+}
+
+bool containsIgnoreCase(const std::string &text, std::string_view needle) {
+  auto it = std::search(text.begin(), text.end(), needle.begin(), needle.end(),
+                        [](char a, char b) {
+                          return std::toupper(static_cast<unsigned char>(a)) ==
+                                 b;
+                        });
+  return it != text.end();
+}
+
+std::string_view trim(std::string_view text) noexcept {
+  auto space = [](char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+  };
+  while (!text.empty() && space(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && space(text.back())) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Parses text that is entirely an integer or real literal
+std::optional<RecordValue> parseNumericText(std::string_view text) {
+  text = trim(text);
+  if (text.empty()) {
+    return std::nullopt;
+  }
+  const char *begin = text.data() + (text.front() == '+' ? 1 : 0);
+  const char *end = text.data() + text.size();
+
+  int64_t integer = 0;
+  auto [int_end, int_error] = std::from_chars(begin, end, integer);
+  if (int_error == std::errc() && int_end == end) {
+    return integer;
+  }
+  double real = 0;
+  auto [real_end, real_error] = std::from_chars(begin, end, real);
+  if (real_error == std::errc() && real_end == end) {
+    return real;
+  }
+  return std::nullopt;
+}
+
+// Numeric value of an arithmetic operand: text and blobs contribute their
+// longest numeric prefix, or 0 without one.
+RecordValue toNumber(const RecordValue &value) {
+  if (std::holds_alternative<int64_t>(value) ||
+      std::holds_alternative<double>(value)) {
+    return value;
+  }
+  std::string text = recordValueToText(value);
+  std::string_view view = trim(text);
+  const char *begin = view.data() + (!view.empty() && view.front() == '+');
+  const char *end = view.data() + view.size();
+
+  int64_t integer = 0;
+  auto [int_end, int_error] = std::from_chars(begin, end, integer);
+  double real = 0;
+  auto [real_end, real_error] = std::from_chars(begin, end, real);
+  if (real_error == std::errc() && real_end > int_end) {
+    return real;
+  }
+  if (int_error == std::errc()) {
+    return integer;
+  }
+  return int64_t{0};
+}
+
+double asDouble(const RecordValue &number) noexcept {
+  return std::holds_alternative<int64_t>(number)
+             ? static_cast<double>(std::get<int64_t>(number))
+             : std::get<double>(number);
+}
+
+RecordValue arithmetic(ExprOp op, const RecordValue &lhs,
+                       const RecordValue &rhs) {
+  if (isNull(lhs) || isNull(rhs)) {
+    return NULL_VALUE;
+  }
+  RecordValue a = toNumber(lhs);
+  RecordValue b = toNumber(rhs);
+
+  if (std::holds_alternative<int64_t>(a) &&
+      std::holds_alternative<int64_t>(b)) {
+    int64_t x = std::get<int64_t>(a);
+    int64_t y = std::get<int64_t>(b);
+    int64_t result = 0;
+    switch (op) {
+    case ExprOp::Add:
+      if (!__builtin_add_overflow(x, y, &result)) {
+        return result;
+      }
+      break;
+    case ExprOp::Sub:
+      if (!__builtin_sub_overflow(x, y, &result)) {
+        return result;
+      }
+      break;
+    case ExprOp::Mul:
+      if (!__builtin_mul_overflow(x, y, &result)) {
+        return result;
+      }
+      break;
+    case ExprOp::Div:
+      if (y == 0) {
+        return NULL_VALUE;
+      }
+      if (x != INT64_MIN || y != -1) {
+        return x / y;
+      }
+      break;
+    case ExprOp::Mod:
+      if (y == 0) {
+        return NULL_VALUE;
+      }
+      return y == -1 ? int64_t{0} : x % y;
+    default:
+      break;
+    }
+    // Integer overflow falls back to floating point, as in SQLite
+  }
+
+  double x = asDouble(a);
+  double y = asDouble(b);
+  switch (op) {
+  case ExprOp::Add:
+    return x + y;
+  case ExprOp::Sub:
+    return x - y;
+  case ExprOp::Mul:
+    return x * y;
+  case ExprOp::Div:
+    return y == 0 ? NULL_VALUE : RecordValue(x / y);
+  case ExprOp::Mod: {
+    int64_t divisor = static_cast<int64_t>(y);
+    if (divisor == 0) {
+      return NULL_VALUE;
+    }
+    return divisor == -1 ? 0.0
+                         : static_cast<double>(static_cast<int64_t>(x) %
+                                               divisor);
+  }
+  default:
+    throw std::runtime_error("Unsupported arithmetic operator");
+  }
+}
+
+RecordValue negate(const RecordValue &value) {
+  if (isNull(value)) {
+    return NULL_VALUE;
+  }
+  RecordValue number = toNumber(value);
+  if (const auto *integer = std::get_if<int64_t>(&number)) {
+    return *integer == INT64_MIN ? RecordValue(-static_cast<double>(*integer))
+                                 : RecordValue(-*integer);
+  }
+  return -std::get<double>(number);
+}
+
+Truth compareTruth(ExprOp op, int cmp) noexcept {
+  bool result = false;
+  switch (op) {
+  case ExprOp::Eq:
+    result = cmp == 0;
+    break;
+  case ExprOp::Ne:
+    result = cmp != 0;
+    break;
+  case ExprOp::Lt:
+    result = cmp < 0;
+    break;
+  case ExprOp::Le:
+    result = cmp <= 0;
+    break;
+  case ExprOp::Gt:
+    result = cmp > 0;
+    break;
+  case ExprOp::Ge:
+    result = cmp >= 0;
+    break;
+  default:
+    break;
+  }
+  return result ? Truth::True : Truth::False;
+}
+
+ExprOp mirror(ExprOp op) noexcept {
+  switch (op) {
+  case ExprOp::Lt:
+    return ExprOp::Gt;
+  case ExprOp::Le:
+    return ExprOp::Ge;
+  case ExprOp::Gt:
+    return ExprOp::Lt;
+  case ExprOp::Ge:
+    return ExprOp::Le;
+  default:
+    return op;
+  }
+}
+
+Truth truthOf(const RecordValue &value) {
+  if (isNull(value)) {
+    return Truth::Null;
+  }
+  return asDouble(toNumber(value)) != 0 ? Truth::True : Truth::False;
+}
+
+Truth invert(Truth truth, bool negated) noexcept {
+  if (!negated || truth == Truth::Null) {
+    return truth;
+  }
+  return truth == Truth::True ? Truth::False : Truth::True;
+}
+
+// SQLite's conversions before a comparison: an operand with a numeric
+// affinity turns the other side's numeric-looking text into a number, and a
+// TEXT operand turns an affinity-less other side into text. TEXT then
+// compares under the left operand's collation when it is a column, else the
+// right one's.
+struct ComparisonAffinity {
+  Affinity lhs{Affinity::None};
+  Affinity rhs{Affinity::None};
+  Collation collation{Collation::Binary};
+
+  ComparisonAffinity(const Operand &left_operand,
+                     const Operand &right_operand) {
+    const Affinity left = left_operand.affinity;
+    const Affinity right = right_operand.affinity;
+    if (left_operand.column) {
+      collation = left_operand.collation;
+    } else if (right_operand.column) {
+      collation = right_operand.collation;
+    }
+    if (isNumeric(left) && !isNumeric(right)) {
+      rhs = Affinity::Numeric;
+    } else if (isNumeric(right) && !isNumeric(left)) {
+      lhs = Affinity::Numeric;
+    } else if (left == Affinity::Text && right == Affinity::None) {
+      rhs = Affinity::Text;
+    } else if (right == Affinity::Text && left == Affinity::None) {
+      lhs = Affinity::Text;
+    }
+  }
+
+  void apply(RecordValue &left, RecordValue &right) const {
+    applyAffinity(lhs, left);
+    applyAffinity(rhs, right);
+  }
+
+  [[nodiscard]] int compare(const RecordValue &left,
+                            const RecordValue &right) const noexcept {
+    return compareRecordValues(left, right, collation);
+  }
+};
+
+// Case-insensitive (ASCII) LIKE with % and _ wildcards
+bool likeMatch(std::string_view pattern, std::string_view text) noexcept {
+  auto fold = [](char c) {
+    return std::tolower(static_cast<unsigned char>(c));
+  };
+  size_t p = 0;
+  size_t t = 0;
+  size_t star = std::string_view::npos;
+  size_t resume = 0;
+  while (t < text.size()) {
+    if (p < pattern.size() && pattern[p] == '%') {
+      star = p++;
+      resume = t;
+    } else if (p < pattern.size() &&
+               (pattern[p] == '_' || fold(pattern[p]) == fold(text[t]))) {
+      ++p;
+      ++t;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      t = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '%') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+// Text a value is matched as by LIKE, without copying TEXT values
+std::string_view likeText(const RecordValue &value, std::string &scratch) {
+  if (const auto *text = std::get_if<std::string>(&value)) {
+    return *text;
+  }
+  scratch = recordValueToText(value);
+  return scratch;
+}
+
+template <typename Keep> void keepIf(Selection &selection, Keep &&keep) {
+  size_t out = 0;
+  for (uint32_t index : selection) {
+    if (keep(index)) {
+      selection[out++] = index;
+    }
+  }
+  selection.resize(out);
+}
+
+// Builds both filters of a condition from a per-row test, letting the
+// compiler inline the test into each filter's loop.
+template <typename Test> Condition makeCondition(Test test) {
+  return {[test](const RowBatch &batch, Selection &selection) {
+            keepIf(selection, [&](uint32_t i) {
+              return test(batch, i) == Truth::True;
+            });
+          },
+          [test](const RowBatch &batch, Selection &selection) {
+            keepIf(selection, [&](uint32_t i) {
+              return test(batch, i) == Truth::False;
+            });
+          }};
+}
+
+// Reads a column in place; the rowid is materialised into `scratch`
+const RecordValue &columnValue(const RowBatch &batch, uint32_t i, int position,
+                               RecordValue &scratch) {
+  if (position == -1) {
+    scratch = static_cast<int64_t>(batch.rowids[i]);
+    return scratch;
+  }
+  const auto &values = *batch.records[i];
+  return static_cast<size_t>(position) < values.size() ? values[position]
+                                                       : NULL_VALUE;
+}
+
+RecordValue evalAt(const Operand &operand, const RowBatch &batch, uint32_t i) {
+  return operand.eval(*batch.records[i], batch.rowids[i]);
+}
+
+Condition compileCondition(const Expr &expr, const ColumnResolver &resolve);
+
+Operand constantOperand(RecordValue value) {
+  Operand operand;
+  operand.eval = [value](const std::vector<RecordValue> &, uint64_t) {
+    return value;
+  };
+  operand.constant = std::move(value);
+  return operand;
+}
+
+Operand compileOperand(const Expr &expr, const ColumnResolver &resolve) {
+  switch (expr.kind) {
+  case ExprKind::Literal:
+    return constantOperand(expr.value);
+
+  case ExprKind::Column: {
+    ResolvedColumn column = resolve(expr.column);
+    Operand operand;
+    operand.eval = [position = column.position,
+                    real = column.affinity == Affinity::Real](
+                       const std::vector<RecordValue> &values,
+                       uint64_t rowid) -> RecordValue {
+      if (position == -1) {
+        return static_cast<int64_t>(rowid);
+      }
+      if (static_cast<size_t>(position) >= values.size()) {
+        return NULL_VALUE;
+      }
+      // REAL columns store integral values as integers on disk
+      const RecordValue &value = values[position];
+      if (const auto *integer = std::get_if<int64_t>(&value); integer && real) {
+        return static_cast<double>(*integer);
+      }
+      return value;
+    };
+    operand.affinity = column.affinity;
+    operand.collation = column.collation;
+    operand.column = column.position;
+    return operand;
+  }
+
+  case ExprKind::Negate: {
+    Operand inner = compileOperand(*expr.operands[0], resolve);
+    if (inner.constant) {
+      return constantOperand(negate(*inner.constant));
+    }
+    Operand operand;
+    operand.eval = [inner = std::move(inner.eval)](
+                       const std::vector<RecordValue> &values,
+                       uint64_t rowid) { return negate(inner(values, rowid)); };
+    return operand;
+  }
+
+  case ExprKind::Arithmetic: {
+    Operand lhs = compileOperand(*expr.operands[0], resolve);
+    Operand rhs = compileOperand(*expr.operands[1], resolve);
+    if (lhs.constant && rhs.constant) {
+      return constantOperand(arithmetic(expr.op, *lhs.constant, *rhs.constant));
+    }
+    Operand operand;
+    operand.eval = [op = expr.op, lhs = std::move(lhs.eval),
+                    rhs = std::move(rhs.eval)](
+                       const std::vector<RecordValue> &values, uint64_t rowid) {
+      return arithmetic(op, lhs(values, rowid), rhs(values, rowid));
+    };
+    return operand;
+  }
+
+  default: {
+    // A boolean used as a value: 1, 0 or NULL
+    auto condition =
+        std::make_shared<Condition>(compileCondition(expr, resolve));
+    Operand operand;
+    operand.eval = [condition](const std::vector<RecordValue> &values,
+                               uint64_t rowid) -> RecordValue {
+      RowBatch batch{{&values}, {rowid}};
+      Selection selection{0};
+      condition->when_true(batch, selection);
+      if (!selection.empty()) {
+        return int64_t{1};
+      }
+      selection = {0};
+      condition->when_false(batch, selection);
+      return selection.empty() ? NULL_VALUE : RecordValue(int64_t{0});
+    };
+    return operand;
+  }
+  }
+}
+
+Condition constantCondition(Truth truth) {
+  return makeCondition([truth](const RowBatch &, uint32_t) { return truth; });
+}
+
+Condition compileCompare(const Expr &expr, const ColumnResolver &resolve) {
+  Operand lhs = compileOperand(*expr.operands[0], resolve);
+  Operand rhs = compileOperand(*expr.operands[1], resolve);
+  ExprOp op = expr.op;
+  if (!lhs.column && lhs.constant && rhs.column) {
+    std::swap(lhs, rhs);
+    op = mirror(op);
+  }
+
+  if (lhs.column && rhs.constant) {
+    // The constant has no affinity of its own, so it takes the column's once
+    RecordValue constant = *rhs.constant;
+    if (isNull(constant)) {
+      return constantCondition(Truth::Null);
+    }
+    ComparisonAffinity affinity(lhs, rhs);
+    applyAffinity(affinity.rhs, constant);
+    return makeCondition([position = *lhs.column,
+                          constant = std::move(constant), op,
+                          collation = affinity.collation](
+                             const RowBatch &batch, uint32_t i) {
+      RecordValue scratch;
+      const RecordValue &value = columnValue(batch, i, position, scratch);
+      if (isNull(value)) {
+        return Truth::Null;
+      }
+      return compareTruth(op, compareRecordValues(value, constant, collation));
+    });
+  }
+
+  ComparisonAffinity affinity(lhs, rhs);
+  return makeCondition([lhs = std::move(lhs), rhs = std::move(rhs), op,
+                        affinity](const RowBatch &batch, uint32_t i) {
+    RecordValue left = evalAt(lhs, batch, i);
+    RecordValue right = evalAt(rhs, batch, i);
+    if (isNull(left) || isNull(right)) {
+      return Truth::Null;
+    }
+    affinity.apply(left, right);
+    return compareTruth(op, affinity.compare(left, right));
+  });
+}
+
+Condition compileIsNull(const Expr &expr, const ColumnResolver &resolve) {
+  Operand operand = compileOperand(*expr.operands[0], resolve);
+  const bool negated = expr.negated;
+  if (operand.column) {
+    return makeCondition([position = *operand.column, negated](
+                             const RowBatch &batch, uint32_t i) {
+      RecordValue scratch;
+      bool null = isNull(columnValue(batch, i, position, scratch));
+      return null != negated ? Truth::True : Truth::False;
+    });
+  }
+  return makeCondition([operand = std::move(operand),
+                        negated](const RowBatch &batch, uint32_t i) {
+    bool null = isNull(evalAt(operand, batch, i));
+    return null != negated ? Truth::True : Truth::False;
+  });
+}
+
+Condition compileInList(const Expr &expr, const ColumnResolver &resolve) {
+  Operand tested = compileOperand(*expr.operands[0], resolve);
+  std::vector<Operand> items;
+  bool all_constant = true;
+  for (size_t i = 1; i < expr.operands.size(); ++i) {
+    items.push_back(compileOperand(*expr.operands[i], resolve));
+    all_constant = all_constant && items.back().constant.has_value();
+  }
+  const bool negated = expr.negated;
+
+  if (!all_constant) {
+    return makeCondition([tested = std::move(tested), items = std::move(items),
+                          negated](const RowBatch &batch, uint32_t i) {
+      RecordValue value = evalAt(tested, batch, i);
+      if (isNull(value)) {
+        return Truth::Null;
+      }
+      bool saw_null = false;
+      for (const auto &item : items) {
+        RecordValue left = value;
+        RecordValue right = evalAt(item, batch, i);
+        if (isNull(right)) {
+          saw_null = true;
+          continue;
+        }
+        ComparisonAffinity affinity(tested, item);
+        affinity.apply(left, right);
+        if (affinity.compare(left, right) == 0) {
+          return invert(Truth::True, negated);
+        }
+      }
+      return saw_null ? Truth::Null : invert(Truth::False, negated);
+    });
+  }
+
+  // Constant lists are converted to the tested value's affinity once and
+  // kept sorted under its collation for binary search.
+  std::vector<RecordValue> values;
+  bool has_null = false;
+  const ComparisonAffinity affinity(tested, Operand{});
+  for (auto &item : items) {
+    RecordValue value = std::move(*item.constant);
+    if (isNull(value)) {
+      has_null = true;
+      continue;
+    }
+    applyAffinity(affinity.rhs, value);
+    values.push_back(std::move(value));
+  }
+  auto less = [affinity](const RecordValue &lhs, const RecordValue &rhs) {
+    return affinity.compare(lhs, rhs) < 0;
+  };
+  std::sort(values.begin(), values.end(), less);
+  values.erase(std::unique(values.begin(), values.end(),
+                           [affinity](const RecordValue &lhs,
+                                      const RecordValue &rhs) {
+                             return affinity.compare(lhs, rhs) == 0;
+                           }),
+               values.end());
+
+  auto lookup = [values = std::move(values), has_null, negated,
+                 less](const RecordValue &value) {
+    if (isNull(value)) {
+      return Truth::Null;
+    }
+    if (std::binary_search(values.begin(), values.end(), value, less)) {
+      return invert(Truth::True, negated);
+    }
+    return has_null ? Truth::Null : invert(Truth::False, negated);
+  };
+
+  if (tested.column) {
+    return makeCondition([position = *tested.column,
+                          lookup](const RowBatch &batch, uint32_t i) {
+      RecordValue scratch;
+      return lookup(columnValue(batch, i, position, scratch));
+    });
+  }
+  return makeCondition([tested = std::move(tested),
+                        lookup](const RowBatch &batch, uint32_t i) {
+    return lookup(evalAt(tested, batch, i));
+  });
+}
+
+Condition compileLike(const Expr &expr, const ColumnResolver &resolve) {
+  Operand tested = compileOperand(*expr.operands[0], resolve);
+  Operand pattern = compileOperand(*expr.operands[1], resolve);
+  const bool negated = expr.negated;
+
+  if (pattern.constant) {
+    if (isNull(*pattern.constant)) {
+      return constantCondition(Truth::Null);
+    }
+    return makeCondition(
+        [tested = std::move(tested),
+         pattern = recordValueToText(*pattern.constant),
+         negated](const RowBatch &batch, uint32_t i) {
+          RecordValue scratch;
+          const RecordValue &value =
+              tested.column && tested.affinity != Affinity::Real
+                  ? columnValue(batch, i, *tested.column, scratch)
+                  : (scratch = evalAt(tested, batch, i));
+          if (isNull(value)) {
+            return Truth::Null;
+          }
+          std::string text;
+          bool match = likeMatch(pattern, likeText(value, text));
+          return invert(match ? Truth::True : Truth::False, negated);
+        });
+  }
+
+  return makeCondition([tested = std::move(tested),
+                        pattern = std::move(pattern),
+                        negated](const RowBatch &batch, uint32_t i) {
+    RecordValue value = evalAt(tested, batch, i);
+    RecordValue like = evalAt(pattern, batch, i);
+    if (isNull(value) || isNull(like)) {
+      return Truth::Null;
+    }
+    std::string text;
+    std::string pattern_text;
+    bool match = likeMatch(likeText(like, pattern_text), likeText(value, text));
+    return invert(match ? Truth::True : Truth::False, negated);
+  });
+}
+
+// AND keeps narrowing the selection by each term's TRUE filter. A row is
+// FALSE as soon as one term is, so each term's FALSE filter only sees the
+// rows that no earlier term has already settled. OR is the mirror image.
+Condition compileJunction(const Expr &expr, const ColumnResolver &resolve) {
+  auto terms = std::make_shared<std::vector<Condition>>();
+  for (const auto &operand : expr.operands) {
+    terms->push_back(compileCondition(*operand, resolve));
+  }
+
+  auto narrow = [terms](Filter Condition::*filter) {
+    return [terms, filter](const RowBatch &batch, Selection &selection) {
+      for (const auto &term : *terms) {
+        if (selection.empty()) {
+          return;
+        }
+        (term.*filter)(batch, selection);
+      }
+    };
+  };
+  auto settle = [terms](Filter Condition::*filter) {
+    return [terms, filter](const RowBatch &batch, Selection &selection) {
+      Selection settled;
+      Selection pending = std::move(selection);
+      for (const auto &term : *terms) {
+        if (pending.empty()) {
+          break;
+        }
+        Selection hits = pending;
+        (term.*filter)(batch, hits);
+        if (hits.empty()) {
+          continue;
+        }
+        Selection rest;
+        std::set_difference(pending.begin(), pending.end(), hits.begin(),
+                            hits.end(), std::back_inserter(rest));
+        Selection merged;
+        std::merge(settled.begin(), settled.end(), hits.begin(), hits.end(),
+                   std::back_inserter(merged));
+        settled = std::move(merged);
+        pending = std::move(rest);
+      }
+      selection = std::move(settled);
+    };
+  };
+
+  if (expr.kind == ExprKind::And) {
+    return {narrow(&Condition::when_true), settle(&Condition::when_false)};
+  }
+  return {settle(&Condition::when_true), narrow(&Condition::when_false)};
+}
+
+Condition compileCondition(const Expr &expr, const ColumnResolver &resolve) {
+  switch (expr.kind) {
+  case ExprKind::Compare:
+    return compileCompare(expr, resolve);
+  case ExprKind::IsNull:
+    return compileIsNull(expr, resolve);
+  case ExprKind::InList:
+    return compileInList(expr, resolve);
+  case ExprKind::Like:
+    return compileLike(expr, resolve);
+  case ExprKind::And:
+  case ExprKind::Or:
+    return compileJunction(expr, resolve);
+  case ExprKind::Not: {
+    Condition inner = compileCondition(*expr.operands[0], resolve);
+    return {std::move(inner.when_false), std::move(inner.when_true)};
+  }
+  default: {
+    // Any other value is tested for truth: non-zero numbers are TRUE
+    Operand operand = compileOperand(expr, resolve);
+    if (operand.constant) {
+      return constantCondition(truthOf(*operand.constant));
+    }
+    return makeCondition(
+        [operand = std::move(operand)](const RowBatch &batch, uint32_t i) {
+          return truthOf(evalAt(operand, batch, i));
+        });
+  }
+  }
+}
+
+} // namespace
+
+Affinity affinityOf(const std::string &declared_type) {
+  if (containsIgnoreCase(declared_type, "INT")) {
+    return Affinity::Integer;
+  }
+  if (containsIgnoreCase(declared_type, "CHAR") ||
+      containsIgnoreCase(declared_type, "CLOB") ||
+      containsIgnoreCase(declared_type, "TEXT")) {
+    return Affinity::Text;
+  }
+  if (declared_type.empty() || containsIgnoreCase(declared_type, "BLOB")) {
+    return Affinity::None;
+  }
+  if (containsIgnoreCase(declared_type, "REAL") ||
+      containsIgnoreCase(declared_type, "FLOA") ||
+      containsIgnoreCase(declared_type, "DOUB")) {
+    return Affinity::Real;
+  }
+  return Affinity::Numeric;
+}
+
+Collation collationOf(const std::string &name) {
+  if (name.empty() || equalsIgnoreCase(name, "binary")) {
+    return Collation::Binary;
+  }
+  if (equalsIgnoreCase(name, "nocase")) {
+    return Collation::NoCase;
+  }
+  if (equalsIgnoreCase(name, "rtrim")) {
+    return Collation::RTrim;
+  }
+  throw std::runtime_error("Unsupported collation: " + name);
+}
+
+void applyAffinity(Affinity affinity, RecordValue &value) {
+  if (isNumeric(affinity)) {
+    if (const auto *text = std::get_if<std::string>(&value)) {
+      if (auto number = parseNumericText(*text)) {
+        value = std::move(*number);
+      }
+    }
+  } else if (affinity == Affinity::Text) {
+    if (std::holds_alternative<int64_t>(value) ||
+        std::holds_alternative<double>(value)) {
+      value = recordValueToText(value);
+    }
+  }
+}
+
+CompiledPredicate::CompiledPredicate(const Expr &expr,
+                                     const ColumnResolver &resolve)
+    : when_true_(compileCondition(expr, resolve).when_true) {}
+
+void CompiledPredicate::filter(const RowBatch &batch,
+                               Selection &selection) const {
+  if (!selection.empty()) {
+    const size_t examined = selection.size();
+    when_true_(batch, selection);
+    countStat(&QueryStats::rows_examined, examined);
+    countStat(&QueryStats::rows_filtered, examined - selection.size());
+  }
+}
+
+bool CompiledPredicate::matches(const std::vector<RecordValue> &values,
+                                uint64_t rowid) const {
+  RowBatch batch{{&values}, {rowid}};
+  Selection selection{0};
+  when_true_(batch, selection);
+  countStat(&QueryStats::rows_examined);
+  countStat(&QueryStats::rows_filtered, selection.empty());
+  return !selection.empty();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include "expression.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Column affinity as SQLite derives it from a declared type; None stands for
+// BLOB affinity and for expressions, which have no affinity at all.
+enum class Affinity { None, Text, Numeric, Integer, Real };
+
+[[nodiscard]] Affinity affinityOf(const std::string &declared_type);
+
+// Converts `value` the way storing it in a column of `affinity` would:
+// well-formed numeric text becomes a number under the numeric affinities,
+// and numbers become text under TEXT affinity.
+void applyAffinity(Affinity affinity, RecordValue &value);
+
+// The built-in collation a COLLATE clause names; empty names BINARY. Throws
+// for collations an application would have to register.
+[[nodiscard]] Collation collationOf(const std::string &name);
+
+struct ResolvedColumn {
+  // Index into the record, or -1 for the rowid
+  int position;
+  Affinity affinity;
+  // How the column's TEXT compares, in WHERE, IN and BETWEEN alike
+  Collation collation{Collation::Binary};
+};
+
+// Maps a column name, as written in the query, to its place in the rows the
+// predicate will see. Throws for names it does not know.
+using ColumnResolver = std::function<ResolvedColumn(const std::string &name)>;
+
+// The decoded records of one leaf page and their rowids
+struct RowBatch {
+  std::vector<const std::vector<RecordValue> *> records;
+  std::vector<uint64_t> rowids;
+};
+
+// Ascending indices into a RowBatch of the rows still under consideration
+using Selection = std::vector<uint32_t>;
+
+// A WHERE expression compiled at prepare time into closures specialised on
+// its operand shapes: column against constant comparisons, IN lists and LIKE
+// patterns are pre-converted once and then tested in place on each record.
+// Every boolean node narrows a selection vector over a whole batch; AND only
+// evaluates its later terms on the rows earlier ones kept, OR only on the
+// rows they rejected, and NULL results follow SQL's three-valued logic.
+class CompiledPredicate {
+public:
+  CompiledPredicate(const Expr &expr, const ColumnResolver &resolve);
+
+  // Narrows `selection` to the rows of `batch` for which the predicate holds.
+  void filter(const RowBatch &batch, Selection &selection) const;
+
+  [[nodiscard]] bool matches(const std::vector<RecordValue> &values,
+                             uint64_t rowid = 0) const;
+
+private:
+  std::function<void(const RowBatch &, Selection &)> when_true_;
+};
@@ -0,0 +1,118 @@
+#include "query_stats.hpp"
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+thread_local PhaseTimer *active_timer = nullptr;
+
+constexpr const char *PHASE_NAMES[QUERY_PHASE_COUNT] = {
+    "parse", "plan", "execute", "io", "decode", "output"};
+
+double toMillis(std::chrono::nanoseconds time) {
+  return std::chrono::duration<double, std::milli>(time).count();
+}
+
+} // namespace
+
+std::string QueryStats::format() const {
+  std::ostringstream out;
+  auto line = [&out](const char *name, uint64_t value) {
+    out << std::left << std::setw(24) << name << value << "\n";
+  };
+
+  line("pages read", pagesRead());
+  line("  interior table", interior_table_pages);
+  line("  leaf table", leaf_table_pages);
+  line("  interior index", interior_index_pages);
+  line("  leaf index", leaf_index_pages);
+  line("  overflow", overflow_pages);
+  line("bytes read", bytes_read);
+  line("cells decoded", cells_decoded);
+  line("records materialized", records_materialized);
+  line("rows examined", rows_examined);
+  line("rows filtered", rows_filtered);
+  line("rows output", rows_output);
+  line("pages prefetched", pages_prefetched);
+  line("prefetch stalls", prefetch_stalls);
+  line("readahead pages", readahead_pages);
+  line("zone pruned pages", pages_pruned);
+  line("bloom rejections", bloom_rejections);
+  line("result cache hits", result_cache_hits);
+
+  PhaseTime total;
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < QUERY_PHASE_COUNT; ++i) {
+    total.wall += phases[i].wall;
+    total.cpu += phases[i].cpu;
+    out << std::left << std::setw(24) << (std::string(PHASE_NAMES[i]) + " ms")
+        << toMillis(phases[i].wall) << " wall, " << toMillis(phases[i].cpu)
+        << " cpu\n";
+  }
+  out << std::left << std::setw(24) << "total ms" << toMillis(total.wall)
+      << " wall, " << toMillis(total.cpu) << " cpu\n";
+  return out.str();
+}
+
+void countPageRead(PageType type) noexcept {
+  switch (type) {
+  case PageType::InteriorTable:
+    countStat(&QueryStats::interior_table_pages);
+    break;
+  case PageType::LeafTable:
+    countStat(&QueryStats::leaf_table_pages);
+    break;
+  case PageType::InteriorIndex:
+    countStat(&QueryStats::interior_index_pages);
+    break;
+  case PageType::LeafIndex:
+    countStat(&QueryStats::leaf_index_pages);
+    break;
+  }
+}
+
+StatsScope::StatsScope(QueryStats &stats) noexcept
+    : previous_(active_query_stats), previous_timer_(active_timer) {
+  active_query_stats = &stats;
+  active_timer = nullptr;
+}
+
+StatsScope::~StatsScope() {
+  active_query_stats = previous_;
+  active_timer = previous_timer_;
+}
+
+PhaseTimer::Sample PhaseTimer::sample() noexcept {
+  timespec cpu{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+  return {std::chrono::steady_clock::now(),
+          std::chrono::seconds(cpu.tv_sec) +
+              std::chrono::nanoseconds(cpu.tv_nsec)};
+}
+
+void PhaseTimer::start() noexcept {
+  Sample now = sample();
+  parent_ = active_timer;
+  if (parent_) {
+    parent_->charge(now);
+  }
+  started_ = now;
+  active_timer = this;
+}
+
+void PhaseTimer::stop() noexcept {
+  Sample now = sample();
+  charge(now);
+  active_timer = parent_;
+  if (parent_) {
+    parent_->started_ = now;
+  }
+}
+
+void PhaseTimer::charge(const Sample &now) noexcept {
+  PhaseTime &time = stats_->phase(phase_);
+  time.wall += now.wall - started_.wall;
+  time.cpu += now.cpu - started_.cpu;
+  started_ = now;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "btree_common.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum class QueryPhase { Parse, Plan, Execute, IO, Decode, Output };
+
+constexpr size_t QUERY_PHASE_COUNT = 6;
+
+struct PhaseTime {
+  std::chrono::nanoseconds wall{0};
+  std::chrono::nanoseconds cpu{0};
+};
+
+// Counters one query accumulates while a StatsScope points at it. Phase
+// times are exclusive: time spent in a nested phase (say, reading a page
+// while planning) is charged to the nested phase only.
+struct QueryStats {
+  uint64_t interior_table_pages{0};
+  uint64_t leaf_table_pages{0};
+  uint64_t interior_index_pages{0};
+  uint64_t leaf_index_pages{0};
+  uint64_t overflow_pages{0};
+  uint64_t bytes_read{0};
+  uint64_t cells_decoded{0};
+  uint64_t records_materialized{0};
+  // Rows the WHERE predicate was evaluated on, and how many it rejected
+  uint64_t rows_examined{0};
+  uint64_t rows_filtered{0};
+  uint64_t rows_output{0};
+  // Page reads issued ahead of a scan, and how often the scan caught up
+  // with one still in flight
+  uint64_t pages_prefetched{0};
+  uint64_t prefetch_stalls{0};
+  // Pages hinted to the kernel for readahead, gaps in runs included
+  uint64_t readahead_pages{0};
+  // Subtrees skipped because their zones rule out the filter
+  uint64_t pages_pruned{0};
+  // Seeks and rowid lookups a Bloom filter answered without reading a page
+  uint64_t bloom_rejections{0};
+  // Queries answered from the result cache, reading no pages
+  uint64_t result_cache_hits{0};
+  std::array<PhaseTime, QUERY_PHASE_COUNT> phases{};
+
+  [[nodiscard]] uint64_t pagesRead() const noexcept {
+    return interior_table_pages + leaf_table_pages + interior_index_pages +
+           leaf_index_pages + overflow_pages;
+  }
+
+  [[nodiscard]] PhaseTime &phase(QueryPhase phase) noexcept {
+    return phases[static_cast<size_t>(phase)];
+  }
+
+  // Human-readable report, one counter per line
+  [[nodiscard]] std::string format() const;
+};
+
+// Stats of the query running on this thread, if any
+inline thread_local QueryStats *active_query_stats = nullptr;
+
+inline void countStat(uint64_t QueryStats::*counter, uint64_t n = 1) noexcept {
+  if (QueryStats *stats = active_query_stats) {
+    stats->*counter += n;
+  }
+}
+
+// Counts a visit to a B-tree page of the given type
+void countPageRead(PageType type) noexcept;
+
+// Collects the current thread's counters into `stats` for its lifetime.
+class StatsScope {
+public:
+  explicit StatsScope(QueryStats &stats) noexcept;
+  ~StatsScope();
+
+  StatsScope(const StatsScope &) = delete;
+  StatsScope &operator=(const StatsScope &) = delete;
+
+private:
+  QueryStats *previous_;
+  class PhaseTimer *previous_timer_;
+};
+
+// Charges the wall and CPU time of its lifetime to a phase, pausing the
+// enclosing timer meanwhile. Does nothing when no StatsScope is active.
+class PhaseTimer {
+public:
+  explicit PhaseTimer(QueryPhase phase) noexcept
+      : stats_(active_query_stats), phase_(phase) {
+    if (stats_) {
+      start();
+    }
+  }
+  ~PhaseTimer() {
+    if (stats_) {
+      stop();
+    }
+  }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+  friend class StatsScope;
+
+  struct Sample {
+    std::chrono::steady_clock::time_point wall;
+    std::chrono::nanoseconds cpu;
+  };
+
+  static Sample sample() noexcept;
+  void start() noexcept;
+  void stop() noexcept;
+  void charge(const Sample &now) noexcept;
+
+  QueryStats *stats_;
+  QueryPhase phase_;
+  PhaseTimer *parent_{nullptr};
+  Sample started_{};
+};
@@ -0,0 +1,183 @@
+#include "resident_tree.hpp"
+#include "debug.hpp"
+#include "sqlite_constants.hpp"
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Heap bytes of a string; short ones live inline
+uint64_t textBytes(const std::string &text) {
+  return text.capacity() > std::string().capacity() ? text.capacity() : 0;
+}
+
+uint64_t valueBytes(const RecordValue &value) {
+  if (const auto *text = std::get_if<std::string>(&value)) {
+    return textBytes(*text);
+  }
+  if (const auto *blob = std::get_if<std::vector<uint8_t>>(&value)) {
+    return blob->capacity();
+  }
+  return 0;
+}
+
+} // namespace
+
+std::string ResidentFootprint::format() const {
+  std::ostringstream out;
+  auto line = [&out](const char *name, uint64_t value) {
+    out << std::left << std::setw(24) << name << value << "\n";
+  };
+
+  line("resident pages", pages);
+  line("resident cells", cells);
+  line("page bytes", page_bytes);
+  line("record bytes", record_bytes);
+  line("index bytes", index_bytes);
+  line("total bytes", totalBytes());
+  return out.str();
+}
+
+ResidentTree::ResidentTree(const FileReader &reader, uint16_t page_size)
+    : page_size_(page_size), nodes_(reader.size() / page_size + 1) {
+  // The schema is itself a table tree whose rows name every other root
+  load(reader, sqlite::SCHEMA_PAGE);
+  std::vector<uint32_t> roots;
+  std::vector<const ResidentNode *> pending{node(sqlite::SCHEMA_PAGE)};
+  while (!pending.empty()) {
+    const ResidentNode *schema = pending.back();
+    pending.pop_back();
+    if (schema == nullptr) {
+      continue;
+    }
+    pending.insert(pending.end(), schema->children.begin(),
+                   schema->children.end());
+    for (const auto &record : schema->records) {
+      if (record.size() <= sqlite::schema::ROOTPAGE) {
+        continue;
+      }
+      if (const auto *root =
+              std::get_if<int64_t>(&record[sqlite::schema::ROOTPAGE])) {
+        roots.push_back(static_cast<uint32_t>(*root));
+      }
+    }
+  }
+  for (uint32_t root : roots) {
+    load(reader, root);
+  }
+
+  footprint_.index_bytes += nodes_.capacity() * sizeof(ResidentNode);
+  LOG_INFO("Loaded " << footprint_.pages << " resident pages, "
+                     << footprint_.totalBytes() << " bytes");
+}
+
+void ResidentTree::load(const FileReader &reader, uint32_t page_number) {
+  if (page_number == 0 || page_number >= nodes_.size() ||
+      nodes_[page_number].page.index() != 0) {
+    return;
+  }
+
+  ResidentNode &node = nodes_[page_number];
+  reader.seekToPage(page_number, page_size_);
+  node.type = static_cast<PageType>(reader.readU8());
+
+  switch (node.type) {
+  case PageType::LeafTable:
+    decode<PageType::LeafTable>(reader, node, page_number);
+    return;
+  case PageType::LeafIndex:
+    decode<PageType::LeafIndex>(reader, node, page_number);
+    return;
+  case PageType::InteriorTable: {
+    const auto &page =
+        decode<PageType::InteriorTable>(reader, node, page_number);
+    node.children.reserve(page.getCells().size() + 1);
+    for (const auto &cell : page.getCells()) {
+      node.children.push_back(slot(cell.left_pointer));
+    }
+    node.children.push_back(slot(page.getHeader().right_most_pointer));
+    footprint_.index_bytes += node.children.capacity() * sizeof(void *);
+
+    for (const auto &cell : page.getCells()) {
+      load(reader, cell.left_pointer);
+    }
+    load(reader, page.getHeader().right_most_pointer);
+    return;
+  }
+  case PageType::InteriorIndex: {
+    const auto &page =
+        decode<PageType::InteriorIndex>(reader, node, page_number);
+    node.children.reserve(page.getCells().size() + 1);
+    for (const auto &cell : page.getCells()) {
+      node.children.push_back(slot(cell.page_number));
+    }
+    node.children.push_back(slot(page.getHeader().right_most_pointer));
+    footprint_.index_bytes += node.children.capacity() * sizeof(void *);
+
+    for (const auto &cell : page.getCells()) {
+      load(reader, cell.page_number);
+    }
+    load(reader, page.getHeader().right_most_pointer);
+    return;
+  }
+  }
+  throw std::runtime_error("Invalid page type on page " +
+                           std::to_string(page_number));
+}
+
+template <PageType T>
+const BTreePage<T> &ResidentTree::decode(const FileReader &reader,
+                                         ResidentNode &node,
+                                         uint32_t page_number) {
+  auto page = std::make_shared<const BTreePage<T>>(reader, page_size_,
+                                                   page_number);
+  node.page = page;
+
+  ++footprint_.pages;
+  footprint_.cells += page->getCells().size();
+  footprint_.page_bytes +=
+      sizeof(BTreePage<T>) +
+      page->getCells().capacity() * sizeof(typename BTreePage<T>::Cell);
+  for (const auto &cell : page->getCells()) {
+    footprint_.page_bytes += cell.payload.capacity();
+  }
+
+  if constexpr (PageTraits<T>::is_table) {
+    node.keys.reserve(page->getCells().size());
+    for (const auto &cell : page->getCells()) {
+      if constexpr (PageTraits<T>::is_leaf) {
+        node.keys.push_back(cell.row_id);
+      } else {
+        node.keys.push_back(cell.interior_row_id);
+      }
+    }
+    footprint_.index_bytes += node.keys.capacity() * sizeof(uint64_t);
+  }
+
+  if constexpr (T != PageType::InteriorTable) {
+    node.records.reserve(page->getCells().size());
+    if constexpr (PageTraits<T>::is_index) {
+      node.normalized.reserve(page->getCells().size());
+      node.prefixes.reserve(page->getCells().size());
+    }
+    for (const auto &cell : page->getCells()) {
+      node.records.push_back(BTreeRecord(cell.payload).getValues());
+      const auto &values = node.records.back();
+      footprint_.record_bytes += values.capacity() * sizeof(RecordValue);
+      for (const auto &value : values) {
+        footprint_.record_bytes += valueBytes(value);
+      }
+      if constexpr (PageTraits<T>::is_index) {
+        const auto &key =
+            node.normalized.emplace_back(NormalizedKey::encode(values));
+        node.prefixes.push_back(NormalizedKey::prefix(key));
+        footprint_.record_bytes += textBytes(key);
+      }
+    }
+    footprint_.record_bytes +=
+        node.records.capacity() * sizeof(std::vector<RecordValue>) +
+        node.normalized.capacity() * sizeof(std::string);
+    footprint_.index_bytes += node.prefixes.capacity() * sizeof(uint64_t);
+  }
+  return *page;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "btree_page.hpp"
+#include "btree_record.hpp"
+#include "file_reader.hpp"
+#include "normalized_key.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+// One B-tree page of a resident database, decoded once when it was loaded.
+struct ResidentNode {
+  PageType type{};
+  // The decoded page; holds the alternative matching `type`
+  std::variant<std::monostate,
+               std::shared_ptr<const BTreePage<PageType::InteriorIndex>>,
+               std::shared_ptr<const BTreePage<PageType::InteriorTable>>,
+               std::shared_ptr<const BTreePage<PageType::LeafIndex>>,
+               std::shared_ptr<const BTreePage<PageType::LeafTable>>>
+      page;
+  // The cells' records, in cell order; interior table cells have none
+  std::vector<std::vector<RecordValue>> records;
+  // Table pages: the rowids (separators on interior pages) in one dense
+  // array, searched with searchKeys
+  std::vector<uint64_t> keys;
+  // Index pages: each key as a NormalizedKey, and the first 8 bytes of
+  // those in one dense array, so that searches compare no records
+  std::vector<std::string> normalized;
+  std::vector<uint64_t> prefixes;
+  // Interior pages: the child left of each cell, then the right-most child,
+  // linked directly (null where the page has no such child)
+  std::vector<const ResidentNode *> children;
+
+  // The decoded page if it is of type T, null otherwise
+  template <PageType T>
+  [[nodiscard]] const BTreePage<T> *pageAs() const noexcept {
+    auto *decoded =
+        std::get_if<std::shared_ptr<const BTreePage<T>>>(&page);
+    return decoded ? decoded->get() : nullptr;
+  }
+
+  [[nodiscard]] size_t cellCount() const noexcept {
+    return type == PageType::InteriorTable ? keys.size() : records.size();
+  }
+};
+
+struct ResidentFootprint {
+  uint64_t pages{0};
+  uint64_t cells{0};
+  // Decoded pages and cells, payloads included
+  uint64_t page_bytes{0};
+  // Records split into values, and index keys normalized
+  uint64_t record_bytes{0};
+  // Key, prefix and child arrays
+  uint64_t index_bytes{0};
+
+  [[nodiscard]] uint64_t totalBytes() const noexcept {
+    return page_bytes + record_bytes + index_bytes;
+  }
+
+  // Human-readable report, one figure per line
+  [[nodiscard]] std::string format() const;
+};
+
+// Every table and index B-tree of a database (and the schema), decoded into
+// memory so that queries read and decode no pages at all. Nodes are indexed
+// by page number and never move once loaded.
+class ResidentTree {
+public:
+  ResidentTree(const FileReader &reader, uint16_t page_size);
+
+  [[nodiscard]] const ResidentNode *node(uint32_t page_number) const noexcept {
+    if (page_number >= nodes_.size() ||
+        nodes_[page_number].page.index() == 0) {
+      return nullptr;
+    }
+    return &nodes_[page_number];
+  }
+
+  // The page if it is resident and of type T; null otherwise
+  template <PageType T>
+  [[nodiscard]] std::shared_ptr<const BTreePage<T>>
+  page(uint32_t page_number) const noexcept {
+    const ResidentNode *resident = node(page_number);
+    if (resident == nullptr) {
+      return nullptr;
+    }
+    auto *page = std::get_if<std::shared_ptr<const BTreePage<T>>>(
+        &resident->page);
+    return page ? *page : nullptr;
+  }
+
+  [[nodiscard]] const ResidentFootprint &footprint() const noexcept {
+    return footprint_;
+  }
+
+private:
+  // Where the page's node is or will be loaded; null for page 0
+  const ResidentNode *slot(uint32_t page_number) const noexcept {
+    return page_number != 0 && page_number < nodes_.size()
+               ? &nodes_[page_number]
+               : nullptr;
+  }
+
+  void load(const FileReader &reader, uint32_t page_number);
+
+  template <PageType T>
+  const BTreePage<T> &decode(const FileReader &reader, ResidentNode &node,
+                             uint32_t page_number);
+
+  uint16_t page_size_;
+  std::vector<ResidentNode> nodes_;
+  ResidentFootprint footprint_;
+};
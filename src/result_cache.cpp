@@ -0,0 +1,170 @@
+#include "result_cache.hpp"
+#include "debug.hpp"
+#include "sorter.hpp"
+
+namespace {
+
+// Length-prefixed, so that no text can run into the next field
+void appendText(std::string &out, const std::string &text) {
+  out += std::to_string(text.size());
+  out += ':';
+  out += text;
+}
+
+template <typename T> void appendRaw(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Values are kept apart by type and exact bits: 5 and 5.0 compare equal but
+// do not always select the same rows
+void appendParameter(std::string &out, const RecordValue &value) {
+  out += static_cast<char>(value.index());
+  if (const auto *integer = std::get_if<int64_t>(&value)) {
+    appendRaw(out, *integer);
+  } else if (const auto *real = std::get_if<double>(&value)) {
+    appendRaw(out, *real);
+  } else if (const auto *text = std::get_if<std::string>(&value)) {
+    appendText(out, *text);
+  } else if (const auto *blob = std::get_if<std::vector<uint8_t>>(&value)) {
+    appendText(out, std::string(blob->begin(), blob->end()));
+  }
+}
+
+void appendExpr(std::string &shape, std::string &parameters,
+                const Expr &expr) {
+  if (expr.kind == ExprKind::Literal) {
+    shape += '?';
+    appendParameter(parameters, expr.value);
+    return;
+  }
+  shape += '(';
+  shape += std::to_string(static_cast<int>(expr.kind));
+  shape += ',';
+  shape += std::to_string(static_cast<int>(expr.op));
+  shape += expr.negated ? ",!" : ",";
+  appendText(shape, expr.column);
+  for (const auto &operand : expr.operands) {
+    appendExpr(shape, parameters, *operand);
+  }
+  shape += ')';
+}
+
+size_t resultBytes(const sqlite::QueryResult &rows) {
+  size_t bytes = 0;
+  for (const auto &row : rows) {
+    bytes += ExternalSorter::estimateRowBytes(row);
+  }
+  return bytes;
+}
+
+} // namespace
+
+std::string ResultCache::keyOf(const SelectStatement &stmt) {
+  std::string shape;
+  std::string parameters;
+  appendText(shape, stmt.table_name);
+  appendText(shape, stmt.table_alias);
+  shape += stmt.is_count_star ? "*" : "";
+  for (const auto &column : stmt.column_names) {
+    appendText(shape, column);
+  }
+  for (const auto &aggregate : stmt.aggregates) {
+    shape += aggregate.function == AggregateFunction::Min ? "<" : ">";
+    appendText(shape, aggregate.column);
+  }
+  if (stmt.join) {
+    shape += stmt.join->type == JoinType::Left ? "L" : "J";
+    appendText(shape, stmt.join->table_name);
+    appendText(shape, stmt.join->alias);
+    appendText(shape, stmt.join->left_column);
+    appendText(shape, stmt.join->right_column);
+  }
+  shape += 'W';
+  if (stmt.where_clause) {
+    appendExpr(shape, parameters, *stmt.where_clause);
+  }
+  for (const auto &term : stmt.order_by) {
+    shape += term.descending ? "D" : "A";
+    appendText(shape, term.column);
+  }
+  shape += 'L';
+  for (const auto &bound : {stmt.limit, stmt.offset}) {
+    appendParameter(parameters,
+                    bound ? RecordValue(static_cast<int64_t>(*bound))
+                          : RecordValue());
+  }
+  return shape + '\0' + parameters;
+}
+
+void ResultCache::setBudget(size_t bytes) {
+  budget_ = bytes;
+  if (budget_ == 0) {
+    clear();
+    return;
+  }
+  evictFor(0);
+}
+
+const sqlite::QueryResult *ResultCache::find(const std::string &key) {
+  DataVersion version = reader_.dataVersion();
+  if (version_ != version) {
+    if (!entries_.empty()) {
+      LOG_INFO("Database changed; dropping cached results");
+    }
+    clear();
+    version_ = version;
+  }
+
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  Entry &entry = it->second;
+  auto node = queue_.extract(entry.slot);
+  node.key() = clock_ + entry.weight;
+  entry.slot = queue_.insert(std::move(node));
+  return &entry.rows;
+}
+
+void ResultCache::insert(std::string key, const sqlite::QueryResult &rows,
+                         std::chrono::nanoseconds cost) {
+  if (!enabled() || !version_) {
+    return;
+  }
+  size_t bytes = sizeof(Entry) + key.size() + resultBytes(rows);
+  if (bytes > budget_) {
+    LOG_INFO("Result of " << bytes << " bytes exceeds the cache budget");
+    return;
+  }
+  if (auto it = entries_.find(key); it != entries_.end()) {
+    used_ -= it->second.bytes;
+    queue_.erase(it->second.slot);
+    entries_.erase(it);
+  }
+  evictFor(bytes);
+
+  double weight =
+      static_cast<double>(cost.count()) / static_cast<double>(bytes);
+  auto it = entries_.emplace(std::move(key), Entry{rows, bytes, weight}).first;
+  it->second.slot = queue_.emplace(clock_ + weight, &it->first);
+  used_ += bytes;
+}
+
+void ResultCache::evictFor(size_t bytes) {
+  while (used_ + bytes > budget_ && !queue_.empty()) {
+    auto victim = queue_.begin();
+    // Entries left behind age relative to newcomers
+    clock_ = victim->first;
+    auto it = entries_.find(*victim->second);
+    used_ -= it->second.bytes;
+    queue_.erase(victim);
+    entries_.erase(it);
+  }
+}
+
+void ResultCache::clear() {
+  queue_.clear();
+  entries_.clear();
+  used_ = 0;
+  clock_ = 0;
+}
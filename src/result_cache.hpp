@@ -0,0 +1,69 @@
+#pragma once
+
+#include "file_reader.hpp"
+#include "sql_parser.hpp"
+#include "sqlite_constants.hpp"
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Results of SELECTs, for statements that are issued again and again. An
+// entry is keyed by the statement's normalized shape, with its literals
+// taken out as parameters, and by those parameters' exact values. Entries
+// hold while the data version does, and are all dropped once it moves.
+//
+// Within the budget, entries are evicted by GreedyDual-Size: an entry's
+// priority is the cache's clock plus the time it took to compute per byte
+// it holds, renewed on every hit, and evicting an entry advances the clock
+// to its priority. Cheap, large results go first, and expensive ones are
+// kept until they go unused for long.
+class ResultCache {
+public:
+  explicit ResultCache(const FileReader &reader) noexcept : reader_(reader) {}
+
+  // Zero, the default, turns caching off and drops every entry
+  void setBudget(size_t bytes);
+
+  [[nodiscard]] bool enabled() const noexcept { return budget_ > 0; }
+
+  [[nodiscard]] static std::string keyOf(const SelectStatement &stmt);
+
+  // The cached result, once the data version is checked; null on a miss.
+  // It stays valid until the next call.
+  const sqlite::QueryResult *find(const std::string &key);
+
+  // Caches a result that took `cost` to compute, evicting others to make
+  // room. Results are taken to be of the data version the last find() saw.
+  void insert(std::string key, const sqlite::QueryResult &rows,
+              std::chrono::nanoseconds cost);
+
+  [[nodiscard]] size_t memoryBytes() const noexcept { return used_; }
+
+private:
+  // Keys of the entries by priority, lowest first, pointing into entries_
+  using EvictionQueue = std::multimap<double, const std::string *>;
+
+  struct Entry {
+    sqlite::QueryResult rows;
+    size_t bytes{0};
+    // Nanoseconds of work per byte held
+    double weight{0};
+    // Where the entry sits in queue_, keyed by its priority
+    EvictionQueue::iterator slot{};
+  };
+
+  // Evicts the entries of lowest priority until `bytes` more fit
+  void evictFor(size_t bytes);
+  void clear();
+
+  const FileReader &reader_;
+  size_t budget_{0};
+  std::optional<DataVersion> version_;
+  std::unordered_map<std::string, Entry> entries_;
+  EvictionQueue queue_;
+  double clock_{0};
+  size_t used_{0};
+};
@@ -0,0 +1,80 @@
+#include "resume_token.hpp"
+#include "value_codec.hpp"
+#include <stdexcept>
+
+namespace {
+
+constexpr uint8_t TOKEN_VERSION = 1;
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+int hexValue(char digit) {
+  if (digit >= '0' && digit <= '9') {
+    return digit - '0';
+  }
+  if (digit >= 'a' && digit <= 'f') {
+    return digit - 'a' + 10;
+  }
+  throw std::runtime_error("Malformed resume token");
+}
+
+} // namespace
+
+std::string encodeResumeToken(const ResumePosition &position) {
+  std::vector<uint8_t> bytes;
+  bytes.push_back(TOKEN_VERSION);
+  value_codec::appendU64(bytes, position.rowid);
+  value_codec::appendU64(bytes, position.index_entry.size());
+  for (const auto &value : position.index_entry) {
+    value_codec::appendValue(bytes, value);
+  }
+
+  std::string token;
+  token.reserve(bytes.size() * 2);
+  for (uint8_t byte : bytes) {
+    token.push_back(HEX_DIGITS[byte >> 4]);
+    token.push_back(HEX_DIGITS[byte & 0x0F]);
+  }
+  return token;
+}
+
+ResumePosition decodeResumeToken(const std::string &token) {
+  if (token.size() % 2 != 0) {
+    throw std::runtime_error("Malformed resume token");
+  }
+
+  std::vector<uint8_t> bytes;
+  bytes.reserve(token.size() / 2);
+  for (size_t i = 0; i < token.size(); i += 2) {
+    bytes.push_back(
+        static_cast<uint8_t>(hexValue(token[i]) << 4 | hexValue(token[i + 1])));
+  }
+
+  ByteReader reader(std::move(bytes));
+  auto need = [&reader](size_t length) {
+    if (reader.remaining() < length) {
+      throw std::runtime_error("Malformed resume token");
+    }
+  };
+
+  need(1 + 2 * sizeof(uint64_t));
+  if (reader.readU8() != TOKEN_VERSION) {
+    throw std::runtime_error("Unsupported resume token version");
+  }
+
+  ResumePosition position;
+  position.rowid = reader.readU64();
+  uint64_t value_count = reader.readU64();
+
+  for (uint64_t i = 0; i < value_count; ++i) {
+    auto value = value_codec::readValue(reader);
+    if (!value) {
+      throw std::runtime_error("Malformed resume token");
+    }
+    position.index_entry.push_back(std::move(*value));
+  }
+
+  if (!reader.eof()) {
+    throw std::runtime_error("Malformed resume token");
+  }
+  return position;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Position of the last row of a page in a keyset-paginated query. Rowid
+// ordered scans resume after `rowid`; index ordered scans resume after the
+// full index entry (key columns followed by the rowid).
+struct ResumePosition {
+  uint64_t rowid{0};
+  std::vector<RecordValue> index_entry;
+
+  [[nodiscard]] bool isIndexPosition() const noexcept {
+    return !index_entry.empty();
+  }
+};
+
+// Tokens are opaque hex strings; decoding throws std::runtime_error on
+// anything that was not produced by encodeResumeToken.
+[[nodiscard]] std::string encodeResumeToken(const ResumePosition &position);
+[[nodiscard]] ResumePosition decodeResumeToken(const std::string &token);
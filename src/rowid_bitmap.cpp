@@ -0,0 +1,249 @@
+#include "rowid_bitmap.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+constexpr uint64_t LOW_BITS = 16;
+constexpr uint64_t LOW_MASK = 0xFFFF;
+
+} // namespace
+
+bool RowidBitmap::Container::contains(uint16_t low) const noexcept {
+  if (isBitset()) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+  }
+  return std::binary_search(array.begin(), array.end(), low);
+}
+
+std::optional<uint16_t>
+RowidBitmap::Container::nextAtOrAfter(uint16_t low) const noexcept {
+  if (!isBitset()) {
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    return it == array.end() ? std::nullopt : std::optional<uint16_t>(*it);
+  }
+
+  size_t word = low >> 6;
+  uint64_t bits_left = bits[word] & (~uint64_t{0} << (low & 63));
+  while (true) {
+    if (bits_left != 0) {
+      return static_cast<uint16_t>(word * 64 + std::countr_zero(bits_left));
+    }
+    if (++word == BITSET_WORDS) {
+      return std::nullopt;
+    }
+    bits_left = bits[word];
+  }
+}
+
+void RowidBitmap::Container::add(uint16_t low) {
+  if (isBitset()) {
+    uint64_t &word = bits[low >> 6];
+    uint64_t mask = uint64_t{1} << (low & 63);
+    cardinality += (word & mask) == 0;
+    word |= mask;
+    return;
+  }
+
+  // Rowids mostly arrive in ascending order, so try the end first
+  if (array.empty() || array.back() < low) {
+    array.push_back(low);
+  } else {
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (*it == low) {
+      return;
+    }
+    array.insert(it, low);
+  }
+  ++cardinality;
+  if (cardinality > ARRAY_LIMIT) {
+    normalize();
+  }
+}
+
+void RowidBitmap::Container::normalize() {
+  if (cardinality > ARRAY_LIMIT && !isBitset()) {
+    bits.assign(BITSET_WORDS, 0);
+    for (uint16_t low : array) {
+      bits[low >> 6] |= uint64_t{1} << (low & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+  } else if (cardinality <= ARRAY_LIMIT && isBitset()) {
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+      for (uint64_t w = bits[word]; w != 0; w &= w - 1) {
+        array.push_back(static_cast<uint16_t>(word * 64 + std::countr_zero(w)));
+      }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+  }
+}
+
+RowidBitmap::Container RowidBitmap::intersect(const Container &lhs,
+                                              const Container &rhs) {
+  Container result{lhs.key, {}, {}, 0};
+  if (lhs.isBitset() && rhs.isBitset()) {
+    result.bits.resize(BITSET_WORDS);
+    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+      result.bits[word] = lhs.bits[word] & rhs.bits[word];
+      result.cardinality += std::popcount(result.bits[word]);
+    }
+  } else if (!lhs.isBitset() && !rhs.isBitset()) {
+    std::set_intersection(lhs.array.begin(), lhs.array.end(),
+                          rhs.array.begin(), rhs.array.end(),
+                          std::back_inserter(result.array));
+    result.cardinality = static_cast<uint32_t>(result.array.size());
+  } else {
+    const Container &sparse = lhs.isBitset() ? rhs : lhs;
+    const Container &dense = lhs.isBitset() ? lhs : rhs;
+    for (uint16_t low : sparse.array) {
+      if (dense.contains(low)) {
+        result.array.push_back(low);
+      }
+    }
+    result.cardinality = static_cast<uint32_t>(result.array.size());
+  }
+  result.normalize();
+  return result;
+}
+
+RowidBitmap::Container RowidBitmap::unite(const Container &lhs,
+                                          const Container &rhs) {
+  if (!lhs.isBitset() && !rhs.isBitset()) {
+    Container result{lhs.key, {}, {}, 0};
+    std::set_union(lhs.array.begin(), lhs.array.end(), rhs.array.begin(),
+                   rhs.array.end(), std::back_inserter(result.array));
+    result.cardinality = static_cast<uint32_t>(result.array.size());
+    result.normalize();
+    return result;
+  }
+
+  Container result = lhs.isBitset() ? lhs : rhs;
+  const Container &other = lhs.isBitset() ? rhs : lhs;
+  if (other.isBitset()) {
+    result.cardinality = 0;
+    for (size_t word = 0; word < BITSET_WORDS; ++word) {
+      result.bits[word] |= other.bits[word];
+      result.cardinality += std::popcount(result.bits[word]);
+    }
+  } else {
+    for (uint16_t low : other.array) {
+      result.add(low);
+    }
+  }
+  return result;
+}
+
+const RowidBitmap::Container *
+RowidBitmap::find(uint64_t key) const noexcept {
+  auto it = std::lower_bound(
+      containers_.begin(), containers_.end(), key,
+      [](const Container &container, uint64_t k) { return container.key < k; });
+  return it != containers_.end() && it->key == key ? &*it : nullptr;
+}
+
+void RowidBitmap::add(uint64_t rowid) {
+  uint64_t key = rowid >> LOW_BITS;
+  auto low = static_cast<uint16_t>(rowid & LOW_MASK);
+
+  if (containers_.empty() || containers_.back().key < key) {
+    containers_.push_back({key, {}, {}, 0});
+    containers_.back().add(low);
+    return;
+  }
+  auto it = std::lower_bound(
+      containers_.begin(), containers_.end(), key,
+      [](const Container &container, uint64_t k) { return container.key < k; });
+  if (it->key != key) {
+    it = containers_.insert(it, {key, {}, {}, 0});
+  }
+  it->add(low);
+}
+
+bool RowidBitmap::contains(uint64_t rowid) const noexcept {
+  const Container *container = find(rowid >> LOW_BITS);
+  return container != nullptr &&
+         container->contains(static_cast<uint16_t>(rowid & LOW_MASK));
+}
+
+std::optional<uint64_t>
+RowidBitmap::nextAtOrAfter(uint64_t rowid) const noexcept {
+  uint64_t key = rowid >> LOW_BITS;
+  auto it = std::lower_bound(
+      containers_.begin(), containers_.end(), key,
+      [](const Container &container, uint64_t k) { return container.key < k; });
+  for (; it != containers_.end(); ++it) {
+    auto from =
+        static_cast<uint16_t>(it->key == key ? rowid & LOW_MASK : 0);
+    if (auto low = it->nextAtOrAfter(from)) {
+      return (it->key << LOW_BITS) | *low;
+    }
+  }
+  return std::nullopt;
+}
+
+bool RowidBitmap::intersects(uint64_t min, uint64_t max) const noexcept {
+  auto next = nextAtOrAfter(min);
+  return next && *next <= max;
+}
+
+uint64_t RowidBitmap::cardinality() const noexcept {
+  uint64_t total = 0;
+  for (const auto &container : containers_) {
+    total += container.cardinality;
+  }
+  return total;
+}
+
+size_t RowidBitmap::memoryBytes() const noexcept {
+  size_t bytes = containers_.capacity() * sizeof(Container);
+  for (const auto &container : containers_) {
+    bytes += container.array.capacity() * sizeof(uint16_t) +
+             container.bits.capacity() * sizeof(uint64_t);
+  }
+  return bytes;
+}
+
+RowidBitmap &RowidBitmap::operator&=(const RowidBitmap &other) {
+  std::vector<Container> result;
+  auto lhs = containers_.begin();
+  auto rhs = other.containers_.begin();
+  while (lhs != containers_.end() && rhs != other.containers_.end()) {
+    if (lhs->key < rhs->key) {
+      ++lhs;
+    } else if (rhs->key < lhs->key) {
+      ++rhs;
+    } else {
+      Container both = intersect(*lhs, *rhs);
+      if (both.cardinality > 0) {
+        result.push_back(std::move(both));
+      }
+      ++lhs;
+      ++rhs;
+    }
+  }
+  containers_ = std::move(result);
+  return *this;
+}
+
+RowidBitmap &RowidBitmap::operator|=(const RowidBitmap &other) {
+  std::vector<Container> result;
+  result.reserve(containers_.size() + other.containers_.size());
+  auto lhs = containers_.begin();
+  auto rhs = other.containers_.begin();
+  while (lhs != containers_.end() || rhs != other.containers_.end()) {
+    if (rhs == other.containers_.end() ||
+        (lhs != containers_.end() && lhs->key < rhs->key)) {
+      result.push_back(std::move(*lhs++));
+    } else if (lhs == containers_.end() || rhs->key < lhs->key) {
+      result.push_back(*rhs++);
+    } else {
+      result.push_back(unite(*lhs++, *rhs++));
+    }
+  }
+  containers_ = std::move(result);
+  return *this;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Compressed rowid set in the style of Roaring bitmaps. Rowids are grouped
+// by their upper 48 bits; each group keeps its low 16-bit halves as a sorted
+// array while sparse and switches to an 8KB bitset once it holds more than
+// ARRAY_LIMIT of them.
+class RowidBitmap {
+public:
+  void add(uint64_t rowid);
+
+  [[nodiscard]] bool contains(uint64_t rowid) const noexcept;
+
+  // Smallest member that is >= `rowid`
+  [[nodiscard]] std::optional<uint64_t>
+  nextAtOrAfter(uint64_t rowid) const noexcept;
+
+  // Whether any member lies in [min, max]
+  [[nodiscard]] bool intersects(uint64_t min, uint64_t max) const noexcept;
+
+  [[nodiscard]] uint64_t cardinality() const noexcept;
+  [[nodiscard]] bool empty() const noexcept { return containers_.empty(); }
+  [[nodiscard]] size_t memoryBytes() const noexcept;
+
+  RowidBitmap &operator&=(const RowidBitmap &other);
+  RowidBitmap &operator|=(const RowidBitmap &other);
+
+private:
+  static constexpr uint32_t ARRAY_LIMIT = 4096;
+  static constexpr size_t BITSET_WORDS = 65536 / 64;
+
+  struct Container {
+    uint64_t key; // rowid >> 16
+    // Sorted low halves, used while the container is sparse
+    std::vector<uint16_t> array;
+    // BITSET_WORDS words once it is dense, empty otherwise
+    std::vector<uint64_t> bits;
+    uint32_t cardinality{0};
+
+    [[nodiscard]] bool isBitset() const noexcept { return !bits.empty(); }
+    [[nodiscard]] bool contains(uint16_t low) const noexcept;
+    [[nodiscard]] std::optional<uint16_t>
+    nextAtOrAfter(uint16_t low) const noexcept;
+    void add(uint16_t low);
+    // Picks the representation that suits the current cardinality
+    void normalize();
+  };
+
+  static Container intersect(const Container &lhs, const Container &rhs);
+  static Container unite(const Container &lhs, const Container &rhs);
+
+  [[nodiscard]] const Container *find(uint64_t key) const noexcept;
+
+  // Sorted by key
+  std::vector<Container> containers_;
+};
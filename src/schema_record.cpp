@@ -1,4 +1,7 @@
 #include "schema_record.hpp"
+#include "lexer.hpp"
+#include "sqlite_constants.hpp"
+#include <algorithm>
 
 SchemaRecord::SchemaRecord(const BTreeRecord &record) {
   const auto &values = record.getValues();
@@ -8,20 +11,71 @@ SchemaRecord::SchemaRecord(const BTreeRecord &record) {
     name = std::get<std::string>(values[1]);
     tbl_name = std::get<std::string>(values[2]);
     rootpage = std::get<int64_t>(values[3]);
-    sql = std::get<std::string>(values[4]);
+    // Indexes SQLite creates for constraints have no statement
+    if (const auto *text = std::get_if<std::string>(&values[4])) {
+      sql = *text;
+    }
     parseColumns();
   }
 }
 
 void SchemaRecord::parseColumns() {
-  if (sql.empty()) {
+  // Only tables have columns; index statements are parsed where they are used
+  if (sql.empty() || type != sqlite::record_type::TABLE) {
     return;
   }
 
   auto create_stmt = SQLParser::parseCreate(sql);
+  without_rowid = create_stmt->without_rowid;
   for (size_t i = 0; i < create_stmt->columns.size(); i++) {
     const auto &col = create_stmt->columns[i];
-    columns.push_back({col.name, col.type, static_cast<int>(i)});
+    bool is_rowid_alias = !without_rowid && col.primary_key &&
+                          equalsIgnoreCase(col.type, "INTEGER");
+    columns.push_back({col.name, col.type, static_cast<int>(i),
+                       is_rowid_alias, col.collation});
+    storage_positions.push_back(static_cast<int>(i));
+  }
+  if (!without_rowid) {
+    return;
+  }
+
+  auto position = [this](const std::string &name) {
+    auto it = std::find_if(columns.begin(), columns.end(),
+                           [&name](const ColumnInfo &column) {
+                             return equalsIgnoreCase(column.name, name);
+                           });
+    return it == columns.end() ? -1 : it->position;
+  };
+  std::vector<int> key;
+  for (const auto &key_column : create_stmt->primary_key) {
+    key.push_back(position(key_column.name));
+  }
+
+  int field = 0;
+  for (int pos : key) {
+    if (pos != -1) {
+      storage_positions[pos] = field++;
+    }
+  }
+  for (const auto &column : columns) {
+    if (std::find(key.begin(), key.end(), column.position) == key.end()) {
+      storage_positions[column.position] = field++;
+    }
+  }
+
+  // Descending and collated key columns are stored out of BINARY order, and
+  // collated columns compare out of it whatever order the key has
+  auto binary = [](const std::string &collation) {
+    return collation.empty() || equalsIgnoreCase(collation, "binary");
+  };
+  for (size_t i = 0; i < key.size(); ++i) {
+    const auto &key_column = create_stmt->primary_key[i];
+    if (key[i] == -1 || key_column.descending ||
+        !binary(key_column.collation) ||
+        !binary(create_stmt->columns[key[i]].collation)) {
+      break;
+    }
+    seekable_key.push_back(key[i]);
   }
 }
 
@@ -30,28 +84,29 @@ std::vector<int> SchemaRecord::mapColumnPositions(
   std::vector<int> positions;
 
   for (const auto &col_name : column_names) {
-    if (col_name == "id") {
-      positions.push_back(-1);
-      continue;
-    }
-
-    for (const auto &col_info : columns) {
-      if (col_info.name == col_name) {
-        positions.push_back(col_info.position);
-        break;
-      }
+    if (auto column = resolveColumn(col_name)) {
+      positions.push_back(column->position);
     }
   }
 
   return positions;
 }
 
-int SchemaRecord::findWhereColumnPosition(
-    const std::string &column_name) const {
+std::optional<ResolvedColumn>
+SchemaRecord::resolveColumn(const std::string &column_name) const {
   for (const auto &col_info : columns) {
-    if (col_info.name == column_name) {
-      return col_info.position;
+    if (equalsIgnoreCase(col_info.name, column_name)) {
+      return ResolvedColumn{col_info.is_rowid_alias ? -1 : col_info.position,
+                            affinityOf(col_info.type),
+                            collationOf(col_info.collation)};
     }
   }
-  return -1;
+
+  // The rowid's own names, unless a real column has taken them
+  if (!without_rowid && (equalsIgnoreCase(column_name, "rowid") ||
+      equalsIgnoreCase(column_name, "oid") ||
+      equalsIgnoreCase(column_name, "_rowid_"))) {
+    return ResolvedColumn{-1, Affinity::Integer, Collation::Binary};
+  }
+  return std::nullopt;
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "btree_record.hpp"
+#include "predicate.hpp"
 #include "sql_parser.hpp"
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -9,6 +11,10 @@ public:
   std::string name;
   std::string type;
   int position;
+  // INTEGER PRIMARY KEY columns are stored as NULL and read from the rowid
+  bool is_rowid_alias{false};
+  // The COLLATE name as declared; empty for BINARY
+  std::string collation;
 };
 
 class SchemaRecord {
@@ -17,7 +23,11 @@ public:
 
   std::vector<int>
   mapColumnPositions(const std::vector<std::string> &column_names) const;
-  int findWhereColumnPosition(const std::string &column_name) const;
+
+  // Position (-1 for the rowid and its aliases), affinity and collation of a
+  // bare column name; nullopt when the table has no such column.
+  std::optional<ResolvedColumn>
+  resolveColumn(const std::string &column_name) const;
 
   // Getters
   const std::string &getType() const { return type; }
@@ -27,6 +37,19 @@ public:
   const std::string &getSql() const { return sql; }
   const std::vector<ColumnInfo> &getColumns() const { return columns; }
 
+  // WITHOUT ROWID tables keep their rows in an index B-tree keyed by the
+  // primary key, and have no rowid
+  bool isWithoutRowid() const { return without_rowid; }
+  // The field of the stored record holding each column: WITHOUT ROWID
+  // tables store the primary key columns first, then the rest in order
+  const std::vector<int> &getStoragePositions() const {
+    return storage_positions;
+  }
+  // Positions of the leading primary key columns that a WITHOUT ROWID
+  // table's B-tree can be searched on: those stored in ascending BINARY
+  // order and compared in BINARY
+  const std::vector<int> &getSeekableKey() const { return seekable_key; }
+
 private:
   std::string type;
   std::string name;
@@ -34,6 +57,9 @@ private:
   int64_t rootpage;
   std::string sql;
   std::vector<ColumnInfo> columns;
+  bool without_rowid{false};
+  std::vector<int> storage_positions;
+  std::vector<int> seekable_key;
 
   void parseColumns();
 };
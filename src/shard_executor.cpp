@@ -0,0 +1,279 @@
+#include "shard_executor.hpp"
+#include "database.hpp"
+#include "debug.hpp"
+#include "sorter.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <exception>
+#include <glob.h>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+bool isNull(const RecordValue &value) {
+  return std::holds_alternative<std::monostate>(value);
+}
+
+// Folds one shard's aggregate row into the running one, comparing each
+// column under its collation
+void combineAggregates(const SelectStatement &stmt,
+                       const std::vector<Collation> &collations,
+                       const Row &partial, Row &combined) {
+  if (stmt.is_count_star) {
+    combined[0] = std::get<int64_t>(combined[0]) +
+                  std::get<int64_t>(partial.at(0));
+    return;
+  }
+  for (size_t i = 0; i < stmt.aggregates.size(); ++i) {
+    // MIN and MAX skip NULLs, which a shard with no values returns
+    const RecordValue &value = partial.at(i);
+    if (isNull(value)) {
+      continue;
+    }
+    if (isNull(combined[i])) {
+      combined[i] = value;
+      continue;
+    }
+    int cmp = compareRecordValues(value, combined[i], collations[i]);
+    bool max = stmt.aggregates[i].function == AggregateFunction::Max;
+    if (max ? cmp > 0 : cmp < 0) {
+      combined[i] = value;
+    }
+  }
+}
+
+} // namespace
+
+std::vector<std::string>
+expandShardPaths(const std::vector<std::string> &patterns) {
+  std::vector<std::string> paths;
+  for (const auto &pattern : patterns) {
+    glob_t matches{};
+    int status = glob(pattern.c_str(), 0, nullptr, &matches);
+    if (status == 0) {
+      paths.insert(paths.end(), matches.gl_pathv,
+                   matches.gl_pathv + matches.gl_pathc);
+    }
+    globfree(&matches);
+    if (status == GLOB_NOMATCH) {
+      throw std::runtime_error("No database matches: " + pattern);
+    }
+    if (status != 0) {
+      throw std::runtime_error("Failed to expand: " + pattern);
+    }
+  }
+  return paths;
+}
+
+ShardExecutor::ShardExecutor(std::vector<std::string> paths,
+                             ShardOptions options)
+    : paths_(std::move(paths)), options_(options) {
+  if (options_.concurrency == 0) {
+    options_.concurrency = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+sqlite::QueryResult ShardExecutor::execute(const SelectStatement &stmt) const {
+  TraceSpan span("sharded_query");
+  const bool aggregate = stmt.is_count_star || !stmt.aggregates.empty();
+  const uint64_t offset = stmt.offset.value_or(0);
+
+  // Shards return partial aggregates whole, and enough rows for the global
+  // LIMIT, with the ORDER BY columns appended for the merge
+  SelectStatement shard = stmt;
+  shard.offset.reset();
+  if (aggregate) {
+    shard.limit.reset();
+  } else if (stmt.limit) {
+    shard.limit =
+        *stmt.limit > UINT64_MAX - offset ? UINT64_MAX : *stmt.limit + offset;
+  }
+  const size_t width = stmt.column_names.size();
+  if (!aggregate) {
+    for (const auto &term : stmt.order_by) {
+      shard.column_names.push_back(term.column);
+    }
+  }
+
+  // Shards share a schema, so the first gives the collations the merge
+  // compares ORDER BY keys and MIN/MAX values under
+  std::vector<std::string> compared;
+  for (const auto &term : stmt.order_by) {
+    compared.push_back(term.column);
+  }
+  for (const auto &term : stmt.aggregates) {
+    compared.push_back(term.column);
+  }
+  std::vector<Collation> collations(compared.size(), Collation::Binary);
+  if (!compared.empty() && !paths_.empty()) {
+    Database db(paths_.front());
+    db.readHeader();
+    collations = db.collationsOf(stmt, compared);
+  }
+
+  // Without ORDER BY, the first shards that fill the LIMIT are the answer
+  std::vector<sqlite::QueryResult> partials = gather(
+      shard, !aggregate && stmt.order_by.empty() ? shard.limit : std::nullopt);
+  LOG_INFO("Gathered results from " << partials.size() << " shards");
+
+  sqlite::QueryResult results;
+  uint64_t skip = offset;
+  sqlite::RowSink emit = [&](Row &&row) {
+    if (stmt.limit && results.size() >= *stmt.limit) {
+      return false;
+    }
+    if (skip > 0) {
+      --skip;
+      return true;
+    }
+    if (!aggregate && row.size() > width) {
+      row.resize(width);
+    }
+    results.push_back(std::move(row));
+    return true;
+  };
+
+  if (aggregate) {
+    Row combined(stmt.is_count_star ? 1 : stmt.aggregates.size());
+    if (stmt.is_count_star) {
+      combined[0] = int64_t{0};
+    }
+    const std::vector<Collation> aggregate_collations(
+        collations.begin() + stmt.order_by.size(), collations.end());
+    for (const auto &partial : partials) {
+      if (!partial.empty()) {
+        combineAggregates(stmt, aggregate_collations, partial.front(),
+                          combined);
+      }
+    }
+    emit(std::move(combined));
+    return results;
+  }
+
+  if (stmt.order_by.empty()) {
+    for (auto &partial : partials) {
+      for (auto &row : partial) {
+        if (!emit(std::move(row))) {
+          return results;
+        }
+      }
+    }
+    return results;
+  }
+
+  std::vector<SortKey> keys;
+  for (const auto &term : stmt.order_by) {
+    keys.push_back(
+        {width + keys.size(), term.descending, collations[keys.size()]});
+  }
+  RowComparator comparator(std::move(keys));
+  auto merge = [&](auto &sorter) {
+    for (auto &partial : partials) {
+      for (auto &row : partial) {
+        sorter.add(std::move(row));
+      }
+      partial = {};
+    }
+    sorter.finish(emit);
+  };
+  if (shard.limit) {
+    TopKSorter sorter(std::move(comparator), *shard.limit);
+    merge(sorter);
+  } else {
+    ExternalSorter sorter(std::move(comparator), options_.memory_budget);
+    merge(sorter);
+  }
+  return results;
+}
+
+std::vector<sqlite::QueryResult>
+ShardExecutor::gather(const SelectStatement &stmt,
+                      std::optional<uint64_t> rows_needed) const {
+  const size_t workers =
+      std::min({static_cast<size_t>(options_.concurrency), paths_.size(),
+                options_.file_budget / FILES_PER_SHARD});
+  if (workers == 0 && !paths_.empty()) {
+    throw std::runtime_error("The file budget cannot hold one open shard");
+  }
+
+  std::vector<sqlite::QueryResult> results(paths_.size());
+  std::mutex mutex;
+  size_t next = 0;
+  // Shards whose results are in, counted from the first, and their rows
+  std::vector<bool> done(paths_.size(), false);
+  size_t prefix = 0;
+  uint64_t prefix_rows = 0;
+  size_t held_bytes = 0;
+  bool stop = false;
+  std::exception_ptr error;
+
+  auto fail = [&](std::exception_ptr failure) {
+    if (!error) {
+      error = std::move(failure);
+    }
+    stop = true;
+  };
+
+  auto work = [&] {
+    for (;;) {
+      size_t shard = 0;
+      {
+        std::lock_guard lock(mutex);
+        if (stop || next == paths_.size()) {
+          return;
+        }
+        shard = next++;
+      }
+
+      sqlite::QueryResult rows;
+      try {
+        Database db(paths_[shard]);
+        db.readHeader();
+        db.setSortMemoryBudget(options_.memory_budget / workers);
+        rows = db.executeSelect(stmt);
+      } catch (const std::exception &e) {
+        std::lock_guard lock(mutex);
+        fail(std::make_exception_ptr(
+            std::runtime_error(paths_[shard] + ": " + e.what())));
+        return;
+      }
+      size_t bytes = 0;
+      for (const auto &row : rows) {
+        bytes += ExternalSorter::estimateRowBytes(row);
+      }
+
+      std::lock_guard lock(mutex);
+      held_bytes += bytes;
+      if (held_bytes > options_.memory_budget) {
+        fail(std::make_exception_ptr(std::runtime_error(
+            "Sharded query results exceed the memory budget of " +
+            std::to_string(options_.memory_budget) + " bytes")));
+        return;
+      }
+      results[shard] = std::move(rows);
+      done[shard] = true;
+      while (prefix < done.size() && done[prefix]) {
+        prefix_rows += results[prefix++].size();
+      }
+      if (rows_needed && prefix_rows >= *rows_needed) {
+        stop = true;
+      }
+    }
+  };
+
+  TraceSpan span("shard_gather");
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return results;
+}
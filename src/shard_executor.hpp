@@ -0,0 +1,55 @@
+#pragma once
+
+#include "sql_parser.hpp"
+#include "sqlite_constants.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Result rows all shards of a query may hold at once by default.
+constexpr size_t DEFAULT_SHARD_MEMORY_BUDGET = 256 * 1024 * 1024;
+// File descriptors open shards may hold in all by default.
+constexpr size_t DEFAULT_SHARD_FILE_BUDGET = 256;
+// Descriptors one open shard may hold: the database, its write-ahead log
+// and a sidecar file being read.
+constexpr size_t FILES_PER_SHARD = 3;
+
+struct ShardOptions {
+  // Shards queried at once; zero for one per hardware thread
+  unsigned concurrency{0};
+  // Bytes of result rows held across all shards, which also bounds the
+  // sorts on each shard and the final merge
+  size_t memory_budget{DEFAULT_SHARD_MEMORY_BUDGET};
+  size_t file_budget{DEFAULT_SHARD_FILE_BUDGET};
+};
+
+// The files matching each glob(3) pattern, sorted, one pattern after the
+// other; throws for a pattern that matches nothing.
+std::vector<std::string>
+expandShardPaths(const std::vector<std::string> &patterns);
+
+// Runs one SELECT over many database files of the same schema as if over
+// the UNION ALL of their tables. Shards are queried on a pool of threads,
+// each opening its own Database, with as many open at once as the
+// concurrency and file budget allow. Rows come in shard order, or merged
+// by ORDER BY, which every shard also returns its rows in; LIMIT and
+// OFFSET apply to the whole. COUNT(*), MIN and MAX combine each shard's
+// partial result. Joins run within each shard.
+class ShardExecutor {
+public:
+  explicit ShardExecutor(std::vector<std::string> paths,
+                         ShardOptions options = {});
+
+  sqlite::QueryResult execute(const SelectStatement &stmt) const;
+
+private:
+  // Each shard's rows, in path order. With `rows_needed`, shards past a
+  // prefix that holds that many rows are not started, and stay empty.
+  std::vector<sqlite::QueryResult>
+  gather(const SelectStatement &stmt,
+         std::optional<uint64_t> rows_needed) const;
+
+  std::vector<std::string> paths_;
+  ShardOptions options_;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "file_reader.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+// Cache files kept next to a database, such as its zone maps and Bloom
+// filters. Each starts with a magic number and the data version it was
+// built from, and is ignored once the version has moved. Fields are in host
+// byte order, since a sidecar only serves the machine that built it.
+namespace sidecar {
+
+using Magic = char[8];
+
+template <typename T> void put(std::ostream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> bool get(std::istream &in, T &value) {
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+inline void putHeader(std::ostream &out, const Magic &magic,
+                      const DataVersion &version) {
+  out.write(magic, sizeof(Magic));
+  put(out, version.change_counter);
+  put(out, version.modified_ns);
+  put(out, version.wal_salt);
+  put(out, version.wal_frames);
+}
+
+// Whether the file starts with `magic` and was built from `version`
+inline bool getHeader(std::istream &in, const Magic &magic,
+                      const DataVersion &version) {
+  Magic found;
+  DataVersion saved;
+  return in.read(found, sizeof(Magic)) &&
+         std::equal(found, found + sizeof(Magic), magic) &&
+         get(in, saved.change_counter) && get(in, saved.modified_ns) &&
+         get(in, saved.wal_salt) && get(in, saved.wal_frames) &&
+         saved == version;
+}
+
+// Writes the file through `write` aside and renames it over `path`, so that
+// readers never see half of one
+template <typename Write> void save(const std::string &path, Write &&write) {
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    write(out);
+    if (!out.flush()) {
+      std::remove(temporary.c_str());
+      throw std::runtime_error("Failed to write file: " + temporary);
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    throw std::runtime_error("Failed to write file: " + path);
+  }
+}
+
+} // namespace sidecar
@@ -0,0 +1,220 @@
+#include "sorter.hpp"
+#include "debug.hpp"
+#include "value_codec.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+void writeExact(std::FILE *file, const void *data, size_t length) {
+  if (length != 0 && std::fwrite(data, 1, length, file) != length) {
+    throw std::runtime_error("Failed to write sort run");
+  }
+}
+
+bool readExact(std::FILE *file, void *data, size_t length) {
+  return length == 0 || std::fread(data, 1, length, file) == length;
+}
+
+} // namespace
+
+int RowComparator::compare(const Row &lhs, const Row &rhs) const noexcept {
+  for (const auto &key : keys_) {
+    int result =
+        compareRecordValues(lhs[key.column], rhs[key.column], key.collation);
+    if (result != 0) {
+      return key.descending ? -result : result;
+    }
+  }
+  return 0;
+}
+
+TopKSorter::TopKSorter(RowComparator comparator, size_t limit)
+    : comparator_(std::move(comparator)), limit_(limit) {
+  heap_.reserve(std::min<size_t>(limit_, 4096));
+}
+
+bool TopKSorter::before(const Entry &lhs, const Entry &rhs) const noexcept {
+  int result = comparator_.compare(lhs.row, rhs.row);
+  return result != 0 ? result < 0 : lhs.sequence < rhs.sequence;
+}
+
+void TopKSorter::add(Row &&row) {
+  if (limit_ == 0) {
+    return;
+  }
+
+  auto cmp = [this](const Entry &lhs, const Entry &rhs) {
+    return before(lhs, rhs);
+  };
+  Entry entry{std::move(row), next_sequence_++};
+
+  if (heap_.size() < limit_) {
+    heap_.push_back(std::move(entry));
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+    return;
+  }
+
+  // heap_.front() is the last row that currently makes the cut
+  if (before(entry, heap_.front())) {
+    std::pop_heap(heap_.begin(), heap_.end(), cmp);
+    heap_.back() = std::move(entry);
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+  }
+}
+
+void TopKSorter::finish(const sqlite::RowSink &sink) {
+  std::sort_heap(heap_.begin(), heap_.end(),
+                 [this](const Entry &lhs, const Entry &rhs) {
+                   return before(lhs, rhs);
+                 });
+  for (auto &entry : heap_) {
+    if (!sink(std::move(entry.row))) {
+      break;
+    }
+  }
+  heap_.clear();
+}
+
+ExternalSorter::ExternalSorter(RowComparator comparator, size_t memory_budget)
+    : comparator_(std::move(comparator)), memory_budget_(memory_budget) {}
+
+void ExternalSorter::add(Row &&row) {
+  buffered_bytes_ += estimateRowBytes(row);
+  buffer_.push_back(std::move(row));
+  if (buffered_bytes_ > memory_budget_) {
+    spillRun();
+  }
+}
+
+void ExternalSorter::finish(const sqlite::RowSink &sink) {
+  sortBuffer();
+  if (runs_.empty()) {
+    for (auto &row : buffer_) {
+      if (!sink(std::move(row))) {
+        break;
+      }
+    }
+    buffer_.clear();
+    return;
+  }
+  mergeRuns(sink);
+}
+
+void ExternalSorter::sortBuffer() {
+  std::stable_sort(buffer_.begin(), buffer_.end(), comparator_);
+}
+
+void ExternalSorter::spillRun() {
+  sortBuffer();
+
+  TempFile run(std::tmpfile(), &std::fclose);
+  if (!run) {
+    throw std::runtime_error("Failed to create temporary sort run");
+  }
+  std::vector<uint8_t> scratch;
+  for (const auto &row : buffer_) {
+    writeRow(run.get(), row, scratch);
+  }
+  std::rewind(run.get());
+
+  LOG_DEBUG("Spilled sort run " << runs_.size() << " with " << buffer_.size()
+                                << " rows");
+  runs_.push_back(std::move(run));
+  buffer_.clear();
+  buffered_bytes_ = 0;
+}
+
+void ExternalSorter::mergeRuns(const sqlite::RowSink &sink) {
+  // The rows still in memory act as the final run; ties are broken by run
+  // index so the merge preserves the input order of equal keys.
+  struct Head {
+    Row row;
+    size_t source;
+  };
+  auto after = [this](const Head &lhs, const Head &rhs) {
+    int result = comparator_.compare(lhs.row, rhs.row);
+    return result != 0 ? result > 0 : lhs.source > rhs.source;
+  };
+  std::vector<Head> heads;
+  heads.reserve(runs_.size() + 1);
+
+  const size_t memory_source = runs_.size();
+  size_t memory_pos = 0;
+  auto advance = [&](size_t source) {
+    Row row;
+    if (source == memory_source) {
+      if (memory_pos == buffer_.size()) {
+        return;
+      }
+      row = std::move(buffer_[memory_pos++]);
+    } else if (!readRow(runs_[source].get(), row)) {
+      return;
+    }
+    heads.push_back({std::move(row), source});
+    std::push_heap(heads.begin(), heads.end(), after);
+  };
+
+  for (size_t source = 0; source <= memory_source; ++source) {
+    advance(source);
+  }
+
+  while (!heads.empty()) {
+    std::pop_heap(heads.begin(), heads.end(), after);
+    Head head = std::move(heads.back());
+    heads.pop_back();
+    if (!sink(std::move(head.row))) {
+      break;
+    }
+    advance(head.source);
+  }
+
+  runs_.clear();
+  buffer_.clear();
+  buffered_bytes_ = 0;
+}
+
+size_t ExternalSorter::estimateRowBytes(const Row &row) noexcept {
+  size_t bytes = sizeof(Row) + row.capacity() * sizeof(RecordValue);
+  for (const auto &value : row) {
+    if (const auto *text = std::get_if<std::string>(&value)) {
+      bytes += text->capacity();
+    } else if (const auto *blob = std::get_if<std::vector<uint8_t>>(&value)) {
+      bytes += blob->capacity();
+    }
+  }
+  return bytes;
+}
+
+void ExternalSorter::writeRow(std::FILE *file, const Row &row,
+                              std::vector<uint8_t> &scratch) {
+  scratch.clear();
+  for (const auto &value : row) {
+    value_codec::appendValue(scratch, value);
+  }
+  uint64_t length = scratch.size();
+  writeExact(file, &length, sizeof(length));
+  writeExact(file, scratch.data(), scratch.size());
+}
+
+bool ExternalSorter::readRow(std::FILE *file, Row &row) {
+  uint64_t length = 0;
+  if (!readExact(file, &length, sizeof(length))) {
+    return false;
+  }
+
+  std::vector<uint8_t> bytes(length);
+  if (!readExact(file, bytes.data(), length)) {
+    throw std::runtime_error("Corrupt temporary sort run");
+  }
+  ByteReader reader(std::move(bytes));
+  row.clear();
+  while (!reader.eof()) {
+    auto value = value_codec::readValue(reader);
+    if (!value) {
+      throw std::runtime_error("Corrupt temporary sort run");
+    }
+    row.push_back(std::move(*value));
+  }
+  return true;
+}
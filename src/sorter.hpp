@@ -0,0 +1,93 @@
+#pragma once
+
+#include "sqlite_constants.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using Row = sqlite::Row;
+
+// Default amount of row data the external sorter buffers before it spills a
+// sorted run to a temporary file.
+constexpr size_t DEFAULT_SORT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+struct SortKey {
+  size_t column;
+  bool descending{false};
+  // The ORDER BY column's own, for TEXT
+  Collation collation{Collation::Binary};
+};
+
+class RowComparator {
+public:
+  explicit RowComparator(std::vector<SortKey> keys) noexcept
+      : keys_(std::move(keys)) {}
+
+  [[nodiscard]] int compare(const Row &lhs, const Row &rhs) const noexcept;
+  [[nodiscard]] bool operator()(const Row &lhs, const Row &rhs) const noexcept {
+    return compare(lhs, rhs) < 0;
+  }
+
+private:
+  std::vector<SortKey> keys_;
+};
+
+// Keeps the first `limit` rows of the requested order in a bounded max-heap,
+// so ORDER BY ... LIMIT k costs O(n log k) time and O(k) memory.
+class TopKSorter {
+public:
+  TopKSorter(RowComparator comparator, size_t limit);
+
+  void add(Row &&row);
+  void finish(const sqlite::RowSink &sink);
+
+private:
+  struct Entry {
+    Row row;
+    uint64_t sequence;
+  };
+
+  [[nodiscard]] bool before(const Entry &lhs, const Entry &rhs) const noexcept;
+
+  RowComparator comparator_;
+  size_t limit_;
+  uint64_t next_sequence_{0};
+  std::vector<Entry> heap_;
+};
+
+// Run-generating merge sort. Rows are buffered until the memory budget is
+// exceeded, then sorted and written to a temporary file as one run; finish()
+// merges all runs (plus whatever is still buffered) with a k-way heap merge.
+class ExternalSorter {
+public:
+  ExternalSorter(RowComparator comparator, size_t memory_budget);
+
+  void add(Row &&row);
+  void finish(const sqlite::RowSink &sink);
+
+  [[nodiscard]] size_t runCount() const noexcept { return runs_.size(); }
+
+  // Memory a row takes, as the budget counts it
+  static size_t estimateRowBytes(const Row &row) noexcept;
+
+private:
+  using TempFile = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+
+  void sortBuffer();
+  void spillRun();
+  void mergeRuns(const sqlite::RowSink &sink);
+
+  // Each row is its encoded length, then its values as value_codec writes
+  // them; `scratch` holds the encoding
+  static void writeRow(std::FILE *file, const Row &row,
+                       std::vector<uint8_t> &scratch);
+  static bool readRow(std::FILE *file, Row &row);
+
+  RowComparator comparator_;
+  size_t memory_budget_;
+  size_t buffered_bytes_{0};
+  std::vector<Row> buffer_;
+  std::vector<TempFile> runs_;
+};
@@ -1,5 +1,88 @@
 #include "sql_parser.hpp"
 #include "debug.hpp"
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+namespace {
+
+// Words that end a column's type name and start its constraints
+bool isConstraintKeyword(const std::string &word) {
+  static constexpr std::string_view KEYWORDS[] = {
+      "constraint", "default", "collate", "references",
+      "unique",     "check",   "generated"};
+  return std::any_of(std::begin(KEYWORDS), std::end(KEYWORDS),
+                     [&word](std::string_view keyword) {
+                       return equalsIgnoreCase(word, keyword);
+                     });
+}
+
+// Words the lexer has no token type for arrive as identifiers
+bool isKeyword(const Token &token, std::string_view word) {
+  return token.type() == TokenType::Identifier &&
+         equalsIgnoreCase(token.value(), word);
+}
+
+bool isTableConstraint(const Token &token) {
+  if (token.type() == TokenType::Primary) {
+    return true;
+  }
+  return token.type() == TokenType::Identifier &&
+         (equalsIgnoreCase(token.value(), "constraint") ||
+          equalsIgnoreCase(token.value(), "unique") ||
+          equalsIgnoreCase(token.value(), "check") ||
+          equalsIgnoreCase(token.value(), "foreign"));
+}
+
+std::optional<ExprOp> comparisonOp(const Token &token) {
+  if (token.type() != TokenType::Operator) {
+    return std::nullopt;
+  }
+  const std::string &op = token.value();
+  if (op == "=" || op == "==") {
+    return ExprOp::Eq;
+  }
+  if (op == "!=" || op == "<>") {
+    return ExprOp::Ne;
+  }
+  if (op == "<") {
+    return ExprOp::Lt;
+  }
+  if (op == "<=") {
+    return ExprOp::Le;
+  }
+  if (op == ">") {
+    return ExprOp::Gt;
+  }
+  if (op == ">=") {
+    return ExprOp::Ge;
+  }
+  return std::nullopt;
+}
+
+RecordValue parseNumber(const std::string &text) {
+  if (text.find_first_of(".eE") == std::string::npos) {
+    int64_t integer = 0;
+    auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), integer);
+    if (error == std::errc() && end == text.data() + text.size()) {
+      return integer;
+    }
+  }
+  // Reals and integers too large for 64 bits
+  return std::stod(text);
+}
+
+} // namespace
+
+std::pair<std::string, std::string>
+splitQualifiedName(const std::string &name) {
+  size_t dot = name.find('.');
+  if (dot == std::string::npos) {
+    return {"", name};
+  }
+  return {name.substr(0, dot), name.substr(dot + 1)};
+}
 
 std::unique_ptr<SelectStatement>
 SQLParser::parseSelect(const std::string &sql) {
@@ -15,6 +98,40 @@ SQLParser::parseCreate(const std::string &sql) {
   return parseCreateStatement(lexer);
 }
 
+std::unique_ptr<CreateIndexStatement>
+SQLParser::parseCreateIndex(const std::string &sql) {
+  LOG_DEBUG("Parsing CREATE INDEX statement: " << sql);
+  Lexer lexer(sql);
+  return parseCreateIndexStatement(lexer);
+}
+
+AggregateTerm SQLParser::parseAggregate(Lexer &lexer,
+                                        const std::string &function) {
+  LOG_DEBUG("Parsing aggregate: " << function);
+  AggregateTerm aggregate{};
+  if (equalsIgnoreCase(function, "min")) {
+    aggregate.function = AggregateFunction::Min;
+  } else if (equalsIgnoreCase(function, "max")) {
+    aggregate.function = AggregateFunction::Max;
+  } else {
+    throw std::runtime_error("Unsupported function: " + function);
+  }
+
+  auto token = lexer.nextToken();
+  if (token.type() != TokenType::Identifier) {
+    LOG_ERROR("Expected column name, got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected column name in " + function + "()");
+  }
+  aggregate.column = token.value();
+
+  token = lexer.nextToken();
+  if (token.type() != TokenType::RParen) {
+    LOG_ERROR("Expected ), got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected ) after " + function + " argument");
+  }
+  return aggregate;
+}
+
 std::unique_ptr<SelectStatement> SQLParser::parseSelectStatement(Lexer &lexer) {
   LOG_DEBUG("Starting SELECT statement parse");
   auto stmt = std::make_unique<SelectStatement>();
@@ -56,9 +173,17 @@ std::unique_ptr<SelectStatement> SQLParser::parseSelectStatement(Lexer &lexer) {
   } else {
     LOG_DEBUG("Parsing column list");
     while (true) {
-      if (token.type() == TokenType::Identifier) {
-        LOG_DEBUG("Found column: " << token.value());
-        stmt->column_names.push_back(token.value());
+      if (token.type() == TokenType::Identifier ||
+          token.type() == TokenType::Star) {
+        std::string name = token.value();
+        token = lexer.nextToken();
+        if (token.type() == TokenType::LParen) {
+          stmt->aggregates.push_back(parseAggregate(lexer, name));
+          token = lexer.nextToken();
+        } else {
+          LOG_DEBUG("Found column: " << name);
+          stmt->column_names.push_back(name);
+        }
       } else if (token.type() == TokenType::From) {
         break;
       } else {
@@ -67,7 +192,6 @@ std::unique_ptr<SelectStatement> SQLParser::parseSelectStatement(Lexer &lexer) {
         throw std::runtime_error("Expected column name or FROM");
       }
 
-      token = lexer.nextToken();
       if (token.type() == TokenType::From) {
         break;
       }
@@ -77,6 +201,9 @@ std::unique_ptr<SelectStatement> SQLParser::parseSelectStatement(Lexer &lexer) {
       }
       token = lexer.nextToken();
     }
+    if (!stmt->aggregates.empty() && !stmt->column_names.empty()) {
+      throw std::runtime_error("Cannot mix aggregates and plain columns");
+    }
   }
 
   token = lexer.nextToken();
@@ -86,11 +213,43 @@ std::unique_ptr<SelectStatement> SQLParser::parseSelectStatement(Lexer &lexer) {
   }
   LOG_DEBUG("Found table name: " << token.value());
   stmt->table_name = token.value();
+  token = parseTableAlias(lexer, stmt->table_alias);
+
+  if (token.type() == TokenType::Join || token.type() == TokenType::Inner ||
+      token.type() == TokenType::Left) {
+    LOG_DEBUG("Parsing JOIN clause");
+    token = parseJoinClause(lexer, token, *stmt);
+  }
 
-  token = lexer.nextToken();
   if (token.type() == TokenType::Where) {
     LOG_DEBUG("Parsing WHERE clause");
-    stmt->where_clause = parseWhereClause(lexer);
+    token = lexer.nextToken();
+    stmt->where_clause = parseExpression(lexer, token);
+    LOG_DEBUG("Parsed WHERE: " << toString(*stmt->where_clause));
+  }
+
+  if (token.type() == TokenType::Order) {
+    LOG_DEBUG("Parsing ORDER BY clause");
+    token = parseOrderByClause(lexer, *stmt);
+  }
+
+  if (token.type() == TokenType::Limit) {
+    LOG_DEBUG("Parsing LIMIT clause");
+    stmt->limit = parseLimitValue(lexer);
+    token = lexer.nextToken();
+
+    if (token.type() == TokenType::Offset) {
+      LOG_DEBUG("Parsing OFFSET clause");
+      // As in SQLite, a negative LIMIT is no limit and a negative OFFSET
+      // none at all
+      stmt->offset = parseLimitValue(lexer).value_or(0);
+      token = lexer.nextToken();
+    }
+  }
+
+  if (token.type() != TokenType::Eof) {
+    LOG_ERROR("Unexpected token after SELECT: " << token.value());
+    throw std::runtime_error("Unexpected token: " + token.value());
   }
 
   LOG_DEBUG("Completed parsing SELECT statement");
@@ -110,8 +269,14 @@ SQLParser::parseCreateStatement(Lexer &lexer) {
     token = lexer.nextToken();
   }
 
-  // Get table name
+  // Get table name, skipping IF NOT EXISTS
   token = lexer.nextToken();
+  if (token.type() == TokenType::Identifier &&
+      equalsIgnoreCase(token.value(), "if")) {
+    token = lexer.nextToken(); // NOT
+    token = lexer.nextToken(); // EXISTS
+    token = lexer.nextToken();
+  }
   LOG_DEBUG(
       "Looking for table name token, got: " << static_cast<int>(token.type()));
   if (token.type() != TokenType::Identifier &&
@@ -143,6 +308,16 @@ SQLParser::parseCreateStatement(Lexer &lexer) {
       break;
     }
 
+    // Table constraints such as PRIMARY KEY (a, b) carry no column
+    if (isTableConstraint(token)) {
+      LOG_DEBUG("Skipping table constraint");
+      skipTableConstraint(lexer, token, *stmt);
+      if (token.type() == TokenType::RParen) {
+        break;
+      }
+      continue;
+    }
+
     Column col;
 
     // Column name
@@ -154,36 +329,18 @@ SQLParser::parseCreateStatement(Lexer &lexer) {
     col.name = token.value();
     LOG_DEBUG("Parsing column name: " << col.name);
 
-    // Column type (optional in SQLite)
+    // Column type (optional in SQLite, and possibly several words long)
     token = lexer.nextToken();
-    LOG_DEBUG(
-        "Looking for column type, got: " << static_cast<int>(token.type()));
-    if (token.type() == TokenType::Identifier) {
-      col.type = token.value();
-      LOG_DEBUG("Found column type: " << col.type);
+    while (token.type() == TokenType::Identifier &&
+           !isConstraintKeyword(token.value())) {
+      col.type += (col.type.empty() ? "" : " ") + token.value();
       token = lexer.nextToken();
-    } else {
-      // No explicit type specified, default to TEXT
-      col.type = "TEXT";
-      LOG_DEBUG("No explicit column type, defaulting to TEXT");
     }
+    LOG_DEBUG("Found column type: " << col.type);
 
     // Parse additional column constraints
     LOG_DEBUG("Parsing column constraints");
-    while (token.type() != TokenType::Comma &&
-           token.type() != TokenType::RParen) {
-      LOG_DEBUG(
-          "Processing constraint token: " << static_cast<int>(token.type()));
-      if (token.type() == TokenType::Primary ||
-          token.type() == TokenType::Key ||
-          token.type() == TokenType::Identifier) {
-        token = lexer.nextToken();
-        continue;
-      }
-      LOG_ERROR(
-          "Invalid column constraint: " << static_cast<int>(token.type()));
-      throw std::runtime_error("Invalid column constraint");
-    }
+    skipColumnConstraints(lexer, token, col);
 
     LOG_DEBUG("Adding column to statement: " << col.name);
     stmt->columns.push_back(std::move(col));
@@ -194,39 +351,495 @@ SQLParser::parseCreateStatement(Lexer &lexer) {
     }
   }
 
+  // A column's own PRIMARY KEY constraint declares a key of one column
+  if (stmt->primary_key.empty()) {
+    for (const auto &col : stmt->columns) {
+      if (col.primary_key) {
+        stmt->primary_key.push_back({col.name, col.descending_key, {}});
+      }
+    }
+  }
+
+  // Table options follow the column definitions
+  for (token = lexer.nextToken(); token.type() != TokenType::Eof;
+       token = lexer.nextToken()) {
+    if (isKeyword(token, "without") &&
+        isKeyword(lexer.nextToken(), "rowid")) {
+      stmt->without_rowid = true;
+    }
+  }
+
   LOG_DEBUG("Successfully completed parsing CREATE TABLE statement");
   return stmt;
 }
 
-std::optional<WhereClause> SQLParser::parseWhereClause(Lexer &lexer) {
-  LOG_DEBUG("Starting WHERE clause parse");
-  WhereClause clause;
+std::unique_ptr<CreateIndexStatement>
+SQLParser::parseCreateIndexStatement(Lexer &lexer) {
+  auto stmt = std::make_unique<CreateIndexStatement>();
+  auto isName = [](const Token &token) {
+    return token.type() == TokenType::Identifier ||
+           token.type() == TokenType::String;
+  };
 
+  // CREATE [UNIQUE] INDEX [IF NOT EXISTS] name ON table
   auto token = lexer.nextToken();
-  if (token.type() != TokenType::Identifier) {
-    LOG_ERROR("Expected column name, got: " << static_cast<int>(token.type()));
-    throw std::runtime_error("Expected column name in WHERE clause");
+  if (token.type() != TokenType::Create) {
+    throw std::runtime_error("Expected CREATE");
+  }
+  token = lexer.nextToken();
+  if (isKeyword(token, "unique")) {
+    stmt->unique = true;
+    token = lexer.nextToken();
+  }
+  if (!isKeyword(token, "index")) {
+    throw std::runtime_error("Expected INDEX");
+  }
+  token = lexer.nextToken();
+  if (isKeyword(token, "if")) {
+    token = lexer.nextToken(); // NOT
+    token = lexer.nextToken(); // EXISTS
+    token = lexer.nextToken();
   }
-  LOG_DEBUG("Found WHERE column: " << token.value());
-  clause.column = token.value();
+  if (!isName(token)) {
+    throw std::runtime_error("Expected index name");
+  }
+  stmt->index_name = token.value();
+  token = lexer.nextToken();
+  if (token.type() != TokenType::On) {
+    throw std::runtime_error("Expected ON after index name");
+  }
+  token = lexer.nextToken();
+  if (!isName(token)) {
+    throw std::runtime_error("Expected table name");
+  }
+  stmt->table_name = token.value();
+  token = lexer.nextToken();
+  if (token.type() != TokenType::LParen) {
+    throw std::runtime_error("Expected ( after table name");
+  }
+
+  stmt->columns = parseIndexedColumns(lexer, token);
 
+  stmt->partial = lexer.nextToken().type() == TokenType::Where;
+  LOG_DEBUG("Parsed index " << stmt->index_name << " on "
+                            << stmt->table_name << " with "
+                            << stmt->columns.size() << " columns");
+  return stmt;
+}
+
+std::vector<IndexedColumn> SQLParser::parseIndexedColumns(Lexer &lexer,
+                                                          Token &token) {
+  // Each column is a name, or an expression, optionally followed by COLLATE
+  // and ASC or DESC
+  std::vector<IndexedColumn> columns;
+  do {
+    IndexedColumn column;
+    bool expression = false;
+    token = lexer.nextToken();
+    if (token.type() == TokenType::Identifier) {
+      column.name = token.value();
+      token = lexer.nextToken();
+    }
+    int depth = 0;
+    while (depth > 0 || (token.type() != TokenType::Comma &&
+                         token.type() != TokenType::RParen)) {
+      if (token.type() == TokenType::Eof) {
+        throw std::runtime_error("Unterminated column list");
+      }
+      if (token.type() == TokenType::LParen) {
+        ++depth;
+        expression = true;
+      } else if (token.type() == TokenType::RParen) {
+        --depth;
+      } else if (depth == 0 && isKeyword(token, "collate")) {
+        token = lexer.nextToken();
+        column.collation = token.value();
+      } else if (depth == 0 && token.type() == TokenType::Desc) {
+        column.descending = true;
+      } else if (token.type() != TokenType::Asc) {
+        expression = true;
+      }
+      token = lexer.nextToken();
+    }
+    if (expression) {
+      column.name.clear();
+    }
+    columns.push_back(std::move(column));
+  } while (token.type() == TokenType::Comma);
+  return columns;
+}
+
+void SQLParser::skipTableConstraint(Lexer &lexer, Token &token,
+                                    CreateTableStatement &stmt) {
+  // Skips to the comma or parenthesis closing the constraint, keeping the
+  // column list of a PRIMARY KEY
+  int depth = 0;
+  bool after_primary = false;
+  while (depth > 0 || (token.type() != TokenType::Comma &&
+                       token.type() != TokenType::RParen)) {
+    if (token.type() == TokenType::Eof) {
+      throw std::runtime_error("Invalid table constraint");
+    }
+    if (after_primary && token.type() == TokenType::Key) {
+      token = lexer.nextToken();
+      if (token.type() == TokenType::LParen) {
+        stmt.primary_key = parseIndexedColumns(lexer, token);
+        token = lexer.nextToken();
+      }
+      after_primary = false;
+      continue;
+    }
+    if (token.type() == TokenType::LParen) {
+      ++depth;
+    } else if (token.type() == TokenType::RParen) {
+      --depth;
+    }
+    after_primary = token.type() == TokenType::Primary;
+    token = lexer.nextToken();
+  }
+}
+
+void SQLParser::skipColumnConstraints(Lexer &lexer, Token &token,
+                                      Column &col) {
+  // Skips to the comma or parenthesis closing this definition, stepping over
+  // nested parentheses such as VARCHAR(255) or CHECK (...)
+  int depth = 0;
+  bool after_primary = false;
+  while (depth > 0 || (token.type() != TokenType::Comma &&
+                       token.type() != TokenType::RParen)) {
+    LOG_DEBUG(
+        "Processing constraint token: " << static_cast<int>(token.type()));
+    if (token.type() == TokenType::Eof) {
+      LOG_ERROR("Unterminated column definition");
+      throw std::runtime_error("Invalid column constraint");
+    }
+    if (token.type() == TokenType::LParen) {
+      ++depth;
+    } else if (token.type() == TokenType::RParen) {
+      --depth;
+    } else if (after_primary && token.type() == TokenType::Key) {
+      col.primary_key = true;
+    } else if (depth == 0 && isKeyword(token, "collate")) {
+      token = lexer.nextToken();
+      col.collation = token.value();
+    } else if (col.primary_key && token.type() == TokenType::Desc) {
+      col.descending_key = true;
+    }
+    after_primary = token.type() == TokenType::Primary;
+    token = lexer.nextToken();
+  }
+}
+
+ExprPtr SQLParser::parseExpression(Lexer &lexer, Token &token) {
+  return parseOr(lexer, token);
+}
+
+ExprPtr SQLParser::parseOr(Lexer &lexer, Token &token) {
+  std::vector<ExprPtr> terms{parseAnd(lexer, token)};
+  while (token.type() == TokenType::Or) {
+    token = lexer.nextToken();
+    terms.push_back(parseAnd(lexer, token));
+  }
+  return terms.size() == 1
+             ? terms.front()
+             : makeExpr(ExprKind::Or, ExprOp::None, std::move(terms));
+}
+
+ExprPtr SQLParser::parseAnd(Lexer &lexer, Token &token) {
+  std::vector<ExprPtr> terms{parseNot(lexer, token)};
+  while (token.type() == TokenType::And) {
+    token = lexer.nextToken();
+    terms.push_back(parseNot(lexer, token));
+  }
+  return terms.size() == 1
+             ? terms.front()
+             : makeExpr(ExprKind::And, ExprOp::None, std::move(terms));
+}
+
+ExprPtr SQLParser::parseNot(Lexer &lexer, Token &token) {
+  if (token.type() == TokenType::Not) {
+    token = lexer.nextToken();
+    return makeExpr(ExprKind::Not, ExprOp::None, {parseNot(lexer, token)});
+  }
+  return parsePredicate(lexer, token);
+}
+
+ExprPtr SQLParser::parsePredicate(Lexer &lexer, Token &token) {
+  ExprPtr lhs = parseAdditive(lexer, token);
+
+  if (auto op = comparisonOp(token)) {
+    token = lexer.nextToken();
+    return makeExpr(ExprKind::Compare, *op, {lhs, parseAdditive(lexer, token)});
+  }
+
+  if (token.type() == TokenType::Is) {
+    token = lexer.nextToken();
+    bool negated = token.type() == TokenType::Not;
+    if (negated) {
+      token = lexer.nextToken();
+    }
+    if (token.type() != TokenType::Null) {
+      LOG_ERROR("Expected NULL after IS, got: " << token.value());
+      throw std::runtime_error("Only IS [NOT] NULL is supported");
+    }
+    token = lexer.nextToken();
+    return makeExpr(ExprKind::IsNull, ExprOp::None, {lhs}, negated);
+  }
+
+  bool negated = token.type() == TokenType::Not;
+  if (negated) {
+    token = lexer.nextToken();
+  }
+
+  if (token.type() == TokenType::In) {
+    token = lexer.nextToken();
+    if (token.type() != TokenType::LParen) {
+      LOG_ERROR("Expected ( after IN, got: " << token.value());
+      throw std::runtime_error("Expected ( after IN");
+    }
+    std::vector<ExprPtr> operands{lhs};
+    token = lexer.nextToken();
+    while (token.type() != TokenType::RParen) {
+      operands.push_back(parseAdditive(lexer, token));
+      if (token.type() == TokenType::Comma) {
+        token = lexer.nextToken();
+      } else if (token.type() != TokenType::RParen) {
+        LOG_ERROR("Expected , or ) in IN list, got: " << token.value());
+        throw std::runtime_error("Expected , or ) in IN list");
+      }
+    }
+    token = lexer.nextToken();
+    return makeExpr(ExprKind::InList, ExprOp::None, std::move(operands),
+                    negated);
+  }
+
+  if (token.type() == TokenType::Like) {
+    token = lexer.nextToken();
+    return makeExpr(ExprKind::Like, ExprOp::None,
+                    {lhs, parseAdditive(lexer, token)}, negated);
+  }
+
+  if (token.type() == TokenType::Between) {
+    token = lexer.nextToken();
+    ExprPtr low = parseAdditive(lexer, token);
+    if (token.type() != TokenType::And) {
+      LOG_ERROR("Expected AND in BETWEEN, got: " << token.value());
+      throw std::runtime_error("Expected AND in BETWEEN");
+    }
+    token = lexer.nextToken();
+    ExprPtr high = parseAdditive(lexer, token);
+    ExprPtr range = makeExpr(
+        ExprKind::And, ExprOp::None,
+        {makeExpr(ExprKind::Compare, ExprOp::Ge, {lhs, low}),
+         makeExpr(ExprKind::Compare, ExprOp::Le, {lhs, high})});
+    return negated ? makeExpr(ExprKind::Not, ExprOp::None, {range}) : range;
+  }
+
+  if (negated) {
+    LOG_ERROR("Expected IN, LIKE or BETWEEN after NOT, got: "
+              << token.value());
+    throw std::runtime_error("Expected IN, LIKE or BETWEEN after NOT");
+  }
+  return lhs;
+}
+
+ExprPtr SQLParser::parseAdditive(Lexer &lexer, Token &token) {
+  ExprPtr lhs = parseMultiplicative(lexer, token);
+  while (token.type() == TokenType::Operator &&
+         (token.value() == "+" || token.value() == "-")) {
+    ExprOp op = token.value() == "+" ? ExprOp::Add : ExprOp::Sub;
+    token = lexer.nextToken();
+    lhs = makeExpr(ExprKind::Arithmetic, op,
+                   {lhs, parseMultiplicative(lexer, token)});
+  }
+  return lhs;
+}
+
+ExprPtr SQLParser::parseMultiplicative(Lexer &lexer, Token &token) {
+  ExprPtr lhs = parseUnary(lexer, token);
+  while (token.type() == TokenType::Star ||
+         (token.type() == TokenType::Operator &&
+          (token.value() == "/" || token.value() == "%"))) {
+    ExprOp op = token.type() == TokenType::Star ? ExprOp::Mul
+                : token.value() == "/"          ? ExprOp::Div
+                                                : ExprOp::Mod;
+    token = lexer.nextToken();
+    lhs = makeExpr(ExprKind::Arithmetic, op, {lhs, parseUnary(lexer, token)});
+  }
+  return lhs;
+}
+
+ExprPtr SQLParser::parseUnary(Lexer &lexer, Token &token) {
+  if (token.type() == TokenType::Operator &&
+      (token.value() == "-" || token.value() == "+")) {
+    bool minus = token.value() == "-";
+    token = lexer.nextToken();
+    ExprPtr operand = parseUnary(lexer, token);
+    if (!minus) {
+      return operand;
+    }
+    // Fold negative numeric literals so they can still drive index seeks
+    if (operand->kind == ExprKind::Literal) {
+      if (const auto *integer = std::get_if<int64_t>(&operand->value);
+          integer && *integer != INT64_MIN) {
+        return makeLiteral(-*integer);
+      }
+      if (const auto *real = std::get_if<double>(&operand->value)) {
+        return makeLiteral(-*real);
+      }
+    }
+    return makeExpr(ExprKind::Negate, ExprOp::None, {operand});
+  }
+  return parsePrimary(lexer, token);
+}
+
+ExprPtr SQLParser::parsePrimary(Lexer &lexer, Token &token) {
+  ExprPtr expr;
+  switch (token.type()) {
+  case TokenType::Number:
+    expr = makeLiteral(parseNumber(token.value()));
+    break;
+  case TokenType::String:
+    expr = makeLiteral(token.value());
+    break;
+  case TokenType::Null:
+    expr = makeLiteral(std::monostate{});
+    break;
+  case TokenType::Identifier:
+    expr = makeColumnRef(token.value());
+    break;
+  case TokenType::LParen:
+    token = lexer.nextToken();
+    expr = parseExpression(lexer, token);
+    if (token.type() != TokenType::RParen) {
+      LOG_ERROR("Expected ), got: " << token.value());
+      throw std::runtime_error("Expected ) in expression");
+    }
+    break;
+  default:
+    LOG_ERROR("Expected expression, got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected expression in WHERE clause");
+  }
   token = lexer.nextToken();
-  if (token.type() != TokenType::Operator) {
-    LOG_ERROR("Expected operator, got: " << static_cast<int>(token.type()));
-    throw std::runtime_error("Expected operator in WHERE clause");
+  return expr;
+}
+Token SQLParser::parseTableAlias(Lexer &lexer, std::string &alias) {
+  auto token = lexer.nextToken();
+  if (token.type() == TokenType::As) {
+    token = lexer.nextToken();
+    if (token.type() != TokenType::Identifier) {
+      LOG_ERROR("Expected alias after AS, got: "
+                << static_cast<int>(token.type()));
+      throw std::runtime_error("Expected alias after AS");
+    }
+  }
+  if (token.type() == TokenType::Identifier) {
+    alias = token.value();
+    LOG_DEBUG("Found table alias: " << alias);
+    token = lexer.nextToken();
+  }
+  return token;
+}
+
+Token SQLParser::parseJoinClause(Lexer &lexer, Token token,
+                                 SelectStatement &stmt) {
+  JoinClause join;
+  if (token.type() == TokenType::Left) {
+    join.type = JoinType::Left;
+    token = lexer.nextToken();
+    if (token.type() == TokenType::Outer) {
+      token = lexer.nextToken();
+    }
+  } else if (token.type() == TokenType::Inner) {
+    token = lexer.nextToken();
+  }
+
+  if (token.type() != TokenType::Join) {
+    LOG_ERROR("Expected JOIN, got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected JOIN");
   }
-  LOG_DEBUG("Found WHERE operator: " << token.value());
-  clause.operator_type = token.value();
 
   token = lexer.nextToken();
-  if (token.type() != TokenType::Identifier &&
-      token.type() != TokenType::String) {
-    LOG_ERROR("Expected value, got: " << static_cast<int>(token.type()));
-    throw std::runtime_error("Expected value in WHERE clause");
+  if (token.type() != TokenType::Identifier) {
+    LOG_ERROR("Expected join table, got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected table name after JOIN");
+  }
+  join.table_name = token.value();
+
+  token = parseTableAlias(lexer, join.alias);
+  if (token.type() != TokenType::On) {
+    LOG_ERROR("Expected ON, got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected ON after join table");
+  }
+
+  auto left = lexer.nextToken();
+  auto op = lexer.nextToken();
+  auto right = lexer.nextToken();
+  if (left.type() != TokenType::Identifier || op.value() != "=" ||
+      right.type() != TokenType::Identifier) {
+    LOG_ERROR("Expected equi-join condition in ON clause");
+    throw std::runtime_error("Only equi-join ON conditions are supported");
+  }
+  join.left_column = left.value();
+  join.right_column = right.value();
+
+  LOG_DEBUG("Found join on " << join.left_column << " = "
+                             << join.right_column);
+  stmt.join = std::move(join);
+  return lexer.nextToken();
+}
+
+Token SQLParser::parseOrderByClause(Lexer &lexer, SelectStatement &stmt) {
+  auto token = lexer.nextToken();
+  if (token.type() != TokenType::By) {
+    LOG_ERROR("Expected BY, got: " << static_cast<int>(token.type()));
+    throw std::runtime_error("Expected BY after ORDER");
   }
-  LOG_DEBUG("Found WHERE value: " << token.value());
-  clause.value = token.value();
 
-  LOG_DEBUG("Completed parsing WHERE clause");
-  return clause;
+  while (true) {
+    token = lexer.nextToken();
+    if (token.type() != TokenType::Identifier) {
+      LOG_ERROR("Expected ORDER BY column, got: "
+                << static_cast<int>(token.type()));
+      throw std::runtime_error("Expected column name in ORDER BY");
+    }
+
+    OrderByTerm term;
+    term.column = token.value();
+
+    token = lexer.nextToken();
+    if (token.type() == TokenType::Asc || token.type() == TokenType::Desc) {
+      term.descending = token.type() == TokenType::Desc;
+      token = lexer.nextToken();
+    }
+
+    LOG_DEBUG("Found ORDER BY term: " << term.column
+                                      << (term.descending ? " DESC" : " ASC"));
+    stmt.order_by.push_back(std::move(term));
+
+    if (token.type() != TokenType::Comma) {
+      return token;
+    }
+  }
+}
+
+std::optional<uint64_t> SQLParser::parseLimitValue(Lexer &lexer) {
+  auto token = lexer.nextToken();
+  bool negative = false;
+  if (token.type() == TokenType::Operator &&
+      (token.value() == "-" || token.value() == "+")) {
+    negative = token.value() == "-";
+    token = lexer.nextToken();
+  }
+  const std::string &text = token.value();
+  if (token.type() != TokenType::Number || text.empty() ||
+      text.find_first_not_of("0123456789") != std::string::npos) {
+    LOG_ERROR("Expected integer, got: " << text);
+    throw std::runtime_error("Expected integer in LIMIT/OFFSET clause");
+  }
+  uint64_t value = std::stoull(text);
+  if (negative && value > 0) {
+    return std::nullopt;
+  }
+  return value;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "expression.hpp"
 #include "lexer.hpp"
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
@@ -9,35 +11,120 @@
 struct Column {
   std::string name;
   std::string type;
+  bool primary_key{false};
+  // PRIMARY KEY DESC
+  bool descending_key{false};
+  // The COLLATE name as written; empty for BINARY
+  std::string collation;
+};
+
+struct IndexedColumn {
+  // Empty when the index is on an expression rather than a column
+  std::string name;
+  bool descending{false};
+  // The COLLATE name as written; empty for the column's own
+  std::string collation;
+};
+
+struct CreateIndexStatement {
+  std::string index_name;
+  std::string table_name;
+  // In key order: entries sort by the first column, then the second...
+  std::vector<IndexedColumn> columns;
+  bool unique{false};
+  // Partial indexes (CREATE INDEX ... WHERE) hold only some of the rows
+  bool partial{false};
 };
 
 struct CreateTableStatement {
   std::string table_name;
   std::vector<Column> columns;
+  // In key order, from a PRIMARY KEY column or table constraint
+  std::vector<IndexedColumn> primary_key;
+  bool without_rowid{false};
+};
+
+struct OrderByTerm {
+  std::string column;
+  bool descending{false};
 };
 
-struct WhereClause {
+enum class AggregateFunction { Min, Max };
+
+struct AggregateTerm {
+  AggregateFunction function;
   std::string column;
-  std::string operator_type;
-  std::string value;
+};
+
+enum class JoinType { Inner, Left };
+
+struct JoinClause {
+  JoinType type{JoinType::Inner};
+  std::string table_name;
+  std::string alias;
+  // ON operands as written; either may be qualified with a table or alias
+  std::string left_column;
+  std::string right_column;
 };
 
 struct SelectStatement {
   std::string table_name;
+  std::string table_alias;
   std::vector<std::string> column_names;
   bool is_count_star{false};
-  std::optional<WhereClause> where_clause;
+  // MIN/MAX terms of an aggregate select list, one per output column
+  std::vector<AggregateTerm> aggregates;
+  std::optional<JoinClause> join;
+  ExprPtr where_clause;
+  std::vector<OrderByTerm> order_by;
+  std::optional<uint64_t> limit;
+  std::optional<uint64_t> offset;
 };
 
+// Splits "table.column" into {"table", "column"}; bare names get an empty
+// qualifier.
+std::pair<std::string, std::string>
+splitQualifiedName(const std::string &name);
+
 class SQLParser {
 public:
   static std::unique_ptr<SelectStatement> parseSelect(const std::string &sql);
   static std::unique_ptr<CreateTableStatement>
   parseCreate(const std::string &sql);
+  static std::unique_ptr<CreateIndexStatement>
+  parseCreateIndex(const std::string &sql);
 
 private:
   static std::unique_ptr<SelectStatement> parseSelectStatement(Lexer &lexer);
   static std::unique_ptr<CreateTableStatement>
   parseCreateStatement(Lexer &lexer);
-  static std::optional<WhereClause> parseWhereClause(Lexer &lexer);
+  static std::unique_ptr<CreateIndexStatement>
+  parseCreateIndexStatement(Lexer &lexer);
+  // Parses the list after `(`, leaving `token` on the closing `)`
+  static std::vector<IndexedColumn> parseIndexedColumns(Lexer &lexer,
+                                                        Token &token);
+  static void skipTableConstraint(Lexer &lexer, Token &token,
+                                  CreateTableStatement &stmt);
+  static void skipColumnConstraints(Lexer &lexer, Token &token, Column &col);
+  // Parses `(column)` after the name of MIN or MAX
+  static AggregateTerm parseAggregate(Lexer &lexer,
+                                      const std::string &function);
+
+  // Expression parsers take the current token and leave `token` on the
+  // first token after the expression.
+  static ExprPtr parseExpression(Lexer &lexer, Token &token);
+  static ExprPtr parseOr(Lexer &lexer, Token &token);
+  static ExprPtr parseAnd(Lexer &lexer, Token &token);
+  static ExprPtr parseNot(Lexer &lexer, Token &token);
+  static ExprPtr parsePredicate(Lexer &lexer, Token &token);
+  static ExprPtr parseAdditive(Lexer &lexer, Token &token);
+  static ExprPtr parseMultiplicative(Lexer &lexer, Token &token);
+  static ExprPtr parseUnary(Lexer &lexer, Token &token);
+  static ExprPtr parsePrimary(Lexer &lexer, Token &token);
+  static Token parseTableAlias(Lexer &lexer, std::string &alias);
+  static Token parseJoinClause(Lexer &lexer, Token token,
+                               SelectStatement &stmt);
+  static Token parseOrderByClause(Lexer &lexer, SelectStatement &stmt);
+  // A signed integer; nullopt when it is negative
+  static std::optional<uint64_t> parseLimitValue(Lexer &lexer);
 };
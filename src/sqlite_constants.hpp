@@ -3,12 +3,15 @@
 #include "btree_record.hpp"
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace sqlite {
 
 // Page and header sizes
 constexpr size_t HEADER_SIZE = 100;
+// Offset of the file change counter, bumped by every write transaction
+constexpr size_t CHANGE_COUNTER_OFFSET = 24;
 constexpr size_t SCHEMA_PAGE = 1;
 
 // Record type identifiers
@@ -61,5 +64,7 @@ struct Header {
 
 using Row = std::vector<RecordValue>;
 using QueryResult = std::vector<Row>;
+// Receives result rows one at a time; returning false stops the producer.
+using RowSink = std::function<bool(Row &&)>;
 
 } // namespace sqlite
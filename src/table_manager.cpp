@@ -50,12 +50,6 @@ uint32_t TableManager::getTableRootPage(const std::string &table_name) const {
   throw std::runtime_error("Table not found: " + table_name);
 }
 
-uint32_t TableManager::getTableRowCount(const std::string &table_name) const {
-  uint32_t root_page = getTableRootPage(table_name);
-  BTreePage<PageType::LeafTable> page(_reader, _header.page_size, root_page);
-  return page.getHeader().cell_count;
-}
-
 SchemaRecord TableManager::getTableSchema(const std::string &table_name) const {
   BTreePage<PageType::LeafTable> schema_page(_reader, _header.page_size,
                                              sqlite::SCHEMA_PAGE);
@@ -9,7 +9,6 @@ public:
   bool isTableRecord(const std::vector<uint8_t> &payload) const;
   bool isUserTable(const SchemaRecord &record) const;
   uint32_t getTableRootPage(const std::string &table_name) const;
-  uint32_t getTableRowCount(const std::string &table_name) const;
   SchemaRecord getTableSchema(const std::string &table_name) const;
 
 private:
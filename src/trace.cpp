@@ -0,0 +1,129 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Single-producer ring: only the owning thread writes, and it publishes
+// each record by advancing `head` with release order.
+struct TraceBuffer {
+  explicit TraceBuffer(uint32_t thread_id)
+      : thread_id(thread_id), records(TRACE_BUFFER_RECORDS) {}
+
+  uint32_t thread_id;
+  std::vector<TraceRecord> records;
+  std::atomic<uint64_t> head{0};
+};
+
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+};
+
+// Buffers outlive their threads so that a dump still sees them
+TraceRegistry &registry() {
+  static TraceRegistry instance;
+  return instance;
+}
+
+TraceBuffer &threadBuffer() {
+  thread_local std::shared_ptr<TraceBuffer> buffer = [] {
+    TraceRegistry &traces = registry();
+    std::lock_guard lock(traces.mutex);
+    auto created = std::make_shared<TraceBuffer>(
+        static_cast<uint32_t>(traces.buffers.size() + 1));
+    traces.buffers.push_back(created);
+    return created;
+  }();
+  return *buffer;
+}
+
+void writeEscaped(std::ostream &out, const char *text) {
+  for (; *text != '\0'; ++text) {
+    if (*text == '"' || *text == '\\') {
+      out << '\\';
+    }
+    out << *text;
+  }
+}
+
+} // namespace
+
+void setTracingEnabled(bool enabled) noexcept {
+  tracing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t traceClock() noexcept {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count()) |
+         1;
+}
+
+void recordTrace(const TraceRecord &record) noexcept {
+  TraceBuffer &buffer = threadBuffer();
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  buffer.records[head & (TRACE_BUFFER_RECORDS - 1)] = record;
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void writeChromeTrace(std::ostream &out) {
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  {
+    std::lock_guard lock(registry().mutex);
+    buffers = registry().buffers;
+  }
+
+  // Timestamps are rebased on the earliest record and written in
+  // microseconds, as the format expects
+  struct Snapshot {
+    uint32_t thread_id;
+    std::vector<TraceRecord> records;
+  };
+  std::vector<Snapshot> snapshots;
+  uint64_t origin = UINT64_MAX;
+  for (const auto &buffer : buffers) {
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t first = head > TRACE_BUFFER_RECORDS ? head - TRACE_BUFFER_RECORDS
+                                                 : 0;
+    Snapshot snapshot{buffer->thread_id, {}};
+    snapshot.records.reserve(head - first);
+    for (uint64_t i = first; i < head; ++i) {
+      snapshot.records.push_back(
+          buffer->records[i & (TRACE_BUFFER_RECORDS - 1)]);
+      origin = std::min(origin, snapshot.records.back().start_ns);
+    }
+    snapshots.push_back(std::move(snapshot));
+  }
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first_event = true;
+  for (const auto &snapshot : snapshots) {
+    for (const auto &record : snapshot.records) {
+      out << (first_event ? "\n" : ",\n") << "{\"name\":\"";
+      writeEscaped(out, record.name);
+      out << "\",\"ph\":\"" << record.phase << "\",\"pid\":1,\"tid\":"
+          << snapshot.thread_id
+          << ",\"ts\":" << static_cast<double>(record.start_ns - origin) / 1e3;
+      if (record.phase == 'X') {
+        out << ",\"dur\":" << static_cast<double>(record.duration_ns) / 1e3;
+      } else {
+        out << ",\"s\":\"t\"";
+      }
+      out << ",\"args\":{\"arg\":" << record.arg << "}}";
+      first_event = false;
+    }
+  }
+  out << "\n]}\n";
+}
+
+void clearTraces() noexcept {
+  std::lock_guard lock(registry().mutex);
+  for (const auto &buffer : registry().buffers) {
+    buffer->head.store(0, std::memory_order_release);
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// One span ('X') or instant event ('i'). Names must be string literals: only
+// the pointer is stored.
+struct TraceRecord {
+  const char *name;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  uint64_t arg;
+  char phase;
+};
+
+// Records kept per thread; older ones are overwritten once the ring is full
+constexpr uint64_t TRACE_BUFFER_RECORDS = 1 << 16;
+
+inline std::atomic<bool> tracing_enabled{false};
+
+[[nodiscard]] inline bool tracingEnabled() noexcept {
+  return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void setTracingEnabled(bool enabled) noexcept;
+
+// Steady-clock nanoseconds; never zero
+[[nodiscard]] uint64_t traceClock() noexcept;
+
+// Appends to the calling thread's ring buffer without taking any lock
+void recordTrace(const TraceRecord &record) noexcept;
+
+inline void traceInstant(const char *name, uint64_t arg = 0) noexcept {
+  if (tracingEnabled()) {
+    recordTrace({name, traceClock(), 0, arg, 'i'});
+  }
+}
+
+// Records the time between its construction and destruction as a span.
+// Costs one relaxed load when tracing is off.
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name, uint64_t arg = 0) noexcept
+      : name_(name), arg_(arg),
+        start_ns_(tracingEnabled() ? traceClock() : 0) {}
+  ~TraceSpan() {
+    if (start_ns_ != 0 && tracingEnabled()) {
+      recordTrace({name_, start_ns_, traceClock() - start_ns_, arg_, 'X'});
+    }
+  }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *name_;
+  uint64_t arg_;
+  uint64_t start_ns_;
+};
+
+// Writes every thread's buffered records as Chrome trace-event JSON, which
+// chrome://tracing and Perfetto load directly. Threads still recording may
+// overwrite their oldest records while this runs.
+void writeChromeTrace(std::ostream &out);
+
+// Drops all buffered records
+void clearTraces() noexcept;
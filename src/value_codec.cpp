@@ -0,0 +1,74 @@
+#include "value_codec.hpp"
+#include <cstring>
+
+namespace value_codec {
+
+namespace {
+
+enum class ValueTag : uint8_t { Null, Integer, Real, Text, Blob };
+
+void appendBytes(std::vector<uint8_t> &out, const uint8_t *data,
+                 size_t length) {
+  appendU64(out, length);
+  out.insert(out.end(), data, data + length);
+}
+
+} // namespace
+
+void appendU64(std::vector<uint8_t> &out, uint64_t value) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void appendValue(std::vector<uint8_t> &out, const RecordValue &value) {
+  out.push_back(static_cast<uint8_t>(value.index()));
+
+  if (const auto *integer = std::get_if<int64_t>(&value)) {
+    appendU64(out, static_cast<uint64_t>(*integer));
+  } else if (const auto *real = std::get_if<double>(&value)) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, real, sizeof(bits));
+    appendU64(out, bits);
+  } else if (const auto *text = std::get_if<std::string>(&value)) {
+    appendBytes(out, reinterpret_cast<const uint8_t *>(text->data()),
+                text->size());
+  } else if (const auto *blob = std::get_if<std::vector<uint8_t>>(&value)) {
+    appendBytes(out, blob->data(), blob->size());
+  }
+}
+
+std::optional<RecordValue> readValue(ByteReader &reader) {
+  if (reader.remaining() < 1) {
+    return std::nullopt;
+  }
+  auto tag = static_cast<ValueTag>(reader.readU8());
+  if (tag == ValueTag::Null) {
+    return RecordValue{};
+  }
+  if (reader.remaining() < sizeof(uint64_t)) {
+    return std::nullopt;
+  }
+  switch (tag) {
+  case ValueTag::Integer:
+    return reader.readI64();
+  case ValueTag::Real:
+    return reader.readDouble();
+  case ValueTag::Text:
+  case ValueTag::Blob: {
+    uint64_t length = reader.readU64();
+    if (reader.remaining() < length) {
+      return std::nullopt;
+    }
+    auto data = reader.readBytes(length);
+    if (tag == ValueTag::Text) {
+      return std::string(data.begin(), data.end());
+    }
+    return data;
+  }
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace value_codec
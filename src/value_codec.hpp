@@ -0,0 +1,21 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include "byte_reader.hpp"
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// A self-describing binary form of record values, shared by sort runs and
+// resume tokens: a type tag, then the 8 bytes of a number, or the length
+// and bytes of TEXT and BLOB. Integers are big-endian.
+namespace value_codec {
+
+void appendU64(std::vector<uint8_t> &out, uint64_t value);
+void appendValue(std::vector<uint8_t> &out, const RecordValue &value);
+
+// The value at the reader's position; nullopt when the bytes there are not
+// one appendValue() wrote
+std::optional<RecordValue> readValue(ByteReader &reader);
+
+} // namespace value_codec
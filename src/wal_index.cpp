@@ -0,0 +1,296 @@
+#include "wal_index.hpp"
+#include "debug.hpp"
+#include "file_reader.hpp"
+#include "query_stats.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Magic numbers of logs whose checksums read words little- or big-endian
+constexpr uint32_t WAL_MAGIC = 0x377f0682;
+constexpr size_t WAL_HEADER_SIZE = 32;
+constexpr size_t FRAME_HEADER_SIZE = 24;
+
+// The shared memory's count of frames checkpointed into the main file and
+// read marks (host-order frame counts, the first one standing for the main
+// file alone), and the bytes its locks are taken on
+constexpr off_t SHM_BACKFILL_OFFSET = 96;
+constexpr off_t SHM_READ_MARKS_OFFSET = 100;
+constexpr int READ_MARK_COUNT = 5;
+constexpr uint32_t READ_MARK_UNUSED = 0xffffffff;
+constexpr off_t SHM_READ_LOCK_OFFSET = 120 + 3;
+
+// A shared lock on a byte of the shared memory, as SQLite takes them;
+// F_UNLCK releases it
+bool lockShmByte(int fd, off_t offset, short type) {
+  struct flock lock {};
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = offset;
+  lock.l_len = 1;
+  return fcntl(fd, F_SETLK, &lock) == 0;
+}
+
+uint32_t bigEndian32(const uint8_t *bytes) {
+  return static_cast<uint32_t>(bytes[0]) << 24 |
+         static_cast<uint32_t>(bytes[1]) << 16 |
+         static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+}
+
+uint32_t littleEndian32(const uint8_t *bytes) {
+  return static_cast<uint32_t>(bytes[3]) << 24 |
+         static_cast<uint32_t>(bytes[2]) << 16 |
+         static_cast<uint32_t>(bytes[1]) << 8 | bytes[0];
+}
+
+// SQLite's running log checksum: two sums over pairs of 32-bit words, each
+// folding in the other
+struct Checksum {
+  bool big_endian;
+  uint32_t s0{0};
+  uint32_t s1{0};
+
+  void add(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+      uint32_t x0 = big_endian ? bigEndian32(data + i)
+                               : littleEndian32(data + i);
+      uint32_t x1 = big_endian ? bigEndian32(data + i + 4)
+                               : littleEndian32(data + i + 4);
+      s0 += x0 + s1;
+      s1 += x1 + s0;
+    }
+  }
+
+  [[nodiscard]] bool matches(const uint8_t *stored) const {
+    return s0 == bigEndian32(stored) && s1 == bigEndian32(stored + 4);
+  }
+};
+
+} // namespace
+
+std::unique_ptr<WalIndex> WalIndex::open(const std::string &database_filename) {
+  std::string filename = database_filename + "-wal";
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::unique_ptr<WalIndex> wal(new WalIndex(fd, std::move(filename)));
+  if (!wal->load()) {
+    return nullptr;
+  }
+  LOG_INFO("Indexed " << wal->frameCount() << " WAL frames holding "
+                      << wal->pageCount() << " pages");
+  return wal;
+}
+
+WalIndex::WalIndex(int fd, std::string filename)
+    : fd_(fd), filename_(std::move(filename)),
+      shm_fd_(::open((filename_.substr(0, filename_.size() - 4) + "-shm")
+                         .c_str(),
+                     O_RDONLY | O_CLOEXEC)) {}
+
+WalIndex::~WalIndex() {
+  unlockReadMark();
+  if (shm_fd_ >= 0) {
+    close(shm_fd_);
+  }
+  close(fd_);
+}
+
+bool WalIndex::read(uint32_t page_number, size_t offset, void *buffer,
+                    size_t length) const {
+  auto it = frames_.find(page_number);
+  if (it == frames_.end()) {
+    return false;
+  }
+  if (offset + length > page_size_ ||
+      !readFully(fd_, static_cast<uint8_t *>(buffer), length,
+                 static_cast<off_t>(it->second + offset))) {
+    throw std::runtime_error("Failed to read file: " + filename_);
+  }
+  return true;
+}
+
+bool WalIndex::refresh() {
+  struct stat on_disk {};
+  struct stat opened {};
+  if (::stat(filename_.c_str(), &on_disk) != 0 || fstat(fd_, &opened) != 0 ||
+      on_disk.st_ino != opened.st_ino || on_disk.st_dev != opened.st_dev) {
+    return false;
+  }
+  if (currentSalt() != salt_) {
+    LOG_INFO("Write-ahead log restarted; indexing it again");
+    return load();
+  }
+  uint64_t indexed = frame_count_;
+  scanFrames();
+  if (frame_count_ != indexed) {
+    LOG_INFO("Indexed " << frame_count_ - indexed << " new WAL frames");
+  }
+  return true;
+}
+
+bool WalIndex::load() {
+  frames_.clear();
+  database_pages_ = 0;
+  frame_count_ = 0;
+  auto salt = readHeader();
+  if (!salt) {
+    return false;
+  }
+  salt_ = *salt;
+  scanFrames();
+  return frame_count_ > 0;
+}
+
+std::optional<uint64_t> WalIndex::readHeader() {
+  uint8_t header[WAL_HEADER_SIZE];
+  if (!readFully(fd_, header, sizeof(header), 0)) {
+    return std::nullopt;
+  }
+  uint32_t magic = bigEndian32(header);
+  page_size_ = bigEndian32(header + 8);
+  if ((magic & ~1u) != WAL_MAGIC || page_size_ < 512 || page_size_ > 65536 ||
+      (page_size_ & (page_size_ - 1)) != 0) {
+    LOG_INFO("Ignoring " << filename_ << ": not a write-ahead log");
+    return std::nullopt;
+  }
+  Checksum checksum{(magic & 1) != 0};
+  checksum.add(header, 24);
+  if (!checksum.matches(header + 24)) {
+    LOG_INFO("Ignoring " << filename_ << ": header checksum mismatch");
+    return std::nullopt;
+  }
+  big_endian_ = checksum.big_endian;
+  checksum_[0] = checksum.s0;
+  checksum_[1] = checksum.s1;
+  end_offset_ = WAL_HEADER_SIZE;
+  return static_cast<uint64_t>(bigEndian32(header + 16)) << 32 |
+         bigEndian32(header + 20);
+}
+
+std::optional<uint64_t> WalIndex::currentSalt() const {
+  uint8_t header[WAL_HEADER_SIZE];
+  if (!readFully(fd_, header, sizeof(header), 0)) {
+    return std::nullopt;
+  }
+  uint32_t magic = bigEndian32(header);
+  Checksum checksum{(magic & 1) != 0};
+  checksum.add(header, 24);
+  if ((magic & ~1u) != WAL_MAGIC || !checksum.matches(header + 24)) {
+    return std::nullopt;
+  }
+  return static_cast<uint64_t>(bigEndian32(header + 16)) << 32 |
+         bigEndian32(header + 20);
+}
+
+void WalIndex::scanFrames() {
+  const auto salt1 = static_cast<uint32_t>(salt_ >> 32);
+  const auto salt2 = static_cast<uint32_t>(salt_);
+
+  // Frames count once their transaction's commit frame validates; the log
+  // ends at the first frame left over from an earlier log or half written
+  Checksum checksum{big_endian_, checksum_[0], checksum_[1]};
+  std::vector<uint8_t> frame(FRAME_HEADER_SIZE + page_size_);
+  std::unordered_map<uint32_t, uint64_t> pending;
+  uint64_t offset = end_offset_;
+  while (readFully(fd_, frame.data(), frame.size(),
+                   static_cast<off_t>(offset))) {
+    countStat(&QueryStats::bytes_read, frame.size());
+    uint32_t page_number = bigEndian32(frame.data());
+    uint32_t commit_pages = bigEndian32(frame.data() + 4);
+    if (page_number == 0 || bigEndian32(frame.data() + 8) != salt1 ||
+        bigEndian32(frame.data() + 12) != salt2) {
+      break;
+    }
+    checksum.add(frame.data(), 8);
+    checksum.add(frame.data() + FRAME_HEADER_SIZE, page_size_);
+    if (!checksum.matches(frame.data() + 16)) {
+      break;
+    }
+
+    pending[page_number] = offset + FRAME_HEADER_SIZE;
+    offset += frame.size();
+    if (commit_pages != 0) {
+      for (const auto &[page, data] : pending) {
+        frames_[page] = data;
+      }
+      pending.clear();
+      database_pages_ = commit_pages;
+      frame_count_ = (offset - WAL_HEADER_SIZE) / frame.size();
+      end_offset_ = offset;
+      checksum_[0] = checksum.s0;
+      checksum_[1] = checksum.s1;
+    }
+  }
+}
+
+bool WalIndex::lockReadMark() {
+  unlockReadMark();
+  if (shm_fd_ < 0) {
+    return true;
+  }
+  auto readU32 = [this](off_t offset, uint32_t &value) {
+    return readFully(shm_fd_, reinterpret_cast<uint8_t *>(&value),
+                     sizeof(value), offset);
+  };
+  uint32_t marks[READ_MARK_COUNT];
+  if (!readFully(shm_fd_, reinterpret_cast<uint8_t *>(marks), sizeof(marks),
+                 SHM_READ_MARKS_OFFSET)) {
+    return true;
+  }
+
+  // The latest mark the frames indexed cover; a later one means commits
+  // this index has not seen
+  bool later = false;
+  for (int attempt = 0; attempt < READ_MARK_COUNT; ++attempt) {
+    int best = -1;
+    for (int i = 1; i < READ_MARK_COUNT; ++i) {
+      if (marks[i] == READ_MARK_UNUSED) {
+        continue;
+      }
+      if (marks[i] > frame_count_) {
+        later = true;
+      } else if (best == -1 || marks[i] > marks[best]) {
+        best = i;
+      }
+    }
+    if (best == -1) {
+      break;
+    }
+    if (lockShmByte(shm_fd_, SHM_READ_LOCK_OFFSET + best, F_RDLCK)) {
+      // The mark must still be the one chosen, the log the one indexed, and
+      // no later frame copied into the main file before the lock was held
+      uint32_t mark = 0;
+      uint32_t backfilled = 0;
+      if (readU32(SHM_READ_MARKS_OFFSET + best * sizeof(mark), mark) &&
+          mark == marks[best] && readU32(SHM_BACKFILL_OFFSET, backfilled) &&
+          backfilled <= frame_count_ && currentSalt() == salt_) {
+        read_lock_ = best;
+        return true;
+      }
+      lockShmByte(shm_fd_, SHM_READ_LOCK_OFFSET + best, F_UNLCK);
+      return false;
+    }
+    // A checkpoint is moving that mark; try the others
+    marks[best] = READ_MARK_UNUSED;
+  }
+  if (later) {
+    return false;
+  }
+  LOG_INFO("No read mark of " << filename_
+                              << " to hold; reading without one");
+  return true;
+}
+
+void WalIndex::unlockReadMark() {
+  if (read_lock_ >= 0) {
+    lockShmByte(shm_fd_, SHM_READ_LOCK_OFFSET + read_lock_, F_UNLCK);
+    read_lock_ = -1;
+  }
+}
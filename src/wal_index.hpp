@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// The committed frames of a database's write-ahead log (its "-wal" file),
+// opened read-only. Pages that committed transactions wrote but no
+// checkpoint has copied back yet are read from their latest frame instead
+// of the main file, so that live WAL databases need no checkpoint first.
+// refresh() takes in commits made since, and a read mark in the log's
+// shared memory ("-shm") keeps checkpoints off the frames being read.
+class WalIndex {
+public:
+  // Indexes `<database>-wal` when there is one holding committed frames;
+  // null otherwise, when the main file alone is current
+  static std::unique_ptr<WalIndex> open(const std::string &database_filename);
+
+  ~WalIndex();
+
+  WalIndex(const WalIndex &) = delete;
+  WalIndex &operator=(const WalIndex &) = delete;
+
+  // Re-reads the header and indexes the transactions committed past the
+  // last one indexed, or the whole log again once a checkpoint has
+  // restarted it. False when the file is gone, replaced or holds no
+  // committed frames any more; the caller opens the log afresh.
+  bool refresh();
+
+  // Holds a read mark of the shared memory no later than the last frame
+  // indexed, as SQLite's own readers do: while it is held, checkpoints copy
+  // no later frame into the main file and do not restart the log. False
+  // when the log has moved on since it was indexed, and should be
+  // refreshed first; true otherwise, also when no mark could be held.
+  bool lockReadMark();
+  void unlockReadMark();
+
+  // Copies `length` bytes at `offset` within the page from its latest
+  // committed frame; false when the log holds no frame of the page
+  bool read(uint32_t page_number, size_t offset, void *buffer,
+            size_t length) const;
+
+  [[nodiscard]] bool contains(uint32_t page_number) const {
+    return frames_.count(page_number) != 0;
+  }
+
+  [[nodiscard]] uint32_t pageSize() const noexcept { return page_size_; }
+
+  // Size of the database in pages as of the last commit
+  [[nodiscard]] uint32_t databasePages() const noexcept {
+    return database_pages_;
+  }
+
+  // Frames validated, up to and including the last commit frame
+  [[nodiscard]] uint64_t frameCount() const noexcept { return frame_count_; }
+
+  // Distinct pages the log holds
+  [[nodiscard]] size_t pageCount() const noexcept { return frames_.size(); }
+
+  // Both header salts; they change whenever a checkpoint restarts the log
+  [[nodiscard]] uint64_t salt() const noexcept { return salt_; }
+
+private:
+  WalIndex(int fd, std::string filename);
+
+  // Validates the header and the frames' salts and running checksums, and
+  // indexes the frames of every complete transaction
+  bool load();
+  // The salts of a valid header, which also starts the running checksum
+  std::optional<uint64_t> readHeader();
+  // Indexes the complete transactions from the end of the last one
+  void scanFrames();
+  // The salts the header on disk holds now; nullopt when it is not valid
+  [[nodiscard]] std::optional<uint64_t> currentSalt() const;
+
+  int fd_;
+  std::string filename_;
+  // `<database>-shm`, or -1 when there is none to hold a read mark in
+  int shm_fd_;
+  // The read mark held, or -1
+  int read_lock_{-1};
+  uint32_t page_size_{0};
+  uint32_t database_pages_{0};
+  uint64_t frame_count_{0};
+  uint64_t salt_{0};
+  // The running checksum, and the offset the frames after the last
+  // committed one start at
+  bool big_endian_{false};
+  uint32_t checksum_[2]{};
+  uint64_t end_offset_{0};
+  // Page number to the file offset of its latest committed frame's data
+  std::unordered_map<uint32_t, uint64_t> frames_;
+};
@@ -0,0 +1,306 @@
+#include "zone_map.hpp"
+#include "debug.hpp"
+#include "sidecar.hpp"
+#include <fstream>
+
+namespace {
+
+using sidecar::get;
+using sidecar::put;
+
+constexpr sidecar::Magic SIDECAR_MAGIC = {'T', 'E', 'Z', 'Z', 'O', 'N', 'E', 2};
+constexpr const char *SIDECAR_SUFFIX = "-zonemap";
+
+bool isNull(const RecordValue &value) {
+  return std::holds_alternative<std::monostate>(value);
+}
+
+void putBytes(std::ostream &out, const void *data, size_t size) {
+  put(out, static_cast<uint32_t>(size));
+  out.write(static_cast<const char *>(data),
+            static_cast<std::streamsize>(size));
+}
+
+template <typename Bytes> bool getBytes(std::istream &in, Bytes &bytes) {
+  uint32_t size = 0;
+  if (!get(in, size)) {
+    return false;
+  }
+  bytes.resize(size);
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(bytes.data()), size));
+}
+
+void putValue(std::ostream &out, const RecordValue &value) {
+  put(out, static_cast<uint8_t>(value.index()));
+  switch (value.index()) {
+  case 1:
+    put(out, std::get<int64_t>(value));
+    break;
+  case 2:
+    put(out, std::get<double>(value));
+    break;
+  case 3: {
+    const auto &text = std::get<std::string>(value);
+    putBytes(out, text.data(), text.size());
+    break;
+  }
+  case 4: {
+    const auto &blob = std::get<std::vector<uint8_t>>(value);
+    putBytes(out, blob.data(), blob.size());
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+bool getValue(std::istream &in, RecordValue &value) {
+  uint8_t type = 0;
+  if (!get(in, type)) {
+    return false;
+  }
+  switch (type) {
+  case 0:
+    value = std::monostate{};
+    return true;
+  case 1: {
+    int64_t integer = 0;
+    value = integer;
+    return get(in, std::get<int64_t>(value));
+  }
+  case 2: {
+    double real = 0;
+    value = real;
+    return get(in, std::get<double>(value));
+  }
+  case 3:
+    value = std::string();
+    return getBytes(in, std::get<std::string>(value));
+  case 4:
+    value = std::vector<uint8_t>();
+    return getBytes(in, std::get<std::vector<uint8_t>>(value));
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+void Zone::add(const RecordValue &value) {
+  ++row_count;
+  if (isNull(value)) {
+    ++null_count;
+    return;
+  }
+  if (isNull(min) || compareRecordValues(value, min) < 0) {
+    min = value;
+  }
+  if (isNull(max) || compareRecordValues(value, max) > 0) {
+    max = value;
+  }
+}
+
+void Zone::merge(const Zone &other) {
+  row_count += other.row_count;
+  null_count += other.null_count;
+  if (isNull(other.min)) {
+    return;
+  }
+  if (isNull(min) || compareRecordValues(other.min, min) < 0) {
+    min = other.min;
+  }
+  if (isNull(max) || compareRecordValues(other.max, max) > 0) {
+    max = other.max;
+  }
+}
+
+bool ZoneBound::mayMatch(const Zone &zone) const {
+  if (is_null) {
+    return zone.null_count > 0;
+  }
+  // Comparisons are never true for NULL
+  if (isNull(zone.min)) {
+    return false;
+  }
+  if (lower) {
+    int cmp = compareRecordValues(zone.max, *lower);
+    if (cmp < 0 || (cmp == 0 && !lower_inclusive)) {
+      return false;
+    }
+  }
+  if (upper) {
+    int cmp = compareRecordValues(zone.min, *upper);
+    if (cmp > 0 || (cmp == 0 && !upper_inclusive)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const std::vector<Zone> *ZoneMap::find(uint32_t page) const {
+  auto it = zones_.find(page);
+  return it == zones_.end() ? nullptr : &it->second;
+}
+
+void ZoneMap::addRow(std::vector<Zone> &zones,
+                     const std::vector<RecordValue> &record) const {
+  static const RecordValue null;
+  zones.resize(columns_.size());
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    // Columns added since the row was written read as NULL
+    auto position = static_cast<size_t>(columns_[i]);
+    zones[i].add(position < record.size() ? record[position] : null);
+  }
+}
+
+void ZoneMap::set(uint32_t page, std::vector<Zone> zones) {
+  zones.resize(columns_.size());
+  zones_[page] = std::move(zones);
+}
+
+bool ZoneMap::rollUp(uint32_t page, const std::vector<uint32_t> &children) {
+  std::vector<Zone> zones(columns_.size());
+  for (uint32_t child : children) {
+    const std::vector<Zone> *child_zones = find(child);
+    if (child_zones == nullptr) {
+      return false;
+    }
+    for (size_t i = 0; i < zones.size(); ++i) {
+      zones[i].merge((*child_zones)[i]);
+    }
+  }
+  zones_[page] = std::move(zones);
+  return true;
+}
+
+void ZoneMap::write(std::ostream &out) const {
+  put(out, static_cast<uint32_t>(columns_.size()));
+  for (int column : columns_) {
+    put(out, static_cast<int32_t>(column));
+  }
+  put(out, static_cast<uint64_t>(zones_.size()));
+  for (const auto &[page, zones] : zones_) {
+    put(out, page);
+    for (const Zone &zone : zones) {
+      put(out, zone.null_count);
+      put(out, zone.row_count);
+      putValue(out, zone.min);
+      putValue(out, zone.max);
+    }
+  }
+}
+
+std::optional<ZoneMap> ZoneMap::read(std::istream &in) {
+  uint32_t column_count = 0;
+  if (!get(in, column_count)) {
+    return std::nullopt;
+  }
+  std::vector<int> columns;
+  for (uint32_t i = 0; i < column_count; ++i) {
+    int32_t column = 0;
+    if (!get(in, column) || column < 0) {
+      return std::nullopt;
+    }
+    columns.push_back(column);
+  }
+
+  ZoneMap map(std::move(columns));
+  uint64_t page_count = 0;
+  if (!get(in, page_count)) {
+    return std::nullopt;
+  }
+  for (uint64_t n = 0; n < page_count; ++n) {
+    uint32_t page = 0;
+    if (!get(in, page)) {
+      return std::nullopt;
+    }
+    std::vector<Zone> zones(column_count);
+    for (Zone &zone : zones) {
+      if (!get(in, zone.null_count) || !get(in, zone.row_count) ||
+          !getValue(in, zone.min) || !getValue(in, zone.max)) {
+        return std::nullopt;
+      }
+    }
+    map.zones_[page] = std::move(zones);
+  }
+  return map;
+}
+
+bool ZoneScan::mayMatch(uint32_t page) const {
+  const std::vector<Zone> *zones = map->find(page);
+  if (zones == nullptr) {
+    return true;
+  }
+  for (const ZoneBound &bound : bounds) {
+    if (!bound.mayMatch((*zones)[bound.slot])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ZoneMap *ZoneMaps::find(uint32_t root_page) {
+  validate();
+  auto it = maps_.find(root_page);
+  return it == maps_.end() ? nullptr : &it->second;
+}
+
+ZoneMap &ZoneMaps::define(uint32_t root_page, std::vector<int> columns) {
+  validate();
+  maps_.insert_or_assign(root_page, ZoneMap(std::move(columns)));
+  return maps_.at(root_page);
+}
+
+void ZoneMaps::validate() {
+  DataVersion version = reader_.dataVersion();
+  if (version_ == version) {
+    return;
+  }
+  if (version_) {
+    LOG_INFO("Database changed; dropping zone maps");
+    for (auto &[root_page, map] : maps_) {
+      map = ZoneMap(map.columns());
+    }
+    version_ = version;
+    return;
+  }
+  version_ = version;
+
+  std::ifstream in(reader_.filename() + SIDECAR_SUFFIX, std::ios::binary);
+  if (!in) {
+    return;
+  }
+  uint32_t map_count = 0;
+  if (!sidecar::getHeader(in, SIDECAR_MAGIC, version) ||
+      !get(in, map_count)) {
+    LOG_INFO("Ignoring stale or unreadable zone maps");
+    return;
+  }
+  std::unordered_map<uint32_t, ZoneMap> maps;
+  for (uint32_t n = 0; n < map_count; ++n) {
+    uint32_t root_page = 0;
+    std::optional<ZoneMap> map;
+    if (!get(in, root_page) || !(map = ZoneMap::read(in))) {
+      LOG_INFO("Ignoring unreadable zone maps");
+      return;
+    }
+    maps.insert_or_assign(root_page, std::move(*map));
+  }
+  maps_ = std::move(maps);
+  LOG_INFO("Loaded " << maps_.size() << " zone maps");
+}
+
+void ZoneMaps::save() {
+  validate();
+  const std::string target = reader_.filename() + SIDECAR_SUFFIX;
+  sidecar::save(target, [&](std::ostream &out) {
+    sidecar::putHeader(out, SIDECAR_MAGIC, *version_);
+    put(out, static_cast<uint32_t>(maps_.size()));
+    for (const auto &[root_page, map] : maps_) {
+      put(out, root_page);
+      map.write(out);
+    }
+  });
+  LOG_INFO("Saved " << maps_.size() << " zone maps to " << target);
+}
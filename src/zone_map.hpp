@@ -0,0 +1,109 @@
+#pragma once
+
+#include "btree_record.hpp"
+#include "file_reader.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The values of one column under a page: their extremes in SQLite's order,
+// and how many are NULL.
+struct Zone {
+  // NULL until a non-NULL value is added
+  RecordValue min;
+  RecordValue max;
+  uint64_t null_count{0};
+  uint64_t row_count{0};
+
+  void add(const RecordValue &value);
+  void merge(const Zone &other);
+};
+
+// A WHERE term on a mapped column that a zone can rule out. Non-NULL values
+// it may accept lie between the bounds (unbounded where unset); IS NULL
+// accepts NULL alone.
+struct ZoneBound {
+  size_t slot{0}; // Position among the map's columns
+  std::optional<RecordValue> lower;
+  std::optional<RecordValue> upper;
+  bool lower_inclusive{true};
+  bool upper_inclusive{true};
+  bool is_null{false};
+
+  [[nodiscard]] bool mayMatch(const Zone &zone) const;
+};
+
+// Zones of some columns of one rowid table, by page number: a leaf's cover
+// its rows, and an interior page's everything below it. Leaves are
+// summarised as scans read them, and interior pages once all their children
+// are.
+class ZoneMap {
+public:
+  explicit ZoneMap(std::vector<int> columns) : columns_(std::move(columns)) {}
+
+  // Record positions of the mapped columns
+  [[nodiscard]] const std::vector<int> &columns() const noexcept {
+    return columns_;
+  }
+
+  // One zone per column; null when the page is not summarised yet
+  [[nodiscard]] const std::vector<Zone> *find(uint32_t page) const;
+
+  // Adds one row's values of the mapped columns to a page's zones
+  void addRow(std::vector<Zone> &zones,
+              const std::vector<RecordValue> &record) const;
+
+  void set(uint32_t page, std::vector<Zone> zones);
+
+  // Summarises an interior page from its children; false while one of them
+  // is not summarised
+  bool rollUp(uint32_t page, const std::vector<uint32_t> &children);
+
+  [[nodiscard]] size_t pageCount() const noexcept { return zones_.size(); }
+
+  // Binary form for the sidecar file
+  void write(std::ostream &out) const;
+  static std::optional<ZoneMap> read(std::istream &in);
+
+private:
+  std::vector<int> columns_;
+  std::unordered_map<uint32_t, std::vector<Zone>> zones_;
+};
+
+// A scan's use of a table's zone map: subtrees whose zones rule out one of
+// the bounds are skipped, and pages read in full are summarised.
+struct ZoneScan {
+  ZoneMap *map;
+  std::vector<ZoneBound> bounds;
+
+  [[nodiscard]] bool mayMatch(uint32_t page) const;
+};
+
+// The zone maps of a database's tables, by root page. Zones hold while the
+// data version does; once it moves they are dropped, and the columns stay
+// mapped to be summarised again. `<database>-zonemap` keeps the maps between
+// processes: it is read on first use if it was saved against the current
+// data version, and written by save().
+class ZoneMaps {
+public:
+  explicit ZoneMaps(const FileReader &reader) noexcept : reader_(reader) {}
+
+  // The table's map; null when it has none
+  ZoneMap *find(uint32_t root_page);
+
+  // Maps the table's columns (record positions), replacing any earlier map
+  ZoneMap &define(uint32_t root_page, std::vector<int> columns);
+
+  void save();
+
+private:
+  void validate();
+
+  const FileReader &reader_;
+  std::optional<DataVersion> version_;
+  std::unordered_map<uint32_t, ZoneMap> maps_;
+};